@@ -1,7 +1,10 @@
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/wait.h>
 #include <fcntl.h>
 #include <limits.h>
 #include <unistd.h>
@@ -10,6 +13,7 @@
 #include "debug.h"
 
 #include "msg.h"
+#include "wire.h"
 #include "burst_queue.h"
 
 /**
@@ -32,6 +36,12 @@ char *get_basename_no_ext(const char* path) {
     return result;
 }
 
+// The first ACK may come at time 0, so "no start time yet" needs its own value
+#define NOT_STARTED UINT32_MAX
+
+// Bytes received from the scheduler and not decoded yet
+static wire_rx_t server_rx;
+
 typedef enum {
     process_error = 0,
     process_success,
@@ -43,19 +53,19 @@ process_status_en handle_process_requests(int sockfd, const pid_t pid, const cha
         .pid = pid,
         .request = request,
         .time_ms = (request == PROCESS_REQUEST_RUN)?burst->burst_time_ms:burst->block_time_ms,
+        .nice = burst->nice,
         .pages = burst->pages
     };
     // Send request
-    if (write(sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
-        perror("write");
+    if (wire_send_msg(sockfd, &msg) < 0) {
         close(sockfd);
         return process_error;
     }
     DBG("Application %s (PID %d) sent %s request for %u ms",
            app_name, pid, PROCESS_REQUEST_STRINGS[request], msg.time_ms);
-    // Wait for ACK and the internal simulation time
-    if (read(sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
-        perror("read");
+    // Wait for ACK and the internal simulation time; the replies carry no pages
+    msg = (msg_t) {0};
+    if (wire_recv_msg(sockfd, &server_rx, &msg) <= 0) {
         close(sockfd);
         return process_error;
     }
@@ -64,13 +74,12 @@ process_status_en handle_process_requests(int sockfd, const pid_t pid, const cha
         return process_error;
     }
     *sim_clock_ms = msg.time_ms;
-    if (*sim_start_time_ms == 0) *sim_start_time_ms = *sim_clock_ms; // First burst, set the start time
+    if (*sim_start_time_ms == NOT_STARTED) *sim_start_time_ms = *sim_clock_ms; // First burst, set the start time
     DBG("Received %s from scheduler for application %s (PID %d) at time %u ms\n",
            PROCESS_REQUEST_STRINGS[msg.request], app_name, pid, *sim_clock_ms);
 
     // Wait for DONE and the internal simulation time
-    if (read(sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
-        perror("read");
+    if (wire_recv_msg(sockfd, &server_rx, &msg) <= 0) {
         close(sockfd);
         return process_error;
     }
@@ -86,31 +95,42 @@ process_status_en handle_process_requests(int sockfd, const pid_t pid, const cha
     return process_success;
 }
 
-/*
- * Run like: ./app-pre <burst-file.csv>
+/**
+ * Map the shared regions of the burst file, one SHARE request each, before the first burst
+ * @return process_success, or process_error on a protocol or socket error
  */
-int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        printf("Usage: %s <burst-file.csv>\n", argv[0]);
-        exit(EXIT_FAILURE);
-    }
-
-    // Parse arguments
-    const char *burstfile_name = argv[1];
-    char *app_name = get_basename_no_ext(burstfile_name);
-
-    burst_queue_t bursts = {.head = NULL, .tail = NULL};
-
-    if (read_queue_from_file(&bursts, burstfile_name) <= 0) {
-        fprintf(stderr, "Failed to read burst file %s\n", burstfile_name);
-        return EXIT_FAILURE;
+static process_status_en declare_shared(int sockfd, pid_t pid, burst_queue_t *bursts) {
+    while (bursts->shared) {
+        shared_decl_t *decl = bursts->shared;
+        msg_t msg = {
+            .pid = pid,
+            .request = PROCESS_REQUEST_SHARE,
+            .share_key = decl->key,
+            .share_vfn = decl->first_vfn,
+            .share_pages = decl->pages
+        };
+        bursts->shared = decl->next;
+        free(decl);
+        if (wire_send_msg(sockfd, &msg) < 0) return process_error;
+        msg = (msg_t) {0};
+        if (wire_recv_msg(sockfd, &server_rx, &msg) <= 0) return process_error;
+        if (msg.request != PROCESS_REQUEST_ACK) {
+            printf("Received invalid request. Expected ACK, received %s\n", PROCESS_REQUEST_STRINGS[msg.request]);
+            return process_error;
+        }
     }
+    return process_success;
+}
 
-    // Setup socket for communication
+/**
+ * Connect to the scheduler
+ * @return the socket, or -1 on error
+ */
+static int connect_scheduler(void) {
     int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
     if (sockfd < 0) {
         perror("socket");
-        return EXIT_FAILURE;
+        return -1;
     }
 
     struct sockaddr_un addr = {0};
@@ -120,33 +140,256 @@ int main(int argc, char *argv[]) {
     if (connect(sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
         perror("connect");
         close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+/**
+ * Fork the application (a `fork` line). The child connects to the scheduler on its own
+ * and sends a FORK request, so the simulator copies the address space of the parent
+ * copy-on-write. The parent waits until the child is acknowledged: until then it stays in
+ * the command queue, where the scheduler finds it. Both go on with the bursts that follow.
+ * @param sockfd the socket, replaced by the new connection in the child
+ * @param pid the pid, replaced by the new pid in the child
+ * @param sim_start_time_ms reset in the child, which counts its times from its first burst
+ * @param cpu_duration_ms reset in the child
+ * @param block_duration_ms reset in the child
+ * @return process_success, or process_error if the fork failed (in the child: it must exit)
+ */
+static process_status_en fork_app(int *sockfd, pid_t *pid, uint32_t *sim_start_time_ms, uint32_t *cpu_duration_ms,
+                                  uint32_t *block_duration_ms) {
+    int ready[2];
+    if (pipe(ready) < 0) {
+        perror("pipe");
+        return process_error;
+    }
+    fflush(stdout);         // Or the child prints what the parent buffered again
+    pid_t child = fork();
+    if (child < 0) {
+        perror("fork");
+        close(ready[0]);
+        close(ready[1]);
+        return process_error;
+    }
+    if (child > 0) {
+        // Wait for the child to be acknowledged (or to give up, which closes the pipe)
+        char c;
+        close(ready[1]);
+        while (read(ready[0], &c, 1) < 0 && errno == EINTR) {}
+        close(ready[0]);
+        return process_success;
+    }
+
+    close(ready[0]);
+    close(*sockfd);
+    wire_rx_reset(&server_rx);
+    *sim_start_time_ms = NOT_STARTED;
+    *cpu_duration_ms = 0;
+    *block_duration_ms = 0;
+    msg_t msg = {.pid = getpid(), .request = PROCESS_REQUEST_FORK, .parent_pid = *pid};
+    *pid = msg.pid;
+    *sockfd = connect_scheduler();
+    if (*sockfd < 0 || wire_send_msg(*sockfd, &msg) < 0) return process_error;
+    msg = (msg_t) {0};
+    if (wire_recv_msg(*sockfd, &server_rx, &msg) <= 0) return process_error;
+    if (msg.request != PROCESS_REQUEST_ACK) {
+        printf("Received invalid request. Expected ACK, received %s\n", PROCESS_REQUEST_STRINGS[msg.request]);
+        return process_error;
+    }
+    if (write(ready[1], "", 1) < 0) perror("write");
+    close(ready[1]);
+    return process_success;
+}
+
+static void free_burst(burst_t *burst) {
+    page_info_free(&burst->pages);
+    free(burst);
+}
+
+/*
+ * Pipelined protocol: the bursts are uploaded in SCRIPT messages of up to `window` bursts
+ * and the scheduler runs them back to back, sending only a DONE at the end of every
+ * phase (RUN, then BLOCK if any). A new SCRIPT is sent when half of the window is done.
+ */
+typedef struct {
+    burst_t *bursts[MAX_SCRIPT_BURSTS];     // Uploaded and not finished yet, oldest first
+    uint32_t head;
+    uint32_t count;
+    int run_done;                           // The oldest burst got the DONE of its RUN already
+} in_flight_t;
+
+/**
+ * Upload up to max_bursts bursts from the queue in one SCRIPT message
+ * @return 0 on success, -1 on error
+ */
+static int send_script(int sockfd, pid_t pid, burst_queue_t *bursts, in_flight_t *in_flight, uint32_t max_bursts) {
+    static wire_buf_t out;      // Reused between scripts
+    uint32_t count = 0;
+    // A script ends at a fork, which waits for all the bursts before it
+    for (burst_node_t *node = bursts->head; node && !node->burst->fork && count < max_bursts; node = node->next) count++;
+
+    msg_t header = {.pid = pid, .request = PROCESS_REQUEST_SCRIPT, .time_ms = count};
+    if (wire_put_msg(&out, &header) < 0) return -1;
+    for (uint32_t i = 0; i < count; i++) {
+        burst_t *burst = dequeue_burst(bursts);
+        msg_t run = {
+            .pid = pid,
+            .request = PROCESS_REQUEST_RUN,
+            .time_ms = burst->burst_time_ms,
+            .nice = burst->nice,
+            .block_ms = burst->block_time_ms,
+            .pages = burst->pages
+        };
+        in_flight->bursts[(in_flight->head + in_flight->count++) % MAX_SCRIPT_BURSTS] = burst;
+        if (wire_put_msg(&out, &run) < 0) return -1;
+    }
+    DBG("Sending a script of %u bursts", count);
+    return wire_write(sockfd, &out);
+}
+
+/**
+ * Run all bursts with the pipelined protocol. A fork waits until the bursts before it are done.
+ * @return process_success, or process_error on a protocol or socket error
+ */
+static process_status_en run_script(int *sockfd, pid_t *pid, const char *app_name, burst_queue_t *bursts,
+                                    uint32_t window, uint32_t *sim_start_time_ms, uint32_t *sim_clock_ms,
+                                    uint32_t *cpu_duration_ms, uint32_t *block_duration_ms) {
+    in_flight_t in_flight = {.head = 0, .count = 0, .run_done = 0};
+
+    while (bursts->head || in_flight.count > 0) {
+        if (bursts->head && bursts->head->burst->fork) {
+            if (in_flight.count == 0) {
+                free_burst(dequeue_burst(bursts));
+                if (fork_app(sockfd, pid, sim_start_time_ms, cpu_duration_ms, block_duration_ms) == process_error) {
+                    return process_error;
+                }
+                continue;
+            }
+        } else if (bursts->head && in_flight.count <= window / 2) {
+            if (send_script(*sockfd, *pid, bursts, &in_flight, window - in_flight.count) < 0) return process_error;
+        }
+
+        // Wait for the next message; whatever else the scheduler sent comes in with the same read
+        msg_t msg = {0};
+        if (wire_recv_msg(*sockfd, &server_rx, &msg) <= 0) {
+            printf("Lost the connection to the scheduler\n");
+            return process_error;
+        }
+        *sim_clock_ms = msg.time_ms;
+        DBG("Received %s from scheduler for application %s (PID %d) at time %u ms\n",
+            PROCESS_REQUEST_STRINGS[msg.request], app_name, *pid, *sim_clock_ms);
+        if (msg.request == PROCESS_REQUEST_ACK) {
+            if (*sim_start_time_ms == NOT_STARTED) *sim_start_time_ms = *sim_clock_ms; // First script, set the start time
+            continue;
+        }
+        if (msg.request != PROCESS_REQUEST_DONE || in_flight.count == 0) {
+            printf("Received invalid request. Expected ACK or DONE, received %s\n",
+                   PROCESS_REQUEST_STRINGS[msg.request]);
+            return process_error;
+        }
+
+        burst_t *burst = in_flight.bursts[in_flight.head];
+        if (!in_flight.run_done) {
+            *cpu_duration_ms += burst->burst_time_ms;
+            in_flight.run_done = 1;
+            if (burst->block_time_ms > 0) continue;     // Its BLOCK is next
+        } else {
+            *block_duration_ms += burst->block_time_ms;
+        }
+        // Both phases of the oldest burst are done
+        free_burst(burst);
+        in_flight.head = (in_flight.head + 1) % MAX_SCRIPT_BURSTS;
+        in_flight.count--;
+        in_flight.run_done = 0;
+    }
+    return process_success;
+}
+
+/*
+ * Run like: ./app-io [--window <n>] <burst-file.csv>
+ */
+int main(int argc, char *argv[]) {
+    // Parse arguments
+    const char *burstfile_name = NULL;
+    uint32_t window = 0;                    // 0: one RUN/BLOCK round trip at a time
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            char *end;
+            long value = strtol(argv[++i], &end, 10);
+            if (*end != '\0' || value < 1 || value > MAX_SCRIPT_BURSTS) {
+                fprintf(stderr, "Invalid window: %s (1 to %d bursts)\n", argv[i], MAX_SCRIPT_BURSTS);
+                exit(EXIT_FAILURE);
+            }
+            window = (uint32_t) value;
+        } else if (!burstfile_name && argv[i][0] != '-') {
+            burstfile_name = argv[i];
+        } else {
+            burstfile_name = NULL;
+            break;
+        }
+    }
+    if (!burstfile_name) {
+        printf("Usage: %s [--window <n>] <burst-file.csv>\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    char *app_name = get_basename_no_ext(burstfile_name);
+
+    burst_queue_t bursts = {.head = NULL, .tail = NULL, .shared = NULL};
+
+    if (read_queue_from_file(&bursts, burstfile_name) <= 0) {
+        fprintf(stderr, "Failed to read burst file %s\n", burstfile_name);
         return EXIT_FAILURE;
     }
 
+    // Setup socket for communication
+    int sockfd = connect_scheduler();
+    if (sockfd < 0) return EXIT_FAILURE;
+
     pid_t pid = getpid();
     uint32_t sim_clock_ms = 0;              // Clock of the scheduler
 
-    uint32_t start_time_ms = 0;             // Start time of the app
+    uint32_t start_time_ms = NOT_STARTED;   // Start time of the app (time of the first ACK)
     uint32_t cpu_duration_ms = 0;           // duration of the app (bursts and blocks)
     uint32_t block_duration_ms = 0;         // duration of the app in blocked state
 
     burst_t *active_burst;
 
-    while ((active_burst = dequeue_burst(&bursts)) != NULL) {
-        if (handle_process_requests(sockfd, pid, app_name, active_burst, PROCESS_REQUEST_RUN, &start_time_ms, &sim_clock_ms) == process_error)
-            break;
-        cpu_duration_ms += active_burst->burst_time_ms;
+    if (declare_shared(sockfd, pid, &bursts) == process_error) {
+        printf("Failed to map the shared regions of %s\n", app_name);
+        close(sockfd);
+        free(app_name);
+        return EXIT_FAILURE;
+    }
 
-        if (active_burst->block_time_ms > 0) {
-            if (handle_process_requests(sockfd, pid, app_name, active_burst, PROCESS_REQUEST_BLOCK, &start_time_ms, &sim_clock_ms) == process_error)
+    if (window > 0) {
+        run_script(&sockfd, &pid, app_name, &bursts, window, &start_time_ms, &sim_clock_ms,
+                   &cpu_duration_ms, &block_duration_ms);
+    } else {
+        while ((active_burst = dequeue_burst(&bursts)) != NULL) {
+            if (active_burst->fork) {
+                free_burst(active_burst);
+                if (fork_app(&sockfd, &pid, &start_time_ms, &cpu_duration_ms, &block_duration_ms) == process_error)
+                    break;
+                continue;
+            }
+            if (handle_process_requests(sockfd, pid, app_name, active_burst, PROCESS_REQUEST_RUN, &start_time_ms, &sim_clock_ms) == process_error)
                 break;
-            block_duration_ms += active_burst->block_time_ms;
+            cpu_duration_ms += active_burst->burst_time_ms;
+
+            if (active_burst->block_time_ms > 0) {
+                if (handle_process_requests(sockfd, pid, app_name, active_burst, PROCESS_REQUEST_BLOCK, &start_time_ms, &sim_clock_ms) == process_error)
+                    break;
+                block_duration_ms += active_burst->block_time_ms;
+            }
+            free_burst(active_burst);
         }
     }
     close(sockfd);
 
 
     // Received EXIT, print stats
+    if (start_time_ms == NOT_STARTED) start_time_ms = sim_clock_ms;
     double real = (sim_clock_ms - start_time_ms)/1000.0;
     double user = (double)cpu_duration_ms/1000.0;
     double sys = (double)block_duration_ms/1000.0;
@@ -154,6 +397,9 @@ int main(int argc, char *argv[]) {
     printf("Application %s (PID %d) finished at time %d ms, Elapsed: %.03f seconds, CPU: %.03f seconds, BLOCKED: %.03f seconds\n",
            app_name, pid, sim_clock_ms, real, user, sys);
 
+    // The processes it forked have their own connection, wait for them to finish too
+    while (wait(NULL) > 0) {}
+
     free(app_name);
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -2,14 +2,13 @@
 #include <stdint.h>
 
 #include "burst_queue.h"
+#include "wire.h"
 
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define MAX_LINE_LEN 1024
-
 int parse_burst_line(const char* line, burst_t* burst) {
     if (!line || !burst) return -1;
 
@@ -65,14 +64,17 @@ int parse_burst_line(const char* line, burst_t* burst) {
 //    if (token) token = strtok(NULL, "]");
     if (token) {
         char* page_token = strtok(token, ",]");
-        while (page_token &&  burst->pages.count< MAX_PAGES) {
+        while (page_token) {
             long page = strtol(page_token, &endptr, 10);
             if (*endptr != '\0' || page > INT_MAX) {
                 fprintf(stderr, "Invalid page number: %s\n", page_token);
                 free(line_copy);
                 return -1;
             }
-            burst->pages.ids[burst->pages.count++] = (int)page;
+            if (page_info_append(&burst->pages, (int32_t)page) < 0) {
+                free(line_copy);
+                return -1;
+            }
             page_token = strtok(NULL, ",]\r\n");
         }
     }
@@ -82,6 +84,28 @@ int parse_burst_line(const char* line, burst_t* burst) {
 }
 
 
+/**
+ * Parse a shared region line: shared,<key>,<first page>,<pages>
+ * @return 0 on success, -1 if the line is malformed
+ */
+int parse_shared_line(const char* line, shared_decl_t* decl) {
+    unsigned long values[3];
+    const char* p = line + strlen("shared");
+    for (int i = 0; i < 3; i++) {
+        char* endptr;
+        if (*p != ',') return -1;
+        values[i] = strtoul(p + 1, &endptr, 10);
+        if (endptr == p + 1 || values[i] == 0 || values[i] > UINT32_MAX) return -1;
+        p = endptr;
+    }
+    while (isspace(*p)) ++p;
+    if (*p != '\0' || values[0] > INT_MAX) return -1;
+    decl->key = (uint32_t) values[0];
+    decl->first_vfn = (uint32_t) values[1];
+    decl->pages = (uint32_t) values[2];
+    return 0;
+}
+
 int read_queue_from_file(burst_queue_t* queue, const char* filename) {
     if (!queue || !filename) return -1;
 
@@ -91,17 +115,47 @@ int read_queue_from_file(burst_queue_t* queue, const char* filename) {
         return -1;
     }
 
-    char line[MAX_LINE_LEN];
+    // Lines have no length limit, a burst can list any number of pages
+    char *line = NULL;
+    size_t line_cap = 0;
     int success_count = 0;
 
-    while (fgets(line, sizeof(line), file)) {
+    while (getline(&line, &line_cap, file) != -1) {
         // Trim leading whitespace
         char* trimmed = line;
         while (isspace(*trimmed)) ++trimmed;
 
         if (*trimmed == '#' || *trimmed == '\0') continue;
 
+        if (strncmp(trimmed, "shared", strlen("shared")) == 0) {
+            shared_decl_t* decl = malloc(sizeof(shared_decl_t));
+            if (!decl || parse_shared_line(trimmed, decl) < 0) {
+                fprintf(stderr, "Skipping malformed line: %s", line);
+                free(decl);
+                continue;
+            }
+            // Keep the file order, the list is short
+            shared_decl_t** tail = &queue->shared;
+            while (*tail) tail = &(*tail)->next;
+            decl->next = NULL;
+            *tail = decl;
+            printf("Shared region %u at pages %u to %u\n", decl->key, decl->first_vfn,
+                   decl->first_vfn + decl->pages - 1);
+            continue;
+        }
+
         burst_t burst = {0}; // Initialize burst structure
+        if (strncmp(trimmed, "fork", strlen("fork")) == 0) {
+            // The bursts after it run in both the application and its child
+            const char* rest = trimmed + strlen("fork");
+            while (isspace(*rest)) ++rest;
+            if (*rest != '\0' || !enqueue_burst(queue, &(burst_t) {.fork = 1})) {
+                fprintf(stderr, "Skipping malformed line: %s", line);
+                continue;
+            }
+            printf("Enqueued fork\n");
+            continue;
+        }
         if (parse_burst_line(trimmed, &burst) == 0) {
             if (enqueue_burst(queue, &burst)) {
                 success_count++;
@@ -113,12 +167,15 @@ int read_queue_from_file(burst_queue_t* queue, const char* filename) {
                 printf("]\n");
             } else {
                 fprintf(stderr, "Queue full or allocation failed\n");
+                page_info_free(&burst.pages);
                 break;
             }
         } else {
             fprintf(stderr, "Skipping malformed line: %s", line);
+            page_info_free(&burst.pages);
         }
     }
+    free(line);
 
     fclose(file);
     return success_count;
@@ -8,6 +8,7 @@ typedef struct {
     uint32_t block_time_ms;         // Burst time in milliseconds
     int nice;                       // Nice value (priority)
     page_info_t pages;
+    int fork;                       // A `fork` line: the application forks here, no burst
 } burst_t;
 
 
@@ -16,9 +17,18 @@ typedef struct burst_node {
     struct burst_node* next;
 } burst_node_t;
 
+// A shared region the application maps, from a line shared,<key>,<first page>,<pages>
+typedef struct shared_decl_st {
+    uint32_t key;
+    uint32_t first_vfn;
+    uint32_t pages;
+    struct shared_decl_st *next;
+} shared_decl_t;
+
 typedef struct burst_queue_st  {
     burst_node_t* head;
     burst_node_t* tail;
+    shared_decl_t* shared;          // Shared regions declared in the file, in order
 } burst_queue_t;
 
 int read_queue_from_file(burst_queue_t* queue, const char* filename);
@@ -0,0 +1,72 @@
+#include "kswapd.h"
+
+#include <string.h>
+
+#include "msg.h"
+#include "ossim.h"
+#include "debug.h"
+
+kswapd_config_t kswapd_config = {
+    .enabled = 0,
+    .interval_ms = TICKS_MS,
+};
+
+static void set_watermarks(kswapd_t *kswapd) {
+    kswapd->low = kswapd->min + kswapd->gap;
+    kswapd->high = kswapd->low + kswapd->gap;
+    if (kswapd->high > kswapd->stats.max_high) kswapd->stats.max_high = kswapd->high;
+}
+
+/**
+ * Set the watermarks of a frame table up, at their smallest gap
+ * @param kswapd the daemon to initialize
+ * @param frame_table the frame table it reclaims from
+ * @param min_pages_threshold the min watermark (--threshold)
+ */
+void kswapd_init(kswapd_t *kswapd, const frame_table_t *frame_table, int32_t min_pages_threshold) {
+    memset(kswapd, 0, sizeof(*kswapd));
+    kswapd->min = min_pages_threshold;
+    kswapd->min_gap = frame_table->no_frames / 64 > 1 ? frame_table->no_frames / 64 : 1;
+    // low and high stay within the first half of the pages that may be resident
+    kswapd->max_gap = frame_table->capacity / 4 > kswapd->min_gap ? frame_table->capacity / 4 : kswapd->min_gap;
+    kswapd->gap = kswapd->min_gap;
+    kswapd->last_faults = total_page_faults;
+    set_watermarks(kswapd);
+}
+
+/**
+ * Follow the fault rate: the frames taken since the last run are the free frames needed
+ * to get to the next one without direct reclaim. Moving average over about four runs.
+ */
+static void adapt_watermarks(kswapd_t *kswapd) {
+    int32_t demand = total_page_faults - kswapd->last_faults;
+    kswapd->last_faults = total_page_faults;
+    int32_t gap = (3 * kswapd->gap + demand + 2) / 4;
+    if (gap < kswapd->min_gap) gap = kswapd->min_gap;
+    if (gap > kswapd->max_gap) gap = kswapd->max_gap;
+    kswapd->gap = gap;
+    set_watermarks(kswapd);
+}
+
+/**
+ * Let kswapd run if its interval is over: below the low watermark it evicts pages until
+ * the high watermark is reached
+ * @param kswapd the daemon, NULL (or kswapd_config.enabled 0) for none
+ * @param current_time_ms the current simulation time
+ * @param frame_table the frame table
+ * @param swap the swap
+ * @return the number of frames freed, or -1 on failure
+ */
+int kswapd_run(kswapd_t *kswapd, uint32_t current_time_ms, frame_table_t *frame_table, swap_hash_t *swap) {
+    if (kswapd == NULL || !kswapd_config.enabled || current_time_ms < kswapd->next_run_ms) return 0;
+    kswapd->next_run_ms = current_time_ms + kswapd_config.interval_ms;
+    kswapd->stats.runs++;
+    adapt_watermarks(kswapd);
+    if (frame_table->free_stack.top >= kswapd->low) return 0;
+
+    kswapd->stats.wakeups++;
+    DBG("kswapd: %d free frames, reclaiming up to %d", frame_table->free_stack.top, kswapd->high);
+    int reclaimed = reclaim_frames(current_time_ms, frame_table, swap, kswapd->high);
+    if (reclaimed > 0) kswapd->stats.reclaimed += (uint64_t) reclaimed;
+    return reclaimed;
+}
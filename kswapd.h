@@ -0,0 +1,53 @@
+#ifndef KSWAPD_H
+#define KSWAPD_H
+
+/*
+ * Background page-out daemon (--kswapd), after the kswapd of Linux.
+ *
+ * Free frames are kept between three watermarks (counted like page_eviction() does,
+ * on free_stack.top):
+ *   min   the --threshold: below it the access that needs a frame reclaims itself
+ *         (direct reclaim, page_eviction())
+ *   low   kswapd wakes up below it...
+ *   high  ...and reclaims in one batch up to it
+ *
+ * kswapd runs every kswapd_config.interval_ms of simulated time, outside of the page
+ * accesses. The gap between the watermarks follows the faults of the last interval
+ * (every fault takes a free frame), so a process that faults a lot gets more frames
+ * freed ahead of it and one that faults little keeps more pages resident.
+ */
+
+#include <stdint.h>
+
+#include "virtmem.h"
+
+typedef struct kswapd_config_st {
+    int      enabled;           // 0: only direct reclaim, as without kswapd
+    uint32_t interval_ms;       // Simulated time between two runs
+} kswapd_config_t;
+
+extern kswapd_config_t kswapd_config;
+
+typedef struct kswapd_stats_st {
+    uint64_t runs;
+    uint64_t wakeups;           // Runs that found fewer free frames than the low watermark
+    uint64_t reclaimed;         // Frames evicted in the background
+    int32_t  max_high;          // Highest the high watermark got
+} kswapd_stats_t;
+
+typedef struct kswapd_st {
+    int32_t  min;               // Direct reclaim below this
+    int32_t  low;               // kswapd wakes up below this
+    int32_t  high;              // and reclaims up to this
+    int32_t  gap;               // low - min and high - low
+    int32_t  min_gap;
+    int32_t  max_gap;           // Keeps at least half of the capacity for resident pages
+    uint32_t next_run_ms;
+    int      last_faults;       // total_page_faults at the last run
+    kswapd_stats_t stats;
+} kswapd_t;
+
+void kswapd_init(kswapd_t *kswapd, const frame_table_t *frame_table, int32_t min_pages_threshold);
+int kswapd_run(kswapd_t *kswapd, uint32_t current_time_ms, frame_table_t *frame_table, swap_hash_t *swap);
+
+#endif //KSWAPD_H
@@ -11,14 +11,15 @@
 
 #define SOCKET_PATH "/tmp/scheduler.sock"
 
-#define MAX_PAGES 32
-
 // Define process request strings for debugging purposes
 static const char PROCESS_REQUEST_STRINGS[][10] = {
     "RUN",
     "BLOCK",
     "ACK",
     "DONE",
+    "SCRIPT",
+    "SHARE",
+    "FORK",
 };
 
 // Define the types of requests a process can make to the scheduler
@@ -27,21 +28,34 @@ typedef enum  {
     PROCESS_REQUEST_BLOCK,
     PROCESS_REQUEST_ACK,
     PROCESS_REQUEST_DONE,
+    PROCESS_REQUEST_SCRIPT,     // Burst script: time_ms RUN messages (with block_ms) follow
+    PROCESS_REQUEST_SHARE,      // Map shared region share_key at share_vfn (see vm_shared.h), before the first burst
+    PROCESS_REQUEST_FORK,       // A forked client: copy the address space of process parent_pid, copy-on-write
 } process_request_t;
 
-// Define the structure for page information
-// Note: Not used until we get to memory management, but defined here for completeness
+// Largest number of bursts in one SCRIPT message
+#define MAX_SCRIPT_BURSTS 64
+
+// Define the structure for page information: the pages a burst accesses, in order
+// The list grows as needed (see page_info_append() in wire.c), there is no fixed limit
 typedef struct {
     uint32_t count;            // Number of pages in the burst
-    int32_t ids[MAX_PAGES];   // Array of pages (up to MAX_PAGES)
+    uint32_t capacity;         // Allocated length of ids
+    int32_t *ids;              // Pages, negative for a write
 } page_info_t;
 
 // Define the message structure for communication between applications and the scheduler
-// This structure is sent over the socket
+// On the socket it is sent as a variable-length frame, see wire.h
 typedef struct {
     pid_t pid;                      // Process ID
     process_request_t request;      // Request type
     uint32_t time_ms;               // Time information
+    int32_t nice;                   // Nice value of the burst (RUN only)
+    uint32_t block_ms;              // Block time after the burst (RUN inside a SCRIPT only)
+    uint32_t share_key;             // Key of the shared region, the same for every process that maps it (SHARE only)
+    uint32_t share_vfn;             // First page the shared region is mapped at (SHARE only)
+    uint32_t share_pages;           // Pages of the shared region that are mapped (SHARE only)
+    pid_t parent_pid;               // Process whose address space the client takes (FORK only)
     page_info_t pages;              // Pages requested (if any)
 } msg_t;
 
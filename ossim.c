@@ -5,6 +5,7 @@
 #include <signal.h>
 #include <sys/errno.h>
 #include <stdlib.h>
+#include <limits.h>
 #include "scheduler.h"
 #include "virtmem.h"
 #include <time.h>
@@ -12,12 +13,28 @@
 
 #include "msg.h"
 #include "queue.h"
+#include "timer_wheel.h"
+#include "vm_opt.h"
+#include "trace.h"
+#include "tlb.h"
+#include "swap_map.h"
+#include "kswapd.h"
+#include "vm_load.h"
+#include "readahead.h"
+#include "vm_shared.h"
 
 // Contadores globais de estatísticas (reiniciar OSSIM para resetar)
 int total_page_faults = 0;
 int total_swaps_in = 0;
 int total_swaps_out = 0;
+int total_swap_writes_avoided = 0;
 int total_page_accesses = 0;
+int total_direct_reclaims = 0;
+int total_direct_reclaim_stalls = 0;
+int total_readahead_reclaims = 0;
+int total_forks = 0;
+long total_cow_shared = 0;
+long total_cow_copies = 0;
 int access_counter = 0;
 
 
@@ -28,52 +45,189 @@ void handle_signal(int sig) {
     keep_running = 0; // tell main loop to exit
 }
 
-int parse_args(int argc, char *argv[], int *pages, int *frames, int *threshold) {
+/**
+ * Parse a numeric option value
+ * @param option the option name (for error messages)
+ * @param value the string to parse
+ * @param min the minimum accepted value
+ * @param out where the parsed value is stored
+ * @return 0 on success, -1 on failure
+ */
+static int parse_int_option(const char *option, const char *value, long min, int *out) {
+    char *endptr;
+    errno = 0;
+    long val = strtol(value, &endptr, 10);
+    if (errno != 0 || *endptr != '\0' || val < min || val > INT_MAX) {
+        fprintf(stderr, "Error: invalid number for %s: %s\n", option, value);
+        return -1;
+    }
+    *out = (int) val;
+    return 0;
+}
+
+/**
+ * Match argv[*i] against an option that takes a value. Both "--name value" and
+ * "--name=value" are accepted; *i is advanced when the value is the next argument.
+ * @return 1 if matched (value stored), 0 if not this option, -1 if the value is missing
+ */
+static int match_option(int argc, char *argv[], int *i, const char *name, const char **value) {
+    size_t len = strlen(name);
+    if (strncmp(argv[*i], name, len) != 0) return 0;
+    if (argv[*i][len] == '=') {
+        *value = argv[*i] + len + 1;
+        return 1;
+    }
+    if (argv[*i][len] != '\0') return 0;
+    if (*i + 1 < argc) {
+        *value = argv[++(*i)];
+        return 1;
+    }
+    fprintf(stderr, "Error: %s requires a value\n", name);
+    return -1;
+}
+
+int parse_args(int argc, char *argv[], ossim_config_t *config) {
     for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "--pages") == 0) {
-            if (i + 1 < argc) {
-                char *endptr;
-                errno = 0;
-                long val = strtol(argv[++i], &endptr, 10);
-                if (errno != 0 || *endptr != '\0' || val <= 0) {
-                    fprintf(stderr, "Error: invalid number for --pages: %s\n", argv[i]);
-                    return -1;
-                }
-                *pages = (int) val;
-            } else {
-                fprintf(stderr, "Error: --pages requires a number\n");
+        const char *value = NULL;
+        int m;
+        if ((m = match_option(argc, argv, &i, "--pages", &value)) != 0) {
+            if (m < 0 || parse_int_option("--pages", value, 1, &config->num_pages) < 0) return -1;
+        } else if ((m = match_option(argc, argv, &i, "--frames", &value)) != 0) {
+            if (m < 0 || parse_int_option("--frames", value, 1, &config->num_frames) < 0) return -1;
+        } else if ((m = match_option(argc, argv, &i, "--threshold", &value)) != 0) {
+            if (m < 0 || parse_int_option("--threshold", value, 0, &config->min_pages_threshold) < 0) return -1;
+        } else if ((m = match_option(argc, argv, &i, "--policy", &value)) != 0) {
+            if (m < 0) return -1;
+            if (set_vm_policy(value) < 0) {
+                fprintf(stderr, "Error: unknown page replacement policy: %s\nAvailable policies:\n", value);
+                list_vm_policies(stderr);
                 return -1;
             }
-        } else if (strcmp(argv[i], "--frames") == 0) {
-            if (i + 1 < argc) {
-                char *endptr;
-                errno = 0;
-                long val = strtol(argv[++i], &endptr, 10);
-                if (errno != 0 || *endptr != '\0' || val <= 0) {
-                    fprintf(stderr, "Error: invalid number for --frames: %s\n", argv[i]);
-                    return -1;
-                }
-                *frames = (int) val;
+        } else if ((m = match_option(argc, argv, &i, "--clock", &value)) != 0) {
+            if (m < 0) return -1;
+            if (strcmp(value, "real") == 0) {
+                config->clock_mode = CLOCK_REAL;
+            } else if (strcmp(value, "virtual") == 0) {
+                config->clock_mode = CLOCK_VIRTUAL;
             } else {
-                fprintf(stderr, "Error: --frames requires a number\n");
+                fprintf(stderr, "Error: invalid value for --clock: %s (expected real or virtual)\n", value);
                 return -1;
             }
-        } else if (strcmp(argv[i], "--threshold") == 0) {
-            if (i + 1 < argc) {
-                char *endptr;
-                errno = 0;
-                long val = strtol(argv[++i], &endptr, 10);
-                if (errno != 0 || *endptr != '\0' || val < 0) {
-                    fprintf(stderr, "Error: invalid number for --threshold: %s\n", argv[i]);
-                    return -1;
-                }
-                *threshold = (int) val;
-            } else {
-                fprintf(stderr, "Error: --threshold requires a number\n");
+        } else if ((m = match_option(argc, argv, &i, "--clients", &value)) != 0) {
+            if (m < 0 || parse_int_option("--clients", value, 0, &config->wait_clients) < 0) return -1;
+        } else if ((m = match_option(argc, argv, &i, "--cpus", &value)) != 0) {
+            if (m < 0 || parse_int_option("--cpus", value, 1, &config->num_cpus) < 0) return -1;
+            if (config->num_cpus > MAX_CPUS) {
+                fprintf(stderr, "Error: at most %d CPUs are supported\n", MAX_CPUS);
+                return -1;
+            }
+        } else if ((m = match_option(argc, argv, &i, "--scheduler", &value)) != 0) {
+            if (m < 0) return -1;
+            if (set_scheduler(value) < 0) {
+                fprintf(stderr, "Error: unknown scheduler: %s\nAvailable schedulers:\n", value);
+                list_schedulers(stderr);
                 return -1;
             }
+        } else if ((m = match_option(argc, argv, &i, "--slice", &value)) != 0) {
+            int slice_ms;
+            if (m < 0 || parse_int_option("--slice", value, TICKS_MS, &slice_ms) < 0) return -1;
+            sched_time_slice_ms = (uint32_t) slice_ms;
+        } else if ((m = match_option(argc, argv, &i, "--sched-latency", &value)) != 0) {
+            int latency_ms;
+            if (m < 0 || parse_int_option("--sched-latency", value, TICKS_MS, &latency_ms) < 0) return -1;
+            cfs_target_latency_ms = (uint32_t) latency_ms;
+        } else if ((m = match_option(argc, argv, &i, "--min-granularity", &value)) != 0) {
+            int granularity_ms;
+            if (m < 0 || parse_int_option("--min-granularity", value, TICKS_MS, &granularity_ms) < 0) return -1;
+            cfs_min_granularity_ms = (uint32_t) granularity_ms;
+        } else if ((m = match_option(argc, argv, &i, "--mlfq-levels", &value)) != 0) {
+            if (m < 0 || parse_int_option("--mlfq-levels", value, 1, &mlfq_levels) < 0) return -1;
+            if (mlfq_levels > MLFQ_MAX_LEVELS) {
+                fprintf(stderr, "Error: at most %d MLFQ levels are supported\n", MLFQ_MAX_LEVELS);
+                return -1;
+            }
+        } else if ((m = match_option(argc, argv, &i, "--mlfq-quantum", &value)) != 0) {
+            if (m < 0) return -1;
+            if (mlfq_set_quanta(value) < 0) {
+                fprintf(stderr, "Error: invalid value for --mlfq-quantum: %s (expected <ms>[,<ms>...], each >= %d)\n",
+                        value, TICKS_MS);
+                return -1;
+            }
+        } else if ((m = match_option(argc, argv, &i, "--mlfq-boost", &value)) != 0) {
+            int boost_ms;
+            if (m < 0 || parse_int_option("--mlfq-boost", value, 0, &boost_ms) < 0) return -1;
+            mlfq_boost_ms = (uint32_t) boost_ms;
+        } else if ((m = match_option(argc, argv, &i, "--trace", &value)) != 0) {
+            if (m < 0) return -1;
+            config->trace_path = value;
+        } else if ((m = match_option(argc, argv, &i, "--tlb-entries", &value)) != 0) {
+            if (m < 0 || parse_int_option("--tlb-entries", value, 0, &tlb_config.entries) < 0) return -1;
+        } else if ((m = match_option(argc, argv, &i, "--tlb-ways", &value)) != 0) {
+            if (m < 0 || parse_int_option("--tlb-ways", value, 1, &tlb_config.ways) < 0) return -1;
+        } else if ((m = match_option(argc, argv, &i, "--tlb-replacement", &value)) != 0) {
+            if (m < 0) return -1;
+            if (tlb_set_replacement(value) < 0) {
+                fprintf(stderr, "Error: invalid value for --tlb-replacement: %s (expected lru, fifo or random)\n",
+                        value);
+                return -1;
+            }
+        } else if ((m = match_option(argc, argv, &i, "--tlb-walk-ns", &value)) != 0) {
+            int walk_ns;
+            if (m < 0 || parse_int_option("--tlb-walk-ns", value, 0, &walk_ns) < 0) return -1;
+            tlb_config.walk_ns = (uint32_t) walk_ns;
+        } else if ((m = match_option(argc, argv, &i, "--swap-file", &value)) != 0) {
+            if (m < 0) return -1;
+            config->swap_path = value;
+        } else if ((m = match_option(argc, argv, &i, "--swap-size", &value)) != 0) {
+            if (m < 0 || parse_int_option("--swap-size", value, 1, &config->swap_size_mb) < 0) return -1;
+            if (config->swap_size_mb > (int) (UINT32_MAX / (1024 * 1024 / SWAP_PAGE_SIZE))) {
+                fprintf(stderr, "Error: --swap-size is too large\n");
+                return -1;
+            }
+        } else if ((m = match_option(argc, argv, &i, "--swap-latency-us", &value)) != 0) {
+            int latency_us;
+            if (m < 0 || parse_int_option("--swap-latency-us", value, 0, &latency_us) < 0) return -1;
+            swap_latency_us = (uint32_t) latency_us;
+        } else if ((m = match_option(argc, argv, &i, "--swap-bandwidth", &value)) != 0) {
+            int bandwidth_mbs;
+            if (m < 0 || parse_int_option("--swap-bandwidth", value, 0, &bandwidth_mbs) < 0) return -1;
+            swap_bandwidth_mbs = (uint32_t) bandwidth_mbs;
+        } else if ((m = match_option(argc, argv, &i, "--kswapd-interval", &value)) != 0) {
+            int interval_ms;
+            if (m < 0 || parse_int_option("--kswapd-interval", value, 1, &interval_ms) < 0) return -1;
+            kswapd_config.interval_ms = (uint32_t) interval_ms;
+        } else if ((m = match_option(argc, argv, &i, "--pff-interval", &value)) != 0) {
+            int interval;
+            if (m < 0 || parse_int_option("--pff-interval", value, 1, &interval) < 0) return -1;
+            vm_load_config.pff_interval = (uint32_t) interval;
+        } else if ((m = match_option(argc, argv, &i, "--readahead", &value)) != 0) {
+            int pages;
+            if (m < 0 || parse_int_option("--readahead", value, 0, &pages) < 0) return -1;
+            readahead_config.max_pages = (uint32_t) pages;
+        } else if (strcmp(argv[i], "--load-control") == 0) {
+            vm_load_config.enabled = 1;
+        } else if (strcmp(argv[i], "--kswapd") == 0) {
+            kswapd_config.enabled = 1;
+        } else if (strcmp(argv[i], "--tlb-flush") == 0) {
+            tlb_config.flush_on_switch = 1;
+        } else if (strcmp(argv[i], "--opt") == 0) {
+            vm_opt_enabled = 1;
         } else if (strcmp(argv[i], "--help") == 0) {
-            printf("Usage: %s [--pages <num>] [--frames <num>] [--threshold <num>]\n", argv[0]);
+            printf("Usage: %s [--pages <num>] [--frames <num>] [--threshold <num>] [--policy <name>] [--opt]\n"
+                   "       [--trace <file>]\n"
+                   "       [--tlb-entries <num>] [--tlb-ways <num>] [--tlb-replacement lru|fifo|random]\n"
+                   "       [--tlb-flush] [--tlb-walk-ns <ns>]\n"
+                   "       [--swap-file <path>] [--swap-size <MiB>] [--swap-latency-us <us>] [--swap-bandwidth <MB/s>]\n"
+                   "       [--kswapd] [--kswapd-interval <ms>] [--load-control] [--pff-interval <accesses>]\n"
+                   "       [--readahead <pages>]\n"
+                   "       [--clock=real|virtual] [--clients <num>] [--cpus <num>]\n"
+                   "       [--scheduler <name>] [--slice <ms>]\n"
+                   "       [--sched-latency <ms>] [--min-granularity <ms>]\n"
+                   "       [--mlfq-levels <num>] [--mlfq-quantum <ms>[,<ms>...]] [--mlfq-boost <ms>]\n", argv[0]);
+            printf("Schedulers:\n");
+            list_schedulers(stdout);
+            printf("Page replacement policies:\n");
+            list_vm_policies(stdout);
             return 1;  // signal "show help"
         } else {
             fprintf(stderr, "Unknown option: %s\n", argv[i]);
@@ -85,112 +239,498 @@ int parse_args(int argc, char *argv[], int *pages, int *frames, int *threshold)
     return 0;
 }
 
+/**
+ * @brief Compute how far the virtual clock can jump after the current tick.
+ *
+ * Nothing changes in the simulation between events, so instead of ticking through
+ * idle time we jump straight to the next burst end, slice end or block expiry.
+ *
+ * @return The step in milliseconds (a multiple of TICKS_MS), or 0 if there is nothing
+ *         pending at all and the simulator should wait for a new client
+ */
+static uint32_t next_virtual_step(uint32_t current_time_ms, queue_t *command_queue,
+                                  timer_wheel_t *blocked_queue, cpu_t *cpus, int num_cpus) {
+    // A client that just got a DONE will send its next request for the next tick,
+    // a scripted one (or one whose request is buffered already) goes on then
+    if (command_queue->head || deferred_commands_pending()) return TICKS_MS;
+
+    uint32_t next = scheduler_next_event_ms(current_time_ms, cpus, num_cpus);
+    uint32_t blocked = blocked_queue_next_event_ms(blocked_queue, current_time_ms);
+    if (blocked < next) next = blocked;
+
+    if (next == UINT32_MAX) return 0;
+    if (next < TICKS_MS) return TICKS_MS;
+    return ((next + TICKS_MS - 1) / TICKS_MS) * TICKS_MS;
+}
+
+/**
+ * @brief Block until every client in the command queue has sent its next instruction.
+ *
+ * This is the lockstep part of the virtual clock: the tick is only complete once
+ * every connected client has been serviced.
+ */
+static void wait_for_clients(queue_t *command_queue, timer_wheel_t *blocked_queue, queue_t *ready_queue,
+                             queue_t *terminated_queue, frame_table_t *frame_table, swap_hash_t *swap, int server_fd,
+                             uint32_t current_time_ms) {
+    while (keep_running && command_queue->head) {
+        if (wait_for_commands(-1) < 0) return;
+        check_new_commands(command_queue, blocked_queue, ready_queue, terminated_queue, frame_table, swap, server_fd,
+                           current_time_ms);
+    }
+}
+
+/**
+ * @brief Print the page fault statistics, and the comparison with OPT when it was recorded.
+ */
+static void print_fault_stats(frame_table_t *frame_table) {
+    double fault_rate = (total_page_accesses > 0)
+    ? (100.0 * total_page_faults / total_page_accesses)
+    : 0.0;
+    printf("Page Faults: %d\n", total_page_faults);
+    printf("Swaps In: %d\n", total_swaps_in);
+    printf("Swaps Out: %d\n", total_swaps_out);
+    printf("Escritas evitadas (swap cache): %d\n", total_swap_writes_avoided);
+    printf("Taxa de Page Faults: %.2f%%\n", fault_rate);
+    printf("Memória das page tables (pico): %.1f KiB\n", page_table_peak_bytes() / 1024.0);
+    if (vm_opt_enabled) {
+        // Entre dois acessos ficam residentes no máximo capacity - 1 páginas (page_eviction corre antes de cada um)
+        long opt_faults = vm_opt_faults(frame_table->capacity - 1);
+        if (opt_faults >= 0) {
+            long extra = total_page_faults - opt_faults;
+            printf("Page Faults com OPT (Belady): %ld, a mais com %s: %ld (+%.2f%%)\n", opt_faults,
+                   policy_to_string(current_policy), extra, opt_faults ? 100.0 * extra / opt_faults : 0.0);
+        } else {
+            printf("Page Faults com OPT (Belady): indisponível\n");
+        }
+    }
+}
+
+/**
+ * @brief Print the TLB statistics of all CPUs together.
+ */
+static void print_tlb_stats(const tlb_stats_t *stats) {
+    if (tlb_config.entries == 0) {
+        printf("TLB: desativada\n");
+        return;
+    }
+    uint64_t lookups = stats->hits + stats->misses;
+    printf("TLB: %d entradas, %d vias, substituição %s, %s\n", tlb_config.entries, tlb_config.ways,
+           tlb_replacement_to_string(tlb_config.replacement),
+           tlb_config.flush_on_switch ? "flush em cada troca de processo" : "entradas mantidas (ASID)");
+    printf("TLB Hits: %llu, Misses: %llu, Taxa de acertos: %.2f%%, Flushes: %llu\n",
+           (unsigned long long) stats->hits, (unsigned long long) stats->misses,
+           lookups ? 100.0 * stats->hits / lookups : 0.0, (unsigned long long) stats->flushes);
+    double penalty_ns = (double) stats->walk_levels * tlb_config.walk_ns;
+    printf("Penalidade dos TLB misses: %.1f us (%.2f níveis da page table e %.0f ns por miss, %.1f ns por acesso)\n",
+           penalty_ns / 1000.0, stats->misses ? (double) stats->walk_levels / stats->misses : 0.0,
+           stats->misses ? penalty_ns / stats->misses : 0.0, lookups ? penalty_ns / lookups : 0.0);
+}
+
+/**
+ * @brief Print how busy the swap device was and how long page faults waited for it.
+ */
+static void print_swap_device_stats(const swap_device_t *dev, uint32_t current_time_ms) {
+    printf("Disco de swap: latência %u us, ", swap_latency_us);
+    if (swap_bandwidth_mbs > 0) {
+        printf("%u MB/s\n", swap_bandwidth_mbs);
+    } else {
+        printf("transferência instantânea\n");
+    }
+    printf("Leituras: %llu, Escritas: %llu, Utilização: %.2f%%, Fila máxima: %u pedidos\n",
+           (unsigned long long) dev->reads, (unsigned long long) dev->writes,
+           current_time_ms ? 100.0 * dev->busy_us / (current_time_ms * 1000.0) : 0.0, dev->max_queued);
+    printf("Espera média por uma página do swap: %.2f ms\n",
+           dev->reads ? dev->read_wait_us / 1000.0 / dev->reads : 0.0);
+}
+
+/**
+ * @brief Print how full and fragmented the swap space got, and the time spent in the swap file.
+ */
+static void print_swap_space_stats(const swap_space_t *space) {
+    uint32_t partial = swap_partial_clusters(space);
+    printf("Espaço de swap: %u páginas (%s), ocupação máxima: %u páginas, no fim: %u\n", space->nslots,
+           space->fd >= 0 ? "ficheiro" : "sem ficheiro", space->max_used, space->used);
+    printf("Clusters parcialmente ocupados: %u, Slots atribuídos em buracos: %llu, Swap cheio: %llu vezes\n",
+           partial, (unsigned long long) space->fragmented_allocs, (unsigned long long) space->failed_allocs);
+    if (space->fd >= 0) {
+        uint64_t ios = space->file_writes + space->file_reads;
+        printf("I/O no ficheiro de swap: %llu escritas, %llu leituras, %.3f s (%.1f us por página)\n",
+               (unsigned long long) space->file_writes, (unsigned long long) space->file_reads,
+               space->file_io_ns / 1e9, ios ? space->file_io_ns / 1e3 / ios : 0.0);
+    }
+}
+
+/**
+ * @brief Print how the frames were reclaimed: on the path of the accesses, and by kswapd.
+ */
+static void print_reclaim_stats(const kswapd_t *kswapd) {
+    printf("Reclaim direto: %d frames, em %d acessos\n", total_direct_reclaims, total_direct_reclaim_stalls);
+    if (readahead_config.max_pages > 0) printf("Reclaim para readahead: %d frames\n", total_readahead_reclaims);
+    if (!kswapd_config.enabled) {
+        printf("kswapd: desativado\n");
+        return;
+    }
+    printf("kswapd: %llu frames em %llu de %llu execuções (a cada %u ms)\n",
+           (unsigned long long) kswapd->stats.reclaimed, (unsigned long long) kswapd->stats.wakeups,
+           (unsigned long long) kswapd->stats.runs, kswapd_config.interval_ms);
+    printf("Watermarks: min %d, low %d, high %d no fim (high máximo %d)\n", kswapd->min, kswapd->low, kswapd->high,
+           kswapd->stats.max_high);
+}
+
+/**
+ * @brief Print the demand for memory (the PFF budgets) and what the load control did about it.
+ */
+static void print_load_stats(const frame_table_t *frame_table) {
+    printf("Procura de frames (PFF): máximo %d, capacidade %d, ticks em sobrecarga: %llu\n",
+           vm_load.stats.max_demand, frame_table->capacity, (unsigned long long) vm_load.stats.overloaded_ticks);
+    if (!vm_load_config.enabled) return;
+    printf("Controlo de carga: %llu suspensões, %llu retomas, %llu frames libertadas\n",
+           (unsigned long long) vm_load.stats.suspensions, (unsigned long long) vm_load.stats.resumptions,
+           (unsigned long long) vm_load.stats.paged_out);
+}
+
+static void print_readahead_stats(void) {
+    if (readahead_config.max_pages == 0) return;
+    const readahead_stats_t *st = &readahead_stats;
+    uint64_t settled = st->hits + st->misses;
+    printf("Readahead: %llu janelas (%llu assíncronas), %llu páginas antecipadas\n",
+           (unsigned long long) st->windows, (unsigned long long) st->async_windows,
+           (unsigned long long) st->prefetched);
+    printf("Readahead: %llu acertos, %llu desperdiçadas (%.1f%% de acerto)\n", (unsigned long long) st->hits,
+           (unsigned long long) st->misses, settled ? 100.0 * (double) st->hits / (double) settled : 0.0);
+}
+
+static void print_shared_stats(void) {
+    if (vm_shared_stats.regions == 0) return;
+    printf("Regiões partilhadas: %u (%llu mapeamentos), faltas menores (frame já em RAM): %llu\n",
+           vm_shared_stats.regions, (unsigned long long) vm_shared_stats.attaches,
+           (unsigned long long) vm_shared_stats.minor_faults);
+    printf("Páginas partilhadas: máximo de %u PTEs a mapeá-las, %llu desmapeadas na evicção\n",
+           vm_shared_stats.max_mapped, (unsigned long long) vm_shared_stats.unmaps);
+}
+
+static void print_fork_stats(void) {
+    if (total_forks == 0) return;
+    // Sem copy-on-write, cada página partilhada no fork teria sido copiada logo
+    long avoided = total_cow_shared - total_cow_copies;
+    printf("Forks: %d, páginas partilhadas (copy-on-write): %ld, copiadas na primeira escrita: %ld\n",
+           total_forks, total_cow_shared, total_cow_copies);
+    printf("Cópias evitadas face à cópia imediata: %ld (%.1f%%)\n", avoided,
+           total_cow_shared ? 100.0 * (double) avoided / (double) total_cow_shared : 0.0);
+}
+
+/**
+ * @brief Replay a page reference trace (--trace) and report on it.
+ *
+ * No clients, sockets or clock: the references go straight to the virtual memory.
+ */
+static int run_trace_mode(const ossim_config_t *config, frame_table_t *frame_table, swap_hash_t *swap) {
+    printf("OSSIM replaying %s with %d frames, threshold %d, policy %s\n", config->trace_path,
+           config->num_frames, config->min_pages_threshold, policy_to_string(current_policy));
+
+    // The trace has no CPUs: its references go through one TLB, switched whenever the pid changes
+    tlb_t tlb;
+    if (tlb_init(&tlb) < 0) return EXIT_FAILURE;
+    kswapd_t kswapd;
+    kswapd_init(&kswapd, frame_table, config->min_pages_threshold);
+
+    struct timespec wall_start, wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+    int res = trace_run(config->trace_path, frame_table, swap, &tlb, &kswapd, config->min_pages_threshold);
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    double wall_s = (double) (wall_end.tv_sec - wall_start.tv_sec)
+                    + (double) (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+
+    printf("\n================== Dados de execução do OSSIM =================\n");
+    printf("Trace: %s\n", config->trace_path);
+    printf("Frames: %d, Threshold: %d\n", config->num_frames, config->min_pages_threshold);
+    printf("Acessos a Páginas: %d\n", total_page_accesses);
+    printf("Algoritmo utilizado: %s\n", policy_to_string(current_policy));
+    print_fault_stats(frame_table);
+    print_reclaim_stats(&kswapd);
+    print_load_stats(frame_table);
+    print_readahead_stats();
+    print_shared_stats();
+    print_fork_stats();
+    print_tlb_stats(&tlb.stats);
+    print_swap_space_stats(&swap->space);
+    swap_space_free(&swap->space);
+    swap_map_free(&swap->pages);
+    vm_shared_free();
+    free(tlb.entries);
+    printf("Tempo de execução: %.3f s (%.0f acessos/s)\n", wall_s,
+           wall_s > 0 ? total_page_accesses / wall_s : 0.0);
+    return res < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 int main(int argc, char *argv[]) {
 
-    int num_pages = 20;
-    int num_frames = 30;
-    int min_pages_threshold = 4;
+    ossim_config_t config = {
+        .num_pages = 20,
+        .num_frames = 30,
+        .min_pages_threshold = 4,
+        .clock_mode = CLOCK_REAL,
+        .wait_clients = 0,
+        .num_cpus = 1,
+        .trace_path = NULL,
+        .swap_path = NULL,
+        .swap_size_mb = 1024,
+    };
 
-    int res = parse_args(argc, argv, &num_pages, &num_frames, &min_pages_threshold);
+    int res = parse_args(argc, argv, &config);
     if (res > 0) { // help shown
         return EXIT_SUCCESS;
     } else if (res < 0) {
         return EXIT_FAILURE;
     }
+    int num_pages = config.num_pages;
+    int num_frames = config.num_frames;
+    int min_pages_threshold = config.min_pages_threshold;
+    uint32_t swap_slots = (uint32_t) config.swap_size_mb * (1024 * 1024 / SWAP_PAGE_SIZE);
+
+    if (config.trace_path) {
+        frame_table_t *frame_table = create_frame_table(num_frames, min_pages_threshold);
+        if (!frame_table) return EXIT_FAILURE;
+        swap_hash_t swap = {.last_swap_time_ms = 0, .num_swapped = 0};
+        if (swap_space_init(&swap.space, config.swap_path, swap_slots) < 0) return EXIT_FAILURE;
+        return run_trace_mode(&config, frame_table, &swap);
+    }
 
     // Catch CTRL-C and termination signals to exit gracefully
     signal(SIGINT, handle_signal);
     signal(SIGTERM, handle_signal);
 
-    printf("OSSIM Scheduler configured with %d pages and %d frames\n", num_pages, num_frames);
+    printf("OSSIM Scheduler configured with %d pages, %d frames and %d CPU(s), scheduler %s\n",
+           num_pages, num_frames, config.num_cpus, current_scheduler->name);
 
     // We set up 3 queues: 1 for the simulator and 2 for scheduling
     // - COMMAND queue: for PCBs that are waiting for (new) instructions from the app
-    // - READY queue: for PCBs that are ready to run on the CPU
-    // - BLOCKED queue: for PCBs that are blocked waiting for I/O
+    // - READY queue: for PCBs that became ready to run; the scheduler moves them to a CPU's own ready queue
+    // - BLOCKED queue: for PCBs that are blocked waiting for I/O (a timing wheel on the wake-up time)
     queue_t command_queue = {.head = NULL, .tail = NULL};
     queue_t ready_queue = {.head = NULL, .tail = NULL};
-    queue_t blocked_queue = {.head = NULL, .tail = NULL};
+    timer_wheel_t blocked_queue;
+    timer_wheel_init(&blocked_queue, 0);
+    // PCBs of clients that disconnected, their memory is released at the end of the tick
+    queue_t terminated_queue = {.head = NULL, .tail = NULL};
+    // PCBs taken out of READY by the load control (--load-control) while the memory is overcommitted
+    queue_t suspended_queue = {.head = NULL, .tail = NULL};
 
-    // We only have a single CPU that is a pointer to the actively running PCB on the CPU
-    pcb_t *CPU = NULL;
+    // Every CPU points to the PCB actively running on it and has its own ready queue
+    int num_cpus = config.num_cpus;
+    cpu_t *cpus = create_cpus(num_cpus);
+    if (!cpus) return EXIT_FAILURE;
 
-    frame_table_t *frame_table = create_frame_table(num_frames);
-    swap_hash_t swap = {.last_swap_time_ms = 0, .num_swapped = 0, .pages = NULL};
+    frame_table_t *frame_table = create_frame_table(num_frames, min_pages_threshold);
+    swap_hash_t swap = {.last_swap_time_ms = 0, .num_swapped = 0};
+    swap_device_init(&swap.device);
+    if (swap_space_init(&swap.space, config.swap_path, swap_slots) < 0) return EXIT_FAILURE;
+    kswapd_t kswapd;
+    kswapd_init(&kswapd, frame_table, min_pages_threshold);
 
     int server_fd = setup_server_socket(SOCKET_PATH);
     if (server_fd < 0) {
         fprintf(stderr, "Failed to set up server socket\n");
         return 1;
     }
-    printf("Scheduler server listening on %s...\n", SOCKET_PATH);
+    printf("Scheduler server listening on %s (%s clock)...\n", SOCKET_PATH,
+           config.clock_mode == CLOCK_VIRTUAL ? "virtual" : "real");
     uint32_t current_time_ms = 0;
+    uint32_t last_report_s = UINT32_MAX;
+
+    struct timespec wall_start;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+    // With the virtual clock the first client could otherwise finish before the others
+    // have even connected, so hold the clock until everyone is here
+    if (config.clock_mode == CLOCK_VIRTUAL && config.wait_clients > 0) {
+        printf("Waiting for %d clients...\n", config.wait_clients);
+        while (keep_running && get_connected_clients() < config.wait_clients) {
+            if (wait_for_commands(-1) < 0) break;
+            check_new_commands(&command_queue, &blocked_queue, &ready_queue, &terminated_queue, frame_table, &swap,
+                               server_fd, current_time_ms);
+        }
+    }
 
     while (keep_running) {
         // Check for new connections and/or instructions
-        check_new_commands(&command_queue, &blocked_queue, &ready_queue, server_fd, current_time_ms);
-        check_blocked_queue(&blocked_queue, &command_queue, current_time_ms);
+        check_new_commands(&command_queue, &blocked_queue, &ready_queue, &terminated_queue, frame_table, &swap,
+                           server_fd, current_time_ms);
+        check_blocked_queue(&blocked_queue, &command_queue, &ready_queue, current_time_ms);
 
-        if (current_time_ms%1000 == 0) {
-            printf("Current time: %d s\n", current_time_ms/1000);
+        if (current_time_ms / 1000 != last_report_s) {
+            last_report_s = current_time_ms / 1000;
+            printf("Current time: %d s\n", last_report_s);
+        }
+        if (config.clock_mode == CLOCK_REAL) {
+            usleep(TICKS_MS * 1000/2);
+        } else {
+            wait_for_clients(&command_queue, &blocked_queue, &ready_queue, &terminated_queue, frame_table, &swap,
+                             server_fd, current_time_ms);
         }
-        usleep(TICKS_MS * 1000/2);
 
         // Tasks from the blocked queue could be moved to the command queue, check again
-        check_new_commands(&command_queue, &blocked_queue, &ready_queue, server_fd, current_time_ms);
-        check_blocked_queue(&blocked_queue, &command_queue, current_time_ms);
-
-        // The scheduler handles the READY queue
-        if (scheduler(current_time_ms, &ready_queue, &command_queue, &CPU) > 0 && CPU) {
-            for (uint32_t i = 0; i < CPU->requested_pages.count; i++) {
-                int vfn = CPU->requested_pages.ids[i];
-                int is_dirty = 0;
-
-                // Negative page number means write; normalize
-                if (vfn < 0) {
-                    is_dirty = 1;
-                    vfn = -vfn;
-                }
-                page_eviction(frame_table, &swap, min_pages_threshold);
+        check_new_commands(&command_queue, &blocked_queue, &ready_queue, &terminated_queue, frame_table, &swap,
+                           server_fd, current_time_ms);
+        check_blocked_queue(&blocked_queue, &command_queue, &ready_queue, current_time_ms);
+
+        // Load control: suspended processes run again, first suspended first, once their frames fit
+        vm_load_tick(frame_table);
+        pcb_t *suspended;
+        while ((suspended = suspended_queue.head) != NULL && vm_load_can_resume(suspended, frame_table)) {
+            dequeue_pcb(&suspended_queue);
+            vm_load_resume(suspended);
+            suspended->status = TASK_RUNNING;
+            suspended->last_update_time_ms = current_time_ms;
+            enqueue_pcb(&ready_queue, suspended);
+        }
+
+        // kswapd frees frames between the ticks, so the accesses below do not have to
+        kswapd_run(&kswapd, current_time_ms, frame_table, &swap);
 
-                pte_t *vp = page_request(current_time_ms,CPU, frame_table, &swap, vfn);
-                vp->last_accessed = current_time_ms;
+        // The scheduler handles the READY queue; every CPU that got a new task accesses its pages.
+        // A task that has to wait for a page from swap (or is suspended) leaves its CPU, which takes the next task right away
+        int dispatched = scheduler(current_time_ms, &ready_queue, &command_queue, cpus, num_cpus);
+        while (dispatched > 0) {
+            int vacated = 0;        // CPUs whose task left to wait for swap or was suspended
+            for (int c = 0; c < num_cpus; c++) {
+                pcb_t *CPU = cpus[c].task;
+                if (!cpus[c].dispatched || !CPU) continue;
+                // After a wait for swap the burst goes on with the page after the one that faulted
+                uint32_t i = CPU->page_cursor;
+                CPU->page_cursor = 0;
+                for (; i < CPU->requested_pages.count; i++) {
+                    int32_t page = CPU->requested_pages.ids[i];
+                    int is_dirty = 0;
 
-                if (!vp) {
-                    printf("ERROR: Cannot request a page %d for process %d\n", vfn, CPU->pid);
-                    continue;
+                    // Negative page number means write; normalize
+                    uint32_t vfn = (uint32_t) page;
+                    if (page < 0) {
+                        is_dirty = 1;
+                        vfn = -(uint32_t) page;
+                    }
+                    page_eviction(current_time_ms, frame_table, &swap, min_pages_threshold);
+
+                    pte_t *vp = tlb_access(&cpus[c].tlb, current_time_ms, CPU, frame_table, &swap, vfn, is_dirty);
+
+                    if (!vp) {
+                        printf("ERROR: Cannot request a page %u for process %d\n", vfn, CPU->pid);
+                        continue;
+                    }
+                    if (CPU->swap_ready_ms) {
+                        CPU->page_cursor = i + 1;
+                        CPU->status = TASK_SWAP_WAIT;
+                        timer_wheel_add(&blocked_queue, CPU, CPU->swap_ready_ms);
+                        CPU->swap_ready_ms = 0;
+                        cpus[c].task = NULL;
+                        cpus[c].swap_waits++;
+                        vacated++;
+                        break;
+                    }
+                    if (vm_load_should_suspend(CPU, frame_table)) {
+                        // Thrashing: this process waits out of READY, and its frames go to the others
+                        CPU->page_cursor = i + 1;
+                        CPU->status = TASK_SUSPENDED;
+                        vm_load_suspend(CPU, page_out_process(current_time_ms, frame_table, &swap, CPU));
+                        enqueue_pcb(&suspended_queue, CPU);
+                        cpus[c].task = NULL;
+                        vacated++;
+                        break;
+                    }
                 }
-                vp->referenced = 1;
-                vp->present = 1;
-                vp->last_accessed = current_time_ms;
-                vp->dirty = is_dirty ? 1 : vp->dirty;
             }
+            dispatched = vacated ? scheduler(current_time_ms, &ready_queue, &command_queue, cpus, num_cpus) : 0;
+        }
+
+        // Give the frames and swap of terminated processes back before their PCB is reused
+        pcb_t *terminated;
+        while ((terminated = dequeue_pcb(&terminated_queue)) != NULL) {
+            release_process_memory(frame_table, &swap, terminated);
+            free_pcb(terminated);
         }
 
         // Simulate a tick
-        usleep(TICKS_MS * 1000/2);
-        current_time_ms += TICKS_MS;
+        if (config.clock_mode == CLOCK_REAL) {
+            usleep(TICKS_MS * 1000/2);
+            current_time_ms += TICKS_MS;
+        } else {
+            uint32_t step = next_virtual_step(current_time_ms, &command_queue, &blocked_queue, cpus, num_cpus);
+            // Suspended processes, and ready tasks no CPU could take, are tried again on the next tick
+            if (step == 0 && (suspended_queue.head || ready_queue.head)) step = TICKS_MS;
+            if (step == 0) {
+                // Nobody is running, blocked or talking to us: wait for a new connection
+                wait_for_commands(-1);
+                step = TICKS_MS;
+            }
+            current_time_ms += step;
+        }
     }
 
+    struct timespec wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    double wall_s = (double) (wall_end.tv_sec - wall_start.tv_sec)
+                    + (double) (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+
     printf("[Scheduler] Cleaning up and shutting down...\n");
     close(server_fd);
     unlink(SOCKET_PATH);
     printf("[Scheduler] Shutdown complete.\n");
 
-    double fault_rate = (total_page_accesses > 0)
-    ? (100.0 * total_page_faults / total_page_accesses)
-    : 0.0;
     printf("\n================== Dados de execução do OSSIM =================\n");
     printf("Páginas: %d, Frames: %d, Threshold: %d\n", num_pages, num_frames, min_pages_threshold);
     printf("Acessos a Páginas: %d\n", total_page_accesses);
-    printf("Evictions: %d\n", total_swaps_out);
+    printf("Evictions: %d\n", total_swaps_out + total_swap_writes_avoided);
 
     printf("");
     printf("Algoritmo utilizado: %s\n", policy_to_string(current_policy));
-    printf("Page Faults: %d\n", total_page_faults);
-    printf("Swaps In: %d\n", total_swaps_in);
-    printf("Swaps Out: %d\n", total_swaps_out);
-    printf("Taxa de Page Faults: %.2f%%\n", fault_rate);
+    if (strcmp(current_scheduler->name, "cfs") == 0) {
+        printf("Escalonador: %s (latência %u ms, granularidade mínima %u ms)\n", current_scheduler->name,
+               cfs_target_latency_ms, cfs_min_granularity_ms);
+    } else if (strcmp(current_scheduler->name, "mlfq") == 0) {
+        printf("Escalonador: %s (%d níveis, quantum %u a %u ms, boost %u ms)\n", current_scheduler->name,
+               mlfq_levels, mlfq_quantum_ms(0), mlfq_quantum_ms(mlfq_levels - 1), mlfq_boost_ms);
+    } else {
+        printf("Escalonador: %s (time slice %u ms)\n", current_scheduler->name, sched_time_slice_ms);
+    }
+    print_fault_stats(frame_table);
+    print_reclaim_stats(&kswapd);
+    print_load_stats(frame_table);
+    print_readahead_stats();
+    print_shared_stats();
+    print_fork_stats();
+    uint64_t response_ms = 0, turnaround_ms = 0;
+    uint32_t responses = 0, completions = 0;
+    tlb_stats_t tlb_stats = {0};
+    for (int c = 0; c < num_cpus; c++) {
+        tlb_stats.hits += cpus[c].tlb.stats.hits;
+        tlb_stats.misses += cpus[c].tlb.stats.misses;
+        tlb_stats.flushes += cpus[c].tlb.stats.flushes;
+        tlb_stats.walk_levels += cpus[c].tlb.stats.walk_levels;
+        response_ms += cpus[c].response_ms;
+        responses += cpus[c].responses;
+        turnaround_ms += cpus[c].turnaround_ms;
+        completions += cpus[c].completions;
+    }
+    printf("Tempo de resposta médio: %.2f ms (%u bursts), Turnaround médio: %.2f ms (%u bursts)\n",
+           responses ? (double) response_ms / responses : 0.0, responses,
+           completions ? (double) turnaround_ms / completions : 0.0, completions);
+    print_tlb_stats(&tlb_stats);
+    print_swap_device_stats(&swap.device, current_time_ms);
+    print_swap_space_stats(&swap.space);
+    swap_device_free(&swap.device);
+    swap_space_free(&swap.space);
+    swap_map_free(&swap.pages);
+    vm_shared_free();
+    for (int c = 0; c < num_cpus; c++) {
+        double utilization = (current_time_ms > 0) ? (100.0 * cpus[c].busy_ms / current_time_ms) : 0.0;
+        uint64_t lookups = cpus[c].tlb.stats.hits + cpus[c].tlb.stats.misses;
+        printf("CPU %d: Utilização %.2f%%, Dispatches: %u, Preempções: %u, Migrações: %u, Roubos: %u, "
+               "Esperas por swap: %u, TLB: %.2f%%\n", c, utilization, cpus[c].dispatches, cpus[c].preemptions,
+               cpus[c].migrations, cpus[c].steals, cpus[c].swap_waits,
+               lookups ? 100.0 * cpus[c].tlb.stats.hits / lookups : 0.0);
+    }
+    printf("Tempo simulado: %u ms (tempo real: %.3f s, relógio %s)\n", current_time_ms, wall_s,
+           config.clock_mode == CLOCK_VIRTUAL ? "virtual" : "real");
 
 
 
@@ -5,9 +5,37 @@
 #ifndef OSSIM_H
 #define OSSIM_H
 
+#include <stdint.h>
+
 extern int total_page_faults;
 extern int total_swaps_in;
 extern int total_swaps_out;
+extern int total_swap_writes_avoided;   // Clean evictions of pages whose copy was still in swap
 extern int total_page_accesses;
+extern int total_direct_reclaims;         // Frames evicted on the path of a page access (page_eviction)
+extern int total_direct_reclaim_stalls;   // Page accesses that had to evict first
+extern int total_readahead_reclaims;      // Frames evicted to make room for a readahead window
+extern int total_forks;
+extern long total_cow_shared;             // Pages a fork shared instead of copying them
+extern long total_cow_copies;             // Pages copied on the first write after a fork, in RAM or in swap
+
+// How the simulation clock advances
+typedef enum {
+    CLOCK_REAL = 0,     // One tick every TICKS_MS of wall-clock time (usleep)
+    CLOCK_VIRTUAL,      // Lockstep: advance as soon as all clients were serviced, skip idle time
+} clock_mode_t;
+
+// Command line configuration of the simulator
+typedef struct ossim_config_st {
+    int num_pages;
+    int num_frames;
+    int min_pages_threshold;
+    clock_mode_t clock_mode;
+    int wait_clients;           // Virtual clock only: hold time at 0 until this many clients connected
+    int num_cpus;               // Number of simulated CPUs
+    const char *trace_path;     // Replay this page reference trace instead of serving clients
+    const char *swap_path;      // Swap file the swapped out pages are written to, NULL for none
+    int swap_size_mb;           // Size of the swap space
+} ossim_config_t;
 
 #endif //OSSIM_H
@@ -7,6 +7,8 @@
 #include <stdint.h>
 
 #include "msg.h"
+#include "rbtree.h"
+#include "wire.h"
 #include "virtmem_types.h"
 
 typedef enum  {
@@ -15,8 +17,26 @@ typedef enum  {
     TASK_RUNNING,       // Task is in the ready queue or currently running
     TASK_STOPPED,       // Task has finished execution (sent DONE), waiting for more messages
     TASK_TERMINATED,    // Task has been terminated and will be removed
+    TASK_SWAP_WAIT,     // Task page-faulted and waits until the page is read from swap
+    TASK_SUSPENDED,     // Task was taken out of READY by the load control (see vm_load.h)
 } task_status_en;
 
+// One burst of a script uploaded with SCRIPT: run, then block
+typedef struct {
+    uint32_t run_ms;
+    uint32_t block_ms;
+    int32_t nice;
+    page_info_t pages;
+} script_burst_t;
+
+// Bursts uploaded by the application and not started yet (ring buffer)
+typedef struct {
+    script_burst_t *bursts;
+    uint32_t head;
+    uint32_t count;
+    uint32_t capacity;
+} burst_script_t;
+
 // Define the Process Control Block (PCB) structure
 typedef struct pcb_st{
     int32_t pid;                   // Process ID
@@ -26,9 +46,40 @@ typedef struct pcb_st{
     uint32_t slice_start_ms;       // Time when the current time slice started
     uint32_t sockfd;               // Socket file descriptor for communication with the application
     uint32_t last_update_time_ms;  // Last time the PCB was updated
+    uint32_t wakeup_time_ms;       // Absolute time at which the current BLOCK ends
+    int32_t last_cpu;              // CPU the task last ran on (-1 if it never ran)
+    int32_t nice;                  // Nice value of the current burst (lower is more important)
+    uint32_t ready_time_ms;        // Time the current burst was submitted (RUN)
+    int32_t first_run_pending;     // Set until the current burst gets a CPU for the first time
+    uint64_t vruntime;             // CFS: weighted running time in us (see sched_cfs.c)
+    rb_node_t run_node;            // CFS: node in the ready tree of a CPU
+    int32_t mlfq_level;            // MLFQ: current level, 0 is the highest priority
+    uint32_t mlfq_epoch;           // MLFQ: boost period in which the level was last set
 
     page_info_t requested_pages;   // Pages requested by the application
+    uint32_t page_cursor;          // Next of the requested pages to access (after waiting for swap)
+    uint32_t swap_ready_ms;        // Set by page_request(): the page read from swap arrives then (0: none)
+    burst_script_t script;         // Pipelined protocol: bursts still to run
+    uint32_t script_block_ms;      // Pipelined protocol: block to start when the running burst is DONE
+    uint32_t script_expect;        // Pipelined protocol: RUN messages of a SCRIPT still to come
+    wire_rx_t rx;                  // Bytes received from the application and not handled yet
+    wire_buf_t tx;                 // Messages to the application its socket had no room for yet
     page_table_t page_table;       // Pages allocated to the application
+    uint32_t rss;                  // Resident set: frames holding pages of the application
+    uint32_t frame_budget;         // Frames it needs, estimated from its page fault frequency (vm_load.h)
+    uint32_t vm_accesses;          // Page accesses made so far
+    uint32_t vm_faults;            // Page faults taken so far
+    uint32_t last_fault_access;    // vm_accesses at the last page fault
+    int32_t in_demand;             // Its budget counts in the demand for memory (not suspended)
+    uint32_t ra_prev_fault;        // Readahead: page of the last fault
+    int32_t ra_stride;             // Readahead: distance between the last two faults (0: no pattern)
+    uint32_t ra_size;              // Readahead: current window, 0 if no pattern was seen
+    uint32_t ra_next;              // Readahead: page after the last one the window tried
+    struct shared_map_st *shared_maps; // Shared regions mapped into the application (vm_shared.h)
+
+    struct pcb_st *prev;           // Links of the queue the PCB is in (see queue.h)
+    struct pcb_st *next;
+    struct queue_st *queue;        // Queue the PCB is in, NULL if none (e.g. running on the CPU)
 } pcb_t;
 
 #endif //PCB_H
@@ -4,19 +4,57 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/epoll.h>
 #include <sys/errno.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 
 #include "virtmem.h"
+#include "vm_shared.h"
+#include "timer_wheel.h"
+#include "wire.h"
 
 #include "debug.h"
 
 static uint32_t PID = 0;
+static int connected_clients = 0;   // Clients with an open connection (in any queue or on the CPU)
+static int epoll_fd = -1;           // Readiness notifications for the listening socket and COMMAND clients
+// PCBs that go on at the next check without waiting for their socket: scripted PCBs between
+// two phases, and PCBs whose next message was read from the socket together with the previous one
+static queue_t deferred_queue = {NULL, NULL};
+
+#define MAX_EVENTS 64
+
+// PCBs are carved out of slabs and recycled through a free list (linked with pcb->next),
+// so connecting clients only allocate when the pool has to grow
+#define PCB_SLAB_SIZE 64
+static pcb_t *pcb_pool = NULL;
+
+/**
+ * Grow the PCB pool with a new slab. Every PCB of the slab gets an empty page table,
+ * its levels are allocated as the process touches pages.
+ * @return 0 on success, -1 on failure
+ */
+static int grow_pcb_pool(void) {
+    pcb_t *slab = calloc(PCB_SLAB_SIZE, sizeof(pcb_t));
+    if (!slab) return -1;
+    for (int i = 0; i < PCB_SLAB_SIZE; i++) {
+        if (create_page_table(&slab[i].page_table) < 0) {
+            // Keep the PCBs that did get a page table
+            if (i == 0) free(slab);
+            return (i == 0) ? -1 : 0;
+        }
+        slab[i].next = pcb_pool;
+        pcb_pool = &slab[i];
+    }
+    return 0;
+}
 
 pcb_t *new_pcb(pid_t pid, uint32_t sockfd, uint32_t time_ms) {
-    pcb_t * new_task = malloc(sizeof(pcb_t));
-    if (!new_task) return NULL;
+    if (!pcb_pool && grow_pcb_pool() < 0) return NULL;
+    pcb_t *new_task = pcb_pool;
+    pcb_pool = new_task->next;
 
     new_task->pid = pid;
     new_task->status = TASK_COMMAND;
@@ -24,74 +62,157 @@ pcb_t *new_pcb(pid_t pid, uint32_t sockfd, uint32_t time_ms) {
     new_task->sockfd = sockfd;
     new_task->time_ms = time_ms;
     new_task->ellapsed_time_ms = 0;
+    new_task->last_update_time_ms = 0;
+    new_task->wakeup_time_ms = 0;
+    new_task->last_cpu = -1;
+    new_task->nice = 0;
+    new_task->ready_time_ms = 0;
+    new_task->first_run_pending = 0;
+    new_task->vruntime = 0;
+    new_task->mlfq_level = 0;
+    new_task->mlfq_epoch = 0;
+    new_task->rss = 0;
+    new_task->frame_budget = 0;
+    new_task->vm_accesses = 0;
+    new_task->vm_faults = 0;
+    new_task->last_fault_access = 0;
+    new_task->in_demand = 0;
+    new_task->ra_prev_fault = 0;
+    new_task->ra_stride = 0;
+    new_task->ra_size = 0;
+    new_task->ra_next = 0;
+    new_task->shared_maps = NULL;
+    new_task->prev = NULL;
+    new_task->next = NULL;
+    new_task->queue = NULL;
     // Initialize the allocated pages
+    new_task->script.head = 0;
+    new_task->script.count = 0;
+    new_task->script_block_ms = 0;
+    new_task->script_expect = 0;
+    // The page list, script and receive buffers are kept with the PCB in the pool, they only need to be emptied
     new_task->requested_pages.count = 0;
-    for (int i = 0; i < MAX_PAGES; i++) {
-        new_task->requested_pages.ids[i] = 0;
-    }
-    if (create_page_table(&new_task->page_table, MAX_PAGES) < 0) return NULL;
+    new_task->page_cursor = 0;
+    new_task->swap_ready_ms = 0;
+    wire_rx_reset(&new_task->rx);
+    new_task->tx.len = 0;
+    // The page table is kept with the PCB in the pool; release_process_memory() emptied it already
+    clear_page_table(&new_task->page_table);
     return new_task;
 }
 
-int enqueue_pcb(queue_t* q, pcb_t* task) {
-    queue_elem_t* elem = malloc(sizeof(queue_elem_t));
-    if (!elem) return 0;
+void free_pcb(pcb_t *task) {
+    if (!task) return;
+    if (task->queue) remove_pcb(task->queue, task);
+    task->status = TASK_TERMINATED;
+    task->next = pcb_pool;
+    pcb_pool = task;
+}
 
-    elem->pcb = task;
-    elem->next = NULL;
+int enqueue_pcb(queue_t* q, pcb_t* task) {
+    if (!q || !task) return 0;
+    if (task->queue) {
+        printf("PCB %d is already in a queue\n", task->pid);
+        return 0;
+    }
 
+    task->queue = q;
+    task->next = NULL;
+    task->prev = q->tail;
     if (q->tail) {
-        q->tail->next = elem;
+        q->tail->next = task;
     } else {
-        q->head = elem;
+        q->head = task;
     }
-    q->tail = elem;
+    q->tail = task;
     return 1;
 }
 
 pcb_t* dequeue_pcb(queue_t* q) {
     if (!q || !q->head) return NULL;
 
-    queue_elem_t* node = q->head;
-    pcb_t* task = node->pcb;
-
-    q->head = node->next;
-    if (!q->head)
-        q->tail = NULL;
-
-    free(node);
+    pcb_t* task = q->head;
+    remove_pcb(q, task);
     return task;
 }
 
-queue_elem_t *remove_queue_elem(queue_t* q, queue_elem_t* elem) {
-    queue_elem_t* it = q->head;
-    queue_elem_t* prev = NULL;
-    while (it != NULL) {
-        if (it == elem) {
-            // Remove elem from queue
-            if (prev) {
-                prev->next = it->next;
-            } else {
-                q->head = it->next;
-            }
-            if (it == q->tail) {
-                q->tail = prev;
-            }
-            return it;
-        }
-        prev = it;
-        it = it->next;
+int remove_pcb(queue_t *q, pcb_t *task) {
+    if (!q || !task || task->queue != q) {
+        printf("PCB not found in queue\n");
+        return 0;
+    }
+    if (task->prev) {
+        task->prev->next = task->next;
+    } else {
+        q->head = task->next;
+    }
+    if (task->next) {
+        task->next->prev = task->prev;
+    } else {
+        q->tail = task->prev;
+    }
+    task->prev = NULL;
+    task->next = NULL;
+    task->queue = NULL;
+    return 1;
+}
+
+pcb_t *find_pcb(const queue_t *q, int32_t pid) {
+    for (pcb_t *task = q->head; task; task = task->next) {
+        if (task->pid == pid) return task;
     }
-    printf("Queue element not found in queue\n");
     return NULL;
 }
 
+static int has_script_work(pcb_t *task) {
+    return task->script_block_ms > 0 || task->script.count > 0;
+}
+
+int enqueue_command(queue_t *cq, pcb_t *task) {
+    task->status = TASK_COMMAND;
+    // A pipelined client already sent what comes next; its socket stays disarmed until the script runs out.
+    // The same goes for a message that is buffered already: the socket may have nothing left to report
+    if (has_script_work(task) || wire_rx_ready(&task->rx)) return enqueue_pcb(&deferred_queue, task);
+    if (!enqueue_pcb(cq, task)) return 0;
+    arm_command_socket(task);
+    return 1;
+}
+
+/**
+ * Arm the one-shot socket of a client: for its next instruction (input) and, while
+ * some of what was sent to it is still buffered, for room to write the rest
+ */
+static void arm_socket(pcb_t *task, int input) {
+    struct epoll_event ev = {.events = EPOLLONESHOT, .data.ptr = task};
+    if (input) ev.events |= EPOLLIN;
+    if (task->tx.len > 0) ev.events |= EPOLLOUT;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, (int) task->sockfd, &ev) < 0) {
+        perror("epoll_ctl: re-arm client");
+    }
+}
+
+void arm_command_socket(pcb_t *task) {
+    arm_socket(task, 1);
+}
+
+/**
+ * Send a message to the application of a PCB without waiting: what its socket has
+ * no room for stays in the PCB and goes out when epoll reports the socket writable
+ * (see handle_command()), so a client that stops reading never stalls the simulation
+ */
+void send_to_app(pcb_t *task, const msg_t *msg) {
+    if (wire_put_msg(&task->tx, msg) < 0) return;
+    // A PCB waiting for its next instruction also keeps waiting for input
+    if (wire_flush((int) task->sockfd, &task->tx) > 0) arm_socket(task, task->status == TASK_COMMAND);
+}
+
 /**
  * @brief Set up the server socket for the scheduler.
  *
  * This function creates a UNIX domain socket, binds it to a specified path,
  * and sets it to listen for incoming connections. It also sets the socket to
- * non-blocking mode.
+ * non-blocking mode and registers it with the epoll instance used by
+ * check_new_commands().
  *
  * @param socket_path The path where the socket will be created
  * @return int Returns the server file descriptor on success, or -1 on failure
@@ -133,51 +254,35 @@ int setup_server_socket(const char *socket_path) {
             perror("fcntl: set non-blocking");
         }
     }
-    return server_fd;
-}
 
-/**
- * When using read you can get partial reads, so we need to loop until we have read the full message
- * @param sockfd   Socket file descriptor
- * @param msg      Pointer to the message structure to fill
- * @param msg_len  Length of the message structure
- * @return Number of bytes read, 0 if no data available, -1 on error or connection closed
- */
-ssize_t receive_msg(int sockfd, void *msg, ssize_t msg_len) {
-    ssize_t want = msg_len;
-    ssize_t off = 0;
-
-    while (off < want) {
-        ssize_t n = read(sockfd, ((char*)msg) + off, want - off);
-        if (n > 0) {
-            off += n;
-            if (off == want) return off;
-        }
-        if (n == 0)  return -1; // peer closed
-        if (n < 0) {
-            if (errno == EINTR) continue;
-            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
-            perror("read");
-            return -1;
-        }
+    // All socket readiness goes through one epoll instance; the listening socket is
+    // level-triggered with a NULL pcb, so pending connections are reported every check
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        perror("epoll_create1");
+        close(server_fd);
+        return -1;
     }
-    return off;
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &ev) < 0) {
+        perror("epoll_ctl: add server");
+        close(epoll_fd);
+        close(server_fd);
+        return -1;
+    }
+    return server_fd;
 }
 
 /**
- * @brief Check for new client connections and add them to the queue.
+ * @brief Accept all pending client connections and add them to the command queue.
  *
- * This function accepts new client connections on the server socket,
- * sets the client sockets to non-blocking mode, and enqueues them
- * into the provided queue.
+ * New client sockets are set to non-blocking mode and registered with the
+ * epoll instance, armed for their first instruction.
  *
  * @param command_queue The queue to which new pcb will be added
  * @param server_fd The server socket file descriptor
  */
-void check_new_commands(queue_t *command_queue, queue_t *blocked_queue, queue_t *ready_queue,
-                        int server_fd, uint32_t current_time_ms)
-{
-    // Accept new client connections
+static void accept_new_clients(queue_t *command_queue, int server_fd) {
     int client_fd;
     do {
         client_fd = accept(server_fd, NULL, NULL);
@@ -210,136 +315,369 @@ void check_new_commands(queue_t *command_queue, queue_t *blocked_queue, queue_t
 
         // New PCBs do not have a time yet; set when we receive RUN
         pcb_t *pcb = new_pcb(++PID, client_fd, 0);
+        if (!pcb) {
+            printf("Cannot allocate memory for new client\n");
+            close(client_fd);
+            continue;
+        }
+        struct epoll_event ev = {.events = EPOLLIN | EPOLLONESHOT, .data.ptr = pcb};
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+            perror("epoll_ctl: add client");
+        }
         enqueue_pcb(command_queue, pcb);
+        connected_clients++;
     } while (client_fd > 0);
+}
 
-    // Walk the command queue looking for messages
-    queue_elem_t *elem = command_queue->head;
-    while (elem != NULL) {
-        pcb_t *current_pcb = elem->pcb;
-        msg_t msg;
+/**
+ * Put a PCB in the READY queue for a burst
+ * @param pcb the PCB (in no queue)
+ */
+static void start_run(pcb_t *pcb, uint32_t time_ms, int32_t nice, const page_info_t *pages, queue_t *ready_queue,
+                      uint32_t current_time_ms) {
+    pcb->time_ms = time_ms;
+    pcb->ellapsed_time_ms = 0;
+    pcb->status = TASK_RUNNING;
+    pcb->nice = nice;
+    page_info_copy(&pcb->requested_pages, pages);
+    pcb->ready_time_ms = current_time_ms;
+    pcb->first_run_pending = 1;
+    enqueue_pcb(ready_queue, pcb);
+}
 
-        ssize_t n = receive_msg(current_pcb->sockfd, &msg, sizeof(msg_t));
-        if (n == 0) {
-            // No data available right now on this non-blocking socket; check next
-            elem = elem->next;
-            continue;
-        }
+/**
+ * Put a PCB in the blocked queue, keyed on its wake-up time
+ * @param pcb the PCB (in no queue)
+ */
+static void start_block(pcb_t *pcb, uint32_t time_ms, timer_wheel_t *blocked_queue, uint32_t current_time_ms) {
+    pcb->time_ms = time_ms;
+    pcb->status = TASK_BLOCKED;
+    pcb->last_update_time_ms = current_time_ms;
+    timer_wheel_add(blocked_queue, pcb, current_time_ms + time_ms);
+}
 
-        if (n < 0) {
-            // Peer closed or fatal read error
-            DBG("Connection closed by client (fd=%d)\n", current_pcb->sockfd);
-            close(current_pcb->sockfd);
+/**
+ * Append a burst to the script of a PCB, growing the ring buffer if it is full
+ * @return 0 on success, -1 on failure
+ */
+static int script_push(burst_script_t *script, const msg_t *run) {
+    if (script->count == script->capacity) {
+        uint32_t capacity = script->capacity ? script->capacity * 2 : MAX_SCRIPT_BURSTS;
+        script_burst_t *bursts = calloc(capacity, sizeof(script_burst_t));
+        if (!bursts) {
+            printf("Cannot allocate memory for a burst script\n");
+            return -1;
+        }
+        // Every slot owns the buffer of its page list, so all of them move (the ring is full)
+        for (uint32_t i = 0; i < script->capacity; i++) {
+            bursts[i] = script->bursts[(script->head + i) % script->capacity];
+        }
+        free(script->bursts);
+        script->bursts = bursts;
+        script->head = 0;
+        script->capacity = capacity;
+    }
+    script_burst_t *burst = &script->bursts[(script->head + script->count) % script->capacity];
+    burst->run_ms = run->time_ms;
+    burst->block_ms = run->block_ms;
+    burst->nice = run->nice;
+    if (page_info_copy(&burst->pages, &run->pages) < 0) return -1;
+    script->count++;
+    return 0;
+}
 
-            // Save next before unlinking/freeing this node
-            queue_elem_t *next = elem->next;
+/**
+ * Start the next phase of a scripted PCB: the block of the burst that finished, or else the next burst
+ * @param pcb the PCB (in no queue), with script work left
+ */
+static void start_script_phase(pcb_t *pcb, timer_wheel_t *blocked_queue, queue_t *ready_queue,
+                               uint32_t current_time_ms) {
+    if (pcb->script_block_ms > 0) {
+        uint32_t block_ms = pcb->script_block_ms;
+        pcb->script_block_ms = 0;
+        start_block(pcb, block_ms, blocked_queue, current_time_ms);
+        DBG("Process %d script BLOCK for %d ms\n", pcb->pid, block_ms);
+        return;
+    }
+    burst_script_t *script = &pcb->script;
+    script_burst_t *burst = &script->bursts[script->head];
+    script->head = (script->head + 1) % script->capacity;
+    script->count--;
+    pcb->script_block_ms = burst->block_ms;
+    start_run(pcb, burst->run_ms, burst->nice, &burst->pages, ready_queue, current_time_ms);
+    DBG("Process %d script RUN for %d ms\n", pcb->pid, pcb->time_ms);
+}
 
-            // Unlink this node from the command queue, then free it and the PCB
-            remove_queue_elem(command_queue, elem);
-            free(current_pcb);
-            free(elem);
+static void send_ack(pcb_t *pcb, uint32_t current_time_ms) {
+    msg_t ack_msg = {
+        .pid = pcb->pid,
+        .request = PROCESS_REQUEST_ACK,
+        .time_ms = current_time_ms
+    };
+    send_to_app(pcb, &ack_msg);
+    DBG("Send ACK message to process %d with time %d\n", pcb->pid, current_time_ms);
+}
 
-            // Continue from saved next
-            elem = next;
-            continue;
+/**
+ * @brief Handle one instruction of a client whose PCB is in the command queue.
+ *
+ * RUN, BLOCK and a complete SCRIPT move the PCB out of the command queue and are
+ * acknowledged; a SCRIPT is complete when all the RUN messages it announced arrived.
+ * SHARE and FORK are acknowledged and leave the PCB in the command queue.
+ */
+static void handle_msg(pcb_t *pcb, const msg_t *msg, queue_t *command_queue, timer_wheel_t *blocked_queue,
+                       queue_t *ready_queue, frame_table_t *frame_table, swap_hash_t *swap,
+                       uint32_t current_time_ms) {
+    if (pcb->script_expect > 0) {
+        // One of the bursts of a SCRIPT
+        if (msg->request != PROCESS_REQUEST_RUN || script_push(&pcb->script, msg) < 0) {
+            printf("Invalid burst script received from client\n");
+            pcb->script_expect = 0;
+            pcb->script.count = 0;
+            return;
         }
+        if (--pcb->script_expect > 0) return;
 
-        // We have received a full message
-        if (msg.request == PROCESS_REQUEST_RUN) {
-            current_pcb->pid = msg.pid; // Set the pid from the message
-            current_pcb->time_ms = msg.time_ms;
-            current_pcb->ellapsed_time_ms = 0;
-            current_pcb->status = TASK_RUNNING;
-            current_pcb->requested_pages = msg.pages;
-
-            // Move PCB to READY (do not free PCB)
-            enqueue_pcb(ready_queue, current_pcb);
-            DBG("Process %d requested RUN for %d ms\n", current_pcb->pid, current_pcb->time_ms);
+        // Pipelined protocol: the bursts run back to back, with a DONE after each phase
+        remove_pcb(command_queue, pcb);
+        start_script_phase(pcb, blocked_queue, ready_queue, current_time_ms);
+        send_ack(pcb, current_time_ms);
+        return;
+    }
 
-        } else if (msg.request == PROCESS_REQUEST_BLOCK) {
-            current_pcb->pid = msg.pid;
-            current_pcb->time_ms = msg.time_ms;
-            current_pcb->status = TASK_BLOCKED;
+    if (msg->request == PROCESS_REQUEST_RUN) {
+        pcb->pid = msg->pid; // Set the pid from the message
+
+        // Move PCB from COMMAND to READY (do not free PCB)
+        remove_pcb(command_queue, pcb);
+        start_run(pcb, msg->time_ms, msg->nice, &msg->pages, ready_queue, current_time_ms);
+        DBG("Process %d requested RUN for %d ms\n", pcb->pid, pcb->time_ms);
+
+    } else if (msg->request == PROCESS_REQUEST_BLOCK) {
+        pcb->pid = msg->pid;
+
+        // Move PCB from COMMAND to BLOCKED (do not free PCB), keyed on its wake-up time
+        remove_pcb(command_queue, pcb);
+        start_block(pcb, msg->time_ms, blocked_queue, current_time_ms);
+        DBG("Process %d requested BLOCK for %d ms\n", pcb->pid, pcb->time_ms);
+
+    } else if (msg->request == PROCESS_REQUEST_SCRIPT && msg->time_ms > 0 && msg->time_ms <= MAX_SCRIPT_BURSTS) {
+        // The bursts follow as RUN messages; the PCB waits for them in the command queue
+        pcb->pid = msg->pid;
+        pcb->script_expect = msg->time_ms;
+        DBG("Process %d sent a script of %u bursts\n", pcb->pid, msg->time_ms);
+        return;
+
+    } else if (msg->request == PROCESS_REQUEST_SHARE) {
+        // The PCB stays in the command queue for its first burst. If the region cannot be
+        // mapped (the error is printed), its pages are simply private to the process.
+        pcb->pid = msg->pid;
+        vm_shared_attach(pcb, msg->share_key, msg->share_vfn, msg->share_pages);
+
+    } else if (msg->request == PROCESS_REQUEST_FORK) {
+        // A new client that the application forked: it takes the address space of its parent,
+        // copy-on-write. The parent waits in the command queue until the child is acknowledged.
+        pcb->pid = msg->pid;
+        pcb_t *parent = find_pcb(command_queue, (int32_t) msg->parent_pid);
+        if (parent == NULL || parent == pcb || pcb->page_table.root != NULL) {
+            printf("Process %d cannot fork from process %d\n", pcb->pid, (int) msg->parent_pid);
+        } else if (fork_process_memory(frame_table, swap, parent, pcb) < 0) {
+            printf("Failed to fork process %d into %d\n", parent->pid, pcb->pid);
+        }
 
-            // Move PCB to BLOCKED (do not free PCB)
-            enqueue_pcb(blocked_queue, current_pcb);
-            DBG("Process %d requested BLOCK for %d ms\n", current_pcb->pid, current_pcb->time_ms);
+    } else {
+        // Unexpected message → keep waiting for a valid instruction
+        printf("Unexpected message received from client\n");
+        return;
+    }
 
-        } else {
-            // Unexpected message → skip this entry safely
-            printf("Unexpected message received from client\n");
-            elem = elem->next;
-            continue;
-        }
+    // Send ACK back to the client
+    send_ack(pcb, current_time_ms);
+}
 
-        // Remove the queue node from COMMAND after moving the PCB elsewhere
-        queue_elem_t *next = elem->next;         // save next first
-        remove_queue_elem(command_queue, elem);  // unlink this node
-        free(elem);                              // free only the node, NOT the PCB
-        elem = next;
+/**
+ * @brief Read and handle the instructions of a client in the command queue.
+ *
+ * Whatever the socket has is read at once; every complete message is handled while
+ * the PCB stays in the command queue. A partial message is kept in the PCB's receive
+ * buffer until the rest arrives, and messages after the one that took the PCB out of
+ * the command queue wait there until it comes back (see enqueue_command()).
+ *
+ * @param pcb The PCB whose socket was reported readable
+ */
+static void handle_command(pcb_t *pcb, queue_t *command_queue, timer_wheel_t *blocked_queue, queue_t *ready_queue,
+                           queue_t *terminated_queue, frame_table_t *frame_table, swap_hash_t *swap,
+                           uint32_t current_time_ms) {
+    static msg_t msg;   // Reused, so the buffer of its page list is kept
+    int n = 0;
+
+    // The socket may be reported writable: send what was left over (a peer that is gone
+    // shows up on the read side)
+    if (pcb->tx.len > 0) wire_flush((int) pcb->sockfd, &pcb->tx);
+
+    while (pcb->queue == command_queue && (n = wire_recv_msg((int) pcb->sockfd, &pcb->rx, &msg)) > 0) {
+        handle_msg(pcb, &msg, command_queue, blocked_queue, ready_queue, frame_table, swap, current_time_ms);
+    }
 
-        // Send ACK back to the client
-        msg_t ack_msg = {
-            .pid = current_pcb->pid,
-            .request = PROCESS_REQUEST_ACK,
-            .time_ms = current_time_ms
-        };
-        if (write(current_pcb->sockfd, &ack_msg, sizeof(msg_t)) != sizeof(msg_t)) {
-            perror("write");
-        }
-        DBG("Send ACK message to process %d with time %d\n", current_pcb->pid, current_time_ms);
+    if (n < 0) {
+        // Peer closed, fatal read error or garbage; closing also removes the fd from epoll
+        DBG("Connection closed by client (fd=%d)\n", pcb->sockfd);
+        close(pcb->sockfd);
+        connected_clients--;
+
+        // Unlink the PCB from the command queue; main releases its memory and frees it
+        remove_pcb(command_queue, pcb);
+        pcb->status = TASK_TERMINATED;
+        enqueue_pcb(terminated_queue, pcb);
+        return;
+    }
+    // Still waiting for (the rest of) an instruction: wait for the next readiness event
+    if (pcb->queue == command_queue) {
+        arm_command_socket(pcb);
+    } else if (pcb->tx.len > 0) {
+        arm_socket(pcb, 0);
     }
 }
 
 /**
- * @brief Check the blocked queue for messages from clients.
+ * @brief Check for new client connections and new instructions.
  *
- * This function iterates through the blocked queue, checking each client
- * socket for incoming messages. If a RUN message is received, the corresponding
- * pcb is moved to the command queue and an ACK message is sent back to the client.
- * If a client disconnects or an error occurs, the client is removed from the blocked queue.
+ * Only sockets reported readable by epoll are touched: the listening socket
+ * (new connections) and the sockets of PCBs in the command queue. Client
+ * sockets are registered one-shot and only re-armed when their PCB returns to
+ * the command queue, so clients that are running or blocked cost nothing here.
+ * PCBs of pipelined clients (SCRIPT) that finished a phase start the next one
+ * of their script first, without a message, and PCBs that have their next
+ * message buffered already handle it.
  *
- * @param blocked_queue The queue containing PCBs in I/O wait stated (blocked) from CPU
- * @param command_queue The queue where PCBs ready for new instructions will be moved
+ * @param command_queue The queue to which new pcb will be added
+ * @param blocked_queue The timing wheel for PCBs that requested BLOCK
+ * @param ready_queue The queue for PCBs that requested RUN
+ * @param terminated_queue The queue for PCBs whose client disconnected
+ * @param frame_table The frame table (a FORK shares the frames of the parent)
+ * @param swap The swap
+ * @param server_fd The server socket file descriptor
  * @param current_time_ms The current time in milliseconds
  */
-void check_blocked_queue(queue_t * blocked_queue, queue_t * command_queue, uint32_t current_time_ms) {
-    // Check all elements of the blocked queue for new messages
-    queue_elem_t * elem = blocked_queue->head;
-    while (elem != NULL) {
-        pcb_t *pcb = elem->pcb;
-
-        // Make sure the time is updated only once per cycle
-        if (pcb->last_update_time_ms < current_time_ms) {
-            if (pcb->time_ms > TICKS_MS) {
-                pcb->time_ms -= TICKS_MS;
+void check_new_commands(queue_t *command_queue, timer_wheel_t *blocked_queue, queue_t *ready_queue,
+                        queue_t *terminated_queue, frame_table_t *frame_table, swap_hash_t *swap, int server_fd,
+                        uint32_t current_time_ms)
+{
+    // Scripted PCBs that finished a phase and PCBs with a buffered message go on right away
+    pcb_t *pcb;
+    while ((pcb = dequeue_pcb(&deferred_queue)) != NULL) {
+        if (has_script_work(pcb)) {
+            start_script_phase(pcb, blocked_queue, ready_queue, current_time_ms);
+        } else {
+            enqueue_pcb(command_queue, pcb);
+            handle_command(pcb, command_queue, blocked_queue, ready_queue, terminated_queue, frame_table, swap,
+                               current_time_ms);
+        }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    int n;
+    do {
+        n = epoll_wait(epoll_fd, events, MAX_EVENTS, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            pcb = events[i].data.ptr;
+            if (pcb == NULL) {
+                accept_new_clients(command_queue, server_fd);
             } else {
-                pcb->time_ms = 0;
+                handle_command(pcb, command_queue, blocked_queue, ready_queue, terminated_queue, frame_table, swap,
+                               current_time_ms);
             }
         }
+    } while (n == MAX_EVENTS);
+}
 
-        if (pcb->time_ms == 0) {
-            // Send DONE message to the application
-            msg_t msg = {
-                .pid = pcb->pid,
-                .request = PROCESS_REQUEST_DONE,
-                .time_ms = current_time_ms
-            };
-            if (write(pcb->sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
-                perror("write");
-            }
-            DBG("Process %d finished BLOCK, sending DONE\n", pcb->pid);
-            pcb->status = TASK_COMMAND;
+/**
+ * @brief Wake up the PCBs whose BLOCK has ended.
+ *
+ * The blocked queue is a timing wheel keyed on the absolute wake-up time, so only
+ * the PCBs that expire now are touched. For each of them a DONE message is sent
+ * to the application and the pcb is moved to the command queue. PCBs that waited
+ * for a page from swap are in the middle of a burst instead: they go back to the
+ * READY queue without telling the application.
+ *
+ * @param blocked_queue The timing wheel containing PCBs in I/O wait stated (blocked) from CPU
+ * @param command_queue The queue where PCBs ready for new instructions will be moved
+ * @param ready_queue The queue where PCBs that got their page from swap will be moved
+ * @param current_time_ms The current time in milliseconds
+ */
+void check_blocked_queue(timer_wheel_t *blocked_queue, queue_t *command_queue, queue_t *ready_queue,
+                         uint32_t current_time_ms) {
+    pcb_t *pcb;
+    while ((pcb = timer_wheel_expire(blocked_queue, current_time_ms)) != NULL) {
+        if (pcb->status == TASK_SWAP_WAIT) {
+            DBG("Process %d got its page from swap, ready again\n", pcb->pid);
+            pcb->status = TASK_RUNNING;
             pcb->last_update_time_ms = current_time_ms;
-            enqueue_pcb(command_queue, pcb);
-
-            // Remove from blocked queue
-            remove_queue_elem(blocked_queue, elem);
-            queue_elem_t *tmp = elem;
-            elem = elem->next;  // Do this here, because we free it in the next line
-            free(tmp);
-        } else {
-            elem = elem->next;  // If not done already, do it now
+            enqueue_pcb(ready_queue, pcb);
+            continue;
         }
+        pcb->time_ms = 0;
+        // Send DONE message to the application
+        msg_t msg = {
+            .pid = pcb->pid,
+            .request = PROCESS_REQUEST_DONE,
+            .time_ms = current_time_ms
+        };
+        send_to_app(pcb, &msg);
+        DBG("Process %d finished BLOCK, sending DONE\n", pcb->pid);
+        pcb->last_update_time_ms = current_time_ms;
+        enqueue_command(command_queue, pcb);
     }
 }
+
+/**
+ * @brief Time until the first task in the blocked queue finishes its I/O.
+ *
+ * @param blocked_queue The timing wheel containing PCBs in I/O wait
+ * @param current_time_ms The current time in milliseconds
+ * @return Milliseconds until the next wake-up (may be a lower bound), or UINT32_MAX if nobody is blocked
+ */
+uint32_t blocked_queue_next_event_ms(timer_wheel_t *blocked_queue, uint32_t current_time_ms) {
+    uint32_t next = timer_wheel_next_expiry_ms(blocked_queue);
+    if (next == UINT32_MAX) return UINT32_MAX;
+    return (next > current_time_ms) ? next - current_time_ms : 0;
+}
+
+/**
+ * @brief Whether PCBs are waiting to go on at the next check without a new message.
+ *
+ * @return 1 if check_new_commands() has script phases to start or buffered messages to handle, 0 otherwise
+ */
+int deferred_commands_pending(void) {
+    return deferred_queue.head != NULL;
+}
+
+/**
+ * @brief Wait until a client in the command queue sent something, or a new client connects.
+ *
+ * Used by the virtual clock: time cannot advance while a client still owes us
+ * its next instruction, otherwise the simulation would depend on the host speed.
+ *
+ * @param timeout_ms Maximum time to wait (-1 waits forever)
+ * @return 1 if there is something to read, 0 on timeout, -1 on error or signal
+ */
+int wait_for_commands(int timeout_ms) {
+    // The epoll fd itself becomes readable when any registered socket is ready,
+    // so polling it waits without consuming the events check_new_commands() needs
+    struct pollfd pfd = {.fd = epoll_fd, .events = POLLIN};
+    int n = poll(&pfd, 1, timeout_ms);
+    if (n < 0 && errno != EINTR) perror("poll");
+    return n;
+}
+
+/**
+ * @return Number of clients currently connected to the simulator
+ */
+int get_connected_clients(void) {
+    return connected_clients;
+}
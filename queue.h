@@ -8,25 +8,23 @@
 #include "pcb.h"
 #include "virtmem_types.h"
 
-// Define singly linked list elements
-typedef struct queue_elem_st queue_elem_t;
-
-typedef struct queue_elem_st {
-    pcb_t *pcb;
-    struct queue_elem_st *next;
-} queue_elem_t;
+typedef struct timer_wheel_st timer_wheel_t;
 
 // Define the queue structure
+// The queue is intrusive: the links live in the pcb itself (pcb->prev/next), so
+// moving a pcb between queues never allocates and removal is O(1).
+// A pcb can only be in one queue at a time (pcb->queue).
 // We define the head and the tail to make it easier to enqueue and dequeue
 typedef struct queue_st  {
-    queue_elem_t* head;
-    queue_elem_t* tail;
+    pcb_t* head;
+    pcb_t* tail;
 } queue_t;
 
 /**
  * @brief Create a new pcb (process control block)
  *
- * This function allocates memory for a new pcb and initializes its fields.
+ * This function takes a pcb from the pcb pool (growing it by a slab if it is
+ * empty) and initializes its fields.
  *
  * @param pid The process ID of the task
  * @param sockfd The socket file descriptor for communication with the application
@@ -35,10 +33,21 @@ typedef struct queue_st  {
  */
 pcb_t *new_pcb(int32_t pid, uint32_t sockfd, uint32_t time_ms);
 
+/**
+ * @brief Return a pcb to the pcb pool
+ *
+ * The pcb is removed from its queue (if any). Its memory (frames, swap) must
+ * have been released already, the page table is kept for reuse.
+ *
+ * @param task The pcb to free
+ */
+void free_pcb(pcb_t *task);
+
 /**
  * @brief Enqueue a pcb into the queue
  *
  * This function adds a pcb to the end of the queue (FIFO order).
+ * The pcb must not be in any queue.
  *
  * @param q The queue to which the pcb will be added
  * @param task The pcb to be added to the queue
@@ -57,24 +66,60 @@ int enqueue_pcb(queue_t* q, pcb_t* task);
 pcb_t* dequeue_pcb(queue_t* q);
 
 /**
- * @brief Remove a specific element from the queue
+ * @brief Remove a pcb from the queue
+ *
+ * O(1), using the links in the pcb. The pcb itself is not freed.
+ *
+ * @param q The queue from which the pcb will be removed
+ * @param task The pcb to remove
+ * @return 1 if the pcb was found and removed, 0 otherwise
+ */
+int remove_pcb(queue_t *q, pcb_t *task);
+
+/**
+ * @brief Find the pcb of a process in a queue
  *
- * This function removes a specific element from the queue.
- * Neither the element, nor the pcb inside the element, are freed.
+ * O(n), the queue is walked from its head.
  *
- * @param q The queue from which the element will be removed
- * @param elem The element to be removed from the queue
- * @return The removed element, or NULL if the element was not found
+ * @param q The queue
+ * @param pid The process ID
+ * @return The pcb, or NULL if no pcb in the queue has that pid
  */
-queue_elem_t *remove_queue_elem(queue_t* q, queue_elem_t* elem);
+pcb_t *find_pcb(const queue_t *q, int32_t pid);
+
+/**
+ * @brief Move a pcb to the command queue to wait for the next instruction
+ *
+ * Sets the status to TASK_COMMAND and re-arms the client socket in the
+ * epoll instance, so that check_new_commands() is notified when it sends.
+ * A pcb that still has bursts of a SCRIPT, or whose next message is buffered
+ * already, waits for the next check instead, with its socket disarmed.
+ *
+ * @param cq The command queue
+ * @param task The pcb that finished its RUN or BLOCK
+ * @return The number of pcb enqueued (0 on failure)
+ */
+int enqueue_command(queue_t *cq, pcb_t *task);
+
+void arm_command_socket(pcb_t *task);
+
+void send_to_app(pcb_t *task, const msg_t *msg);
+
+
+void check_blocked_queue(timer_wheel_t *blocked_queue, queue_t *command_queue, queue_t *ready_queue,
+                         uint32_t current_time_ms);
+
+void check_new_commands(queue_t *command_queue, timer_wheel_t *blocked_queue, queue_t *ready_queue,
+                        queue_t *terminated_queue, frame_table_t *frame_table, swap_hash_t *swap, int server_fd,
+                        uint32_t current_time_ms);
 
+uint32_t blocked_queue_next_event_ms(timer_wheel_t *blocked_queue, uint32_t current_time_ms);
 
-void check_blocked_queue(queue_t * blocked_queue, queue_t * command_queue, uint32_t current_time_ms);
+int deferred_commands_pending(void);
 
-void check_new_commands(queue_t *command_queue, queue_t *blocked_queue, queue_t *ready_queue,
-                        int server_fd, uint32_t current_time_ms);
+int wait_for_commands(int timeout_ms);
 
-ssize_t receive_msg(int sockfd, void *msg, ssize_t msg_len);
+int get_connected_clients(void);
 
 int setup_server_socket(const char *socket_path);
 #endif //QUEUE_H
@@ -0,0 +1,247 @@
+#include "rbtree.h"
+
+static void rotate_left(rb_root_t *tree, rb_node_t *x) {
+    rb_node_t *y = x->right;
+    x->right = y->left;
+    if (y->left) y->left->parent = x;
+    y->parent = x->parent;
+    if (!x->parent) {
+        tree->root = y;
+    } else if (x == x->parent->left) {
+        x->parent->left = y;
+    } else {
+        x->parent->right = y;
+    }
+    y->left = x;
+    x->parent = y;
+}
+
+static void rotate_right(rb_root_t *tree, rb_node_t *x) {
+    rb_node_t *y = x->left;
+    x->left = y->right;
+    if (y->right) y->right->parent = x;
+    y->parent = x->parent;
+    if (!x->parent) {
+        tree->root = y;
+    } else if (x == x->parent->right) {
+        x->parent->right = y;
+    } else {
+        x->parent->left = y;
+    }
+    y->right = x;
+    x->parent = y;
+}
+
+/**
+ * Insert a node, O(log n)
+ * @param tree the tree
+ * @param node the node to insert (not in any tree)
+ * @param less the ordering; equal nodes are inserted after the existing ones
+ */
+void rb_insert(rb_root_t *tree, rb_node_t *node, rb_less_fn less) {
+    rb_node_t *parent = NULL;
+    rb_node_t **link = &tree->root;
+    int leftmost = 1;
+    while (*link) {
+        parent = *link;
+        if (less(node, parent)) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = 0;
+        }
+    }
+    node->parent = parent;
+    node->left = node->right = NULL;
+    node->red = 1;
+    *link = node;
+    if (leftmost) tree->leftmost = node;
+
+    // Restore the red-black properties
+    rb_node_t *x = node;
+    while (x != tree->root && x->parent->red) {
+        rb_node_t *p = x->parent;
+        rb_node_t *g = p->parent;
+        if (p == g->left) {
+            rb_node_t *uncle = g->right;
+            if (uncle && uncle->red) {
+                p->red = 0;
+                uncle->red = 0;
+                g->red = 1;
+                x = g;
+            } else {
+                if (x == p->right) {
+                    x = p;
+                    rotate_left(tree, x);
+                    p = x->parent;
+                }
+                p->red = 0;
+                g->red = 1;
+                rotate_right(tree, g);
+            }
+        } else {
+            rb_node_t *uncle = g->left;
+            if (uncle && uncle->red) {
+                p->red = 0;
+                uncle->red = 0;
+                g->red = 1;
+                x = g;
+            } else {
+                if (x == p->left) {
+                    x = p;
+                    rotate_right(tree, x);
+                    p = x->parent;
+                }
+                p->red = 0;
+                g->red = 1;
+                rotate_left(tree, g);
+            }
+        }
+    }
+    tree->root->red = 0;
+}
+
+// Replace subtree u by subtree v (v may be NULL)
+static void transplant(rb_root_t *tree, rb_node_t *u, rb_node_t *v) {
+    if (!u->parent) {
+        tree->root = v;
+    } else if (u == u->parent->left) {
+        u->parent->left = v;
+    } else {
+        u->parent->right = v;
+    }
+    if (v) v->parent = u->parent;
+}
+
+static rb_node_t *subtree_min(rb_node_t *node) {
+    while (node->left) node = node->left;
+    return node;
+}
+
+/**
+ * Remove a node from the tree, O(log n)
+ * @param tree the tree
+ * @param node a node that is in the tree
+ */
+void rb_erase(rb_root_t *tree, rb_node_t *node) {
+    if (tree->leftmost == node) tree->leftmost = rb_next(node);
+
+    rb_node_t *x;               // Node that moves into the place of the removed one
+    rb_node_t *x_parent;        // Its parent (x may be NULL)
+    int removed_red = node->red;
+
+    if (!node->left) {
+        x = node->right;
+        x_parent = node->parent;
+        transplant(tree, node, node->right);
+    } else if (!node->right) {
+        x = node->left;
+        x_parent = node->parent;
+        transplant(tree, node, node->left);
+    } else {
+        rb_node_t *y = subtree_min(node->right);
+        removed_red = y->red;
+        x = y->right;
+        if (y->parent == node) {
+            x_parent = y;
+        } else {
+            x_parent = y->parent;
+            transplant(tree, y, y->right);
+            y->right = node->right;
+            y->right->parent = y;
+        }
+        transplant(tree, node, y);
+        y->left = node->left;
+        y->left->parent = y;
+        y->red = node->red;
+    }
+    node->parent = node->left = node->right = NULL;
+    if (removed_red) return;
+
+    // A black node was removed: fix the black height
+    while (x != tree->root && (!x || !x->red)) {
+        if (x == x_parent->left) {
+            rb_node_t *w = x_parent->right;
+            if (w->red) {
+                w->red = 0;
+                x_parent->red = 1;
+                rotate_left(tree, x_parent);
+                w = x_parent->right;
+            }
+            if ((!w->left || !w->left->red) && (!w->right || !w->right->red)) {
+                w->red = 1;
+                x = x_parent;
+                x_parent = x->parent;
+            } else {
+                if (!w->right || !w->right->red) {
+                    w->left->red = 0;
+                    w->red = 1;
+                    rotate_right(tree, w);
+                    w = x_parent->right;
+                }
+                w->red = x_parent->red;
+                x_parent->red = 0;
+                if (w->right) w->right->red = 0;
+                rotate_left(tree, x_parent);
+                x = tree->root;
+            }
+        } else {
+            rb_node_t *w = x_parent->left;
+            if (w->red) {
+                w->red = 0;
+                x_parent->red = 1;
+                rotate_right(tree, x_parent);
+                w = x_parent->left;
+            }
+            if ((!w->right || !w->right->red) && (!w->left || !w->left->red)) {
+                w->red = 1;
+                x = x_parent;
+                x_parent = x->parent;
+            } else {
+                if (!w->left || !w->left->red) {
+                    w->right->red = 0;
+                    w->red = 1;
+                    rotate_left(tree, w);
+                    w = x_parent->left;
+                }
+                w->red = x_parent->red;
+                x_parent->red = 0;
+                if (w->left) w->left->red = 0;
+                rotate_right(tree, x_parent);
+                x = tree->root;
+            }
+        }
+    }
+    if (x) x->red = 0;
+}
+
+/**
+ * @return the smallest node (cached, O(1)), or NULL if the tree is empty
+ */
+rb_node_t *rb_first(const rb_root_t *tree) {
+    return tree->leftmost;
+}
+
+/**
+ * @return the largest node, or NULL if the tree is empty
+ */
+rb_node_t *rb_last(const rb_root_t *tree) {
+    rb_node_t *node = tree->root;
+    if (!node) return NULL;
+    while (node->right) node = node->right;
+    return node;
+}
+
+/**
+ * @return the in-order successor of a node, or NULL if it is the last one
+ */
+rb_node_t *rb_next(const rb_node_t *node) {
+    if (node->right) return subtree_min(node->right);
+    const rb_node_t *child = node;
+    rb_node_t *parent = node->parent;
+    while (parent && child == parent->right) {
+        child = parent;
+        parent = parent->parent;
+    }
+    return parent;
+}
@@ -0,0 +1,34 @@
+#ifndef RBTREE_H
+#define RBTREE_H
+
+#include <stddef.h>
+
+/*
+ * Intrusive red-black tree. The node is embedded in the structure that is stored
+ * (e.g. a pcb), so inserting and erasing never allocate; rb_entry() gets back to
+ * the containing structure. The leftmost node is cached, so the minimum is O(1).
+ */
+typedef struct rb_node_st {
+    struct rb_node_st *parent;
+    struct rb_node_st *left;
+    struct rb_node_st *right;
+    int red;
+} rb_node_t;
+
+typedef struct rb_root_st {
+    rb_node_t *root;
+    rb_node_t *leftmost;
+} rb_root_t;
+
+// Strict ordering of two nodes: returns non-zero if a goes before b
+typedef int (*rb_less_fn)(const rb_node_t *a, const rb_node_t *b);
+
+#define rb_entry(ptr, type, member) ((type *) ((char *) (ptr) - offsetof(type, member)))
+
+void rb_insert(rb_root_t *tree, rb_node_t *node, rb_less_fn less);
+void rb_erase(rb_root_t *tree, rb_node_t *node);
+rb_node_t *rb_first(const rb_root_t *tree);
+rb_node_t *rb_last(const rb_root_t *tree);
+rb_node_t *rb_next(const rb_node_t *node);
+
+#endif //RBTREE_H
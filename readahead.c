@@ -0,0 +1,117 @@
+#include "readahead.h"
+
+#include <stdlib.h>
+
+#include "debug.h"
+#include "vm_shared.h"
+
+readahead_config_t readahead_config = {
+    .max_pages = 0,
+    .max_stride = 64,
+};
+
+readahead_stats_t readahead_stats = {0};
+
+#define READAHEAD_INITIAL 4     // First window of a pattern
+
+static uint32_t min_u32(uint32_t a, uint32_t b) {
+    return a < b ? a : b;
+}
+
+// The page k strides after vfn, 0 if that is outside of the address space
+static uint32_t page_at(uint32_t vfn, int32_t stride, uint32_t k) {
+    int64_t page = (int64_t) vfn + (int64_t) stride * k;
+    return (page < 1 || page > UINT32_MAX) ? 0 : (uint32_t) page;
+}
+
+/**
+ * A process faults on a page: follow its access pattern and size the window to prefetch
+ * @param pcb the process
+ * @param vfn the page that faulted
+ * @return the number of pages to prefetch after it (see readahead_fetch()), 0 for none
+ */
+uint32_t readahead_window(pcb_t *pcb, uint32_t vfn) {
+    if (readahead_config.max_pages == 0) return 0;
+    int64_t distance = (int64_t) vfn - (int64_t) pcb->ra_prev_fault;
+    pcb->ra_prev_fault = vfn;
+    if (pcb->ra_size && vfn == pcb->ra_next) {
+        // Right after the window: the pattern goes on, ramp up
+        pcb->ra_size = min_u32(2 * pcb->ra_size, readahead_config.max_pages);
+    } else if (distance != 0 && distance == pcb->ra_stride) {
+        pcb->ra_size = min_u32(READAHEAD_INITIAL, readahead_config.max_pages);
+    } else {
+        // Maybe the start of a pattern, the next fault tells
+        pcb->ra_stride = llabs(distance) <= readahead_config.max_stride ? (int32_t) distance : 0;
+        pcb->ra_size = 0;
+        return 0;
+    }
+    readahead_stats.windows++;
+    return pcb->ra_size;
+}
+
+/**
+ * Prefetch the pages that follow one at the stride of the process, as long as there are
+ * free frames to spare (prefetch_page() never evicts). The page halfway is marked, an
+ * access to it prefetches the next window.
+ * @param current_time_ms the current simulation time
+ * @param pcb the process
+ * @param frame_table the frame table
+ * @param swap the swap
+ * @param vfn the page before the window
+ * @param pages the size of the window
+ */
+void readahead_fetch(uint32_t current_time_ms, pcb_t *pcb, frame_table_t *frame_table, swap_hash_t *swap,
+                     uint32_t vfn, uint32_t pages) {
+    uint32_t marker = pages - pages / 2;
+    uint32_t k;
+    for (k = 1; k <= pages; k++) {
+        uint32_t page = page_at(vfn, pcb->ra_stride, k);
+        if (page == 0) break;
+        if (is_active(find_page(&pcb->page_table, page))) continue;
+        if (pcb->shared_maps && vm_shared_find(pcb, page)) continue;     // Not a private page
+        pte_t *vp = prefetch_page(current_time_ms, pcb, frame_table, swap, page);
+        if (!vp) break;
+        readahead_stats.prefetched++;
+        if (k == marker) vp->ra_marker = 1;
+    }
+    // A fault on the page after the last one tried continues the pattern
+    pcb->ra_next = page_at(vfn, pcb->ra_stride, k);
+    DBG("Readahead: process %d, %u pages after %u at stride %d", pcb->pid, k - 1, vfn, pcb->ra_stride);
+}
+
+/**
+ * A page that was prefetched (or marked) is accessed
+ * @param current_time_ms the current simulation time
+ * @param pcb the process the page belongs to
+ * @param frame_table the frame table
+ * @param swap the swap
+ * @param vp the page
+ */
+void readahead_hit(uint32_t current_time_ms, pcb_t *pcb, frame_table_t *frame_table, swap_hash_t *swap, pte_t *vp) {
+    if (vp->prefetched) {
+        vp->prefetched = 0;
+        readahead_stats.hits++;
+    }
+    if (!vp->ra_marker) return;
+    vp->ra_marker = 0;
+    if (pcb == NULL || pcb->ra_size == 0 || pcb->ra_next == 0) return;
+    // Asynchronous readahead: the next window, before the process gets there
+    pcb->ra_size = min_u32(2 * pcb->ra_size, readahead_config.max_pages);
+    readahead_stats.async_windows++;
+    uint32_t last = page_at(pcb->ra_next, -pcb->ra_stride, 1);
+    if (last) readahead_fetch(current_time_ms, pcb, frame_table, swap, last, pcb->ra_size);
+}
+
+/**
+ * A page leaves memory: if it was prefetched and never accessed, the readahead was wasted
+ * and the window of the process shrinks
+ * @param pcb the process the page belongs to, NULL if it is terminating
+ * @param vp the page
+ */
+void readahead_wasted(pcb_t *pcb, pte_t *vp) {
+    vp->ra_marker = 0;
+    if (!vp->prefetched) return;
+    vp->prefetched = 0;
+    readahead_stats.misses++;
+    if (pcb) pcb->ra_size /= 2;
+}
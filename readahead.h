@@ -0,0 +1,48 @@
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+/*
+ * Readahead and fault-around (--readahead <pages>), after the readahead state of Linux.
+ *
+ * Every process remembers its last faults. Two faults at the same distance (the stride,
+ * 1 for a sequential scan) start a window: the next pages at that stride are brought in
+ * with the page that faulted, read from swap or, for pages never used, allocated. A fault
+ * on the page right after the window means the pattern goes on, and the window doubles,
+ * up to readahead_config.max_pages. Halfway through a window one page is marked: an access
+ * to it prefetches the next window already (asynchronous readahead), but only into free
+ * frames, nothing is evicted for it.
+ *
+ * A prefetched page that is accessed is a prefetch hit. One that is evicted (or freed)
+ * before it was ever accessed is a miss, and the window of its process is halved.
+ * Prefetched pages come in unreferenced, so the policies evict them first if they stay
+ * unused. Their swap reads are queued on the swap device, but nobody waits for them.
+ */
+
+#include <stdint.h>
+
+#include "virtmem.h"
+
+typedef struct readahead_config_st {
+    uint32_t max_pages;         // Largest window, 0: no readahead
+    uint32_t max_stride;        // Larger distances between faults are not a pattern
+} readahead_config_t;
+
+extern readahead_config_t readahead_config;
+
+typedef struct readahead_stats_st {
+    uint64_t windows;           // Windows started or grown by a fault
+    uint64_t async_windows;     // Windows started by an access to a marked page
+    uint64_t prefetched;        // Pages brought in ahead of their access
+    uint64_t hits;              // Prefetched pages that were accessed
+    uint64_t misses;            // Prefetched pages that left memory unused
+} readahead_stats_t;
+
+extern readahead_stats_t readahead_stats;
+
+uint32_t readahead_window(pcb_t *pcb, uint32_t vfn);
+void readahead_fetch(uint32_t current_time_ms, pcb_t *pcb, frame_table_t *frame_table, swap_hash_t *swap,
+                     uint32_t vfn, uint32_t pages);
+void readahead_hit(uint32_t current_time_ms, pcb_t *pcb, frame_table_t *frame_table, swap_hash_t *swap, pte_t *vp);
+void readahead_wasted(pcb_t *pcb, pte_t *vp);
+
+#endif //READAHEAD_H
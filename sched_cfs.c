@@ -0,0 +1,179 @@
+/*
+ * Completely Fair Scheduler (--scheduler cfs), modelled after the Linux one.
+ *
+ * Every task has a virtual runtime: the time it ran, scaled by NICE_0_WEIGHT / weight,
+ * where the weight comes from the nice value (each nice level is ~10% of CPU time).
+ * The ready queue of a CPU is a red-black tree ordered by vruntime and the task with
+ * the smallest vruntime runs next (cached leftmost node, O(1) pick, O(log n) insert).
+ *
+ * The running task gets a share of the target latency proportional to its weight,
+ * but never less than the minimum granularity; when more tasks are waiting than fit
+ * in the latency, the period is stretched instead. A task that wakes up (RUN after a
+ * BLOCK) is placed at most half a latency behind min_vruntime, so sleeping does not
+ * build up credit, and preempts the running task if it is far enough behind it.
+ */
+
+#include <stdlib.h>
+
+#include "scheduler.h"
+#include "rbtree.h"
+
+#define NICE_0_WEIGHT 1024
+
+uint32_t cfs_target_latency_ms = 60;
+uint32_t cfs_min_granularity_ms = 10;
+
+// Weight of the nice levels -20..19 (same table as Linux' sched_prio_to_weight)
+static const uint32_t nice_to_weight[40] = {
+    /* -20 */ 88761, 71755, 56483, 46273, 36291,
+    /* -15 */ 29154, 23254, 18705, 14949, 11916,
+    /* -10 */  9548,  7620,  6100,  4904,  3906,
+    /*  -5 */  3121,  2501,  1991,  1586,  1277,
+    /*   0 */  1024,   820,   655,   526,   423,
+    /*   5 */   335,   272,   215,   172,   137,
+    /*  10 */   110,    87,    70,    56,    45,
+    /*  15 */    36,    29,    23,    18,    15,
+};
+
+typedef struct cfs_rq_st {
+    rb_root_t tasks;            // Waiting tasks ordered by vruntime
+    uint64_t min_vruntime;      // Monotonic lower bound of the vruntime of the tasks on this CPU
+    uint64_t load;              // Sum of the weights of the waiting tasks
+} cfs_rq_t;
+
+static uint32_t task_weight(pcb_t *task) {
+    int nice = task->nice;
+    if (nice < -20) nice = -20;
+    if (nice > 19) nice = 19;
+    return nice_to_weight[nice + 20];
+}
+
+// Wall-clock milliseconds to vruntime (us) for a given weight
+static uint64_t ms_to_vruntime(uint32_t ms, uint32_t weight) {
+    return (uint64_t) ms * 1000 * NICE_0_WEIGHT / weight;
+}
+
+static int vruntime_less(const rb_node_t *a, const rb_node_t *b) {
+    return rb_entry(a, pcb_t, run_node)->vruntime < rb_entry(b, pcb_t, run_node)->vruntime;
+}
+
+static pcb_t *leftmost_task(cfs_rq_t *rq) {
+    rb_node_t *node = rb_first(&rq->tasks);
+    return node ? rb_entry(node, pcb_t, run_node) : NULL;
+}
+
+static void remove_task(cfs_rq_t *rq, pcb_t *task) {
+    rb_erase(&rq->tasks, &task->run_node);
+    rq->load -= task_weight(task);
+}
+
+/**
+ * Move min_vruntime forward to the smallest vruntime on the CPU, never backwards
+ * @param rq the ready queue
+ * @param curr the running task, or NULL
+ */
+static void update_min_vruntime(cfs_rq_t *rq, pcb_t *curr) {
+    uint64_t vruntime = UINT64_MAX;
+    if (curr) vruntime = curr->vruntime;
+    pcb_t *first = leftmost_task(rq);
+    if (first && first->vruntime < vruntime) vruntime = first->vruntime;
+    if (vruntime != UINT64_MAX && vruntime > rq->min_vruntime) rq->min_vruntime = vruntime;
+}
+
+/**
+ * Ideal time slice of the running task: its weighted share of the scheduling period
+ * @param cpu the CPU
+ * @param task the running task (not in the tree)
+ * @return the slice in ms, at least cfs_min_granularity_ms
+ */
+static uint32_t ideal_slice_ms(cpu_t *cpu, pcb_t *task) {
+    cfs_rq_t *rq = cpu->rq;
+    uint64_t nr_running = (uint64_t) cpu->nr_ready + 1;
+    uint64_t period = cfs_target_latency_ms;
+    if (nr_running * cfs_min_granularity_ms > period) period = nr_running * cfs_min_granularity_ms;
+
+    uint32_t weight = task_weight(task);
+    uint64_t slice = period * weight / (rq->load + weight);
+    return slice < cfs_min_granularity_ms ? cfs_min_granularity_ms : (uint32_t) slice;
+}
+
+static int cfs_init(cpu_t *cpu) {
+    cfs_rq_t *rq = calloc(1, sizeof(cfs_rq_t));
+    if (!rq) return -1;
+    cpu->rq = rq;
+    return 0;
+}
+
+static int cfs_enqueue(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms) {
+    (void) current_time_ms;
+    cfs_rq_t *rq = cpu->rq;
+    update_min_vruntime(rq, cpu->task);
+
+    // A task that was waiting for a while (or comes from another CPU) gets at most half
+    // a latency of credit; a preempted task is never behind min_vruntime, so it keeps its place
+    uint64_t credit = (uint64_t) cfs_target_latency_ms * 1000 / 2;
+    if (rq->min_vruntime > credit && task->vruntime < rq->min_vruntime - credit) {
+        task->vruntime = rq->min_vruntime - credit;
+    }
+    rb_insert(&rq->tasks, &task->run_node, vruntime_less);
+    rq->load += task_weight(task);
+    return 1;
+}
+
+static pcb_t *cfs_pick_next(cpu_t *cpu, uint32_t current_time_ms) {
+    (void) current_time_ms;
+    cfs_rq_t *rq = cpu->rq;
+    pcb_t *task = leftmost_task(rq);
+    if (!task) return NULL;
+    remove_task(rq, task);
+    update_min_vruntime(rq, task);
+    return task;
+}
+
+static pcb_t *cfs_steal(cpu_t *cpu) {
+    // The rightmost task would wait the longest here
+    cfs_rq_t *rq = cpu->rq;
+    rb_node_t *node = rb_last(&rq->tasks);
+    if (!node) return NULL;
+    pcb_t *task = rb_entry(node, pcb_t, run_node);
+    remove_task(rq, task);
+    return task;
+}
+
+static int cfs_tick(cpu_t *cpu, pcb_t *task, uint32_t delta_ms, uint32_t current_time_ms) {
+    task->vruntime += ms_to_vruntime(delta_ms, task_weight(task));
+    update_min_vruntime(cpu->rq, task);
+
+    // Alone on the CPU: keep running instead of being put back and picked again
+    if (cpu->nr_ready == 0) return 0;
+    return current_time_ms - task->slice_start_ms >= ideal_slice_ms(cpu, task);
+}
+
+// Wake-up preemption: a waiting task that is more than the minimum granularity
+// (in its own vruntime) behind the running task takes the CPU
+static int cfs_preempt(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms) {
+    (void) current_time_ms;
+    pcb_t *first = leftmost_task(cpu->rq);
+    if (!first) return 0;
+    uint64_t granularity = ms_to_vruntime(cfs_min_granularity_ms, task_weight(first));
+    return first->vruntime + granularity < task->vruntime;
+}
+
+static uint32_t cfs_slice_left(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms) {
+    if (cpu->nr_ready == 0) return UINT32_MAX;
+    uint32_t used = current_time_ms - task->slice_start_ms;
+    uint32_t slice = ideal_slice_ms(cpu, task);
+    return used < slice ? slice - used : 0;
+}
+
+const sched_class_t sched_cfs = {
+    .name = "cfs",
+    .description = "Completely fair: red-black tree on vruntime, nice weights (--sched-latency, --min-granularity)",
+    .init = cfs_init,
+    .enqueue = cfs_enqueue,
+    .pick_next = cfs_pick_next,
+    .steal = cfs_steal,
+    .tick = cfs_tick,
+    .preempt = cfs_preempt,
+    .slice_left_ms = cfs_slice_left,
+};
@@ -0,0 +1,89 @@
+#include "sched_heap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int entry_less(const heap_entry_t *a, const heap_entry_t *b) {
+    if (a->key != b->key) return a->key < b->key;
+    return a->seq < b->seq;
+}
+
+static void swap_entries(heap_entry_t *a, heap_entry_t *b) {
+    heap_entry_t tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+/**
+ * Insert a PCB in the heap
+ * @param heap the heap
+ * @param pcb the PCB
+ * @param key the ordering key, the smallest key is popped first
+ * @return 1 on success, 0 on failure
+ */
+int heap_push(pcb_heap_t *heap, pcb_t *pcb, uint64_t key) {
+    if (heap->size == heap->capacity) {
+        int capacity = heap->capacity ? heap->capacity * 2 : 16;
+        heap_entry_t *items = realloc(heap->items, (size_t) capacity * sizeof(heap_entry_t));
+        if (!items) {
+            printf("Cannot allocate memory for the ready heap\n");
+            return 0;
+        }
+        heap->items = items;
+        heap->capacity = capacity;
+    }
+    int i = heap->size++;
+    heap->items[i] = (heap_entry_t) {.key = key, .seq = heap->next_seq++, .pcb = pcb};
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!entry_less(&heap->items[i], &heap->items[parent])) break;
+        swap_entries(&heap->items[i], &heap->items[parent]);
+        i = parent;
+    }
+    return 1;
+}
+
+/**
+ * Remove and return the PCB with the smallest key
+ * @param heap the heap
+ * @return the PCB, or NULL if the heap is empty
+ */
+pcb_t *heap_pop(pcb_heap_t *heap) {
+    if (heap->size == 0) return NULL;
+    pcb_t *top = heap->items[0].pcb;
+    heap->items[0] = heap->items[--heap->size];
+
+    int i = 0;
+    for (;;) {
+        int left = 2 * i + 1, right = left + 1, smallest = i;
+        if (left < heap->size && entry_less(&heap->items[left], &heap->items[smallest])) smallest = left;
+        if (right < heap->size && entry_less(&heap->items[right], &heap->items[smallest])) smallest = right;
+        if (smallest == i) break;
+        swap_entries(&heap->items[i], &heap->items[smallest]);
+        i = smallest;
+    }
+    return top;
+}
+
+/**
+ * Look at the PCB with the smallest key without removing it
+ * @param heap the heap
+ * @param key if not NULL, receives the key of that PCB
+ * @return the PCB, or NULL if the heap is empty
+ */
+pcb_t *heap_peek(pcb_heap_t *heap, uint64_t *key) {
+    if (heap->size == 0) return NULL;
+    if (key) *key = heap->items[0].key;
+    return heap->items[0].pcb;
+}
+
+/**
+ * Remove the last element of the array. It is a leaf, so this is O(1) and keeps the
+ * heap valid; it is used to give a task away to another CPU.
+ * @param heap the heap
+ * @return the PCB, or NULL if the heap is empty
+ */
+pcb_t *heap_pop_last(pcb_heap_t *heap) {
+    if (heap->size == 0) return NULL;
+    return heap->items[--heap->size].pcb;
+}
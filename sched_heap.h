@@ -0,0 +1,32 @@
+#ifndef SCHED_HEAP_H
+#define SCHED_HEAP_H
+
+#include <stdint.h>
+
+#include "pcb.h"
+
+/*
+ * Binary min-heap of PCBs, used as the ready queue of the policies that always run
+ * the task with the smallest key (shortest job, shortest remaining time, priority).
+ * Push and pop are O(log n). Tasks with the same key come out in FIFO order.
+ * The array only grows, so a heap in steady state does not allocate.
+ */
+typedef struct heap_entry_st {
+    uint64_t key;
+    uint64_t seq;               // Insertion order, breaks ties between equal keys
+    pcb_t   *pcb;
+} heap_entry_t;
+
+typedef struct pcb_heap_st {
+    heap_entry_t *items;
+    int           size;
+    int           capacity;
+    uint64_t      next_seq;
+} pcb_heap_t;
+
+int heap_push(pcb_heap_t *heap, pcb_t *pcb, uint64_t key);
+pcb_t *heap_pop(pcb_heap_t *heap);
+pcb_t *heap_peek(pcb_heap_t *heap, uint64_t *key);
+pcb_t *heap_pop_last(pcb_heap_t *heap);
+
+#endif //SCHED_HEAP_H
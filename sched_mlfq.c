@@ -0,0 +1,190 @@
+/*
+ * Multi-Level Feedback Queue (--scheduler mlfq).
+ *
+ * Every CPU has mlfq_levels FIFO queues; level 0 has the highest priority and the
+ * shortest quantum. A task that uses its whole quantum is moved one level down, a task
+ * that finishes its burst (blocks) before its quantum ends is moved one level up, so
+ * IO-bound tasks stay on top and CPU-bound ones sink. Every mlfq_boost_ms all tasks go
+ * back to level 0, so the ones at the bottom cannot starve.
+ *
+ * A bitmap of the non-empty levels makes picking the next task O(1) (count trailing
+ * zeros). A waiting task of a higher level preempts the running task.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "scheduler.h"
+#include "msg.h"
+
+int mlfq_levels = 3;
+uint32_t mlfq_boost_ms = 1000;
+
+// Quantum of the first levels; the levels after the last one given double it
+static uint32_t quanta_ms[MLFQ_MAX_LEVELS] = {20};
+static int num_quanta = 1;
+
+typedef struct mlfq_rq_st {
+    queue_t  levels[MLFQ_MAX_LEVELS];
+    uint32_t nonempty;              // Bit i is set when levels[i] has tasks
+    uint32_t epoch;                 // Boost period this queue was last boosted in
+} mlfq_rq_t;
+
+/**
+ * Set the quanta of the levels from a comma separated list, e.g. "20,40,80"
+ * @param list the quanta in ms, each at least TICKS_MS
+ * @return 0 on success, -1 if the list is invalid
+ */
+int mlfq_set_quanta(const char *list) {
+    uint32_t parsed[MLFQ_MAX_LEVELS];
+    int count = 0;
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long value = strtol(p, &end, 10);
+        if (end == p || value < TICKS_MS || value > UINT32_MAX / 2 || count == MLFQ_MAX_LEVELS) return -1;
+        parsed[count++] = (uint32_t) value;
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            return -1;
+        }
+        p = end;
+    }
+    if (count == 0) return -1;
+    memcpy(quanta_ms, parsed, (size_t) count * sizeof(uint32_t));
+    num_quanta = count;
+    return 0;
+}
+
+/**
+ * @param level the level (0 to mlfq_levels - 1)
+ * @return the quantum of that level in ms
+ */
+uint32_t mlfq_quantum_ms(int level) {
+    if (level < num_quanta) return quanta_ms[level];
+    uint64_t quantum = (uint64_t) quanta_ms[num_quanta - 1] << (level - num_quanta + 1);
+    return quantum > UINT32_MAX / 2 ? UINT32_MAX / 2 : (uint32_t) quantum;
+}
+
+static uint32_t boost_epoch(uint32_t current_time_ms) {
+    return mlfq_boost_ms ? current_time_ms / mlfq_boost_ms : 0;
+}
+
+// A task that was not on this CPU's queues during a boost gets it when it comes back
+static void boost_task(pcb_t *task, uint32_t current_time_ms) {
+    uint32_t epoch = boost_epoch(current_time_ms);
+    if (task->mlfq_epoch != epoch) {
+        task->mlfq_epoch = epoch;
+        task->mlfq_level = 0;
+    }
+}
+
+// Priority boost: once per boost period, move every waiting task to level 0
+static void boost_queue(mlfq_rq_t *rq, uint32_t current_time_ms) {
+    uint32_t epoch = boost_epoch(current_time_ms);
+    if (rq->epoch == epoch) return;
+    rq->epoch = epoch;
+
+    uint32_t lower = rq->nonempty & ~1u;
+    while (lower) {
+        int level = __builtin_ctz(lower);
+        lower &= lower - 1;
+        pcb_t *task;
+        while ((task = dequeue_pcb(&rq->levels[level])) != NULL) {
+            enqueue_pcb(&rq->levels[0], task);
+        }
+    }
+    for (pcb_t *task = rq->levels[0].head; task; task = task->next) {
+        task->mlfq_level = 0;
+        task->mlfq_epoch = epoch;
+    }
+    rq->nonempty = rq->levels[0].head ? 1u : 0u;
+}
+
+static pcb_t *take(mlfq_rq_t *rq, int level, int from_tail) {
+    queue_t *q = &rq->levels[level];
+    pcb_t *task = from_tail ? q->tail : q->head;
+    if (!task) return NULL;
+    remove_pcb(q, task);
+    if (!q->head) rq->nonempty &= ~(1u << level);
+    return task;
+}
+
+static int mlfq_init(cpu_t *cpu) {
+    mlfq_rq_t *rq = calloc(1, sizeof(mlfq_rq_t));
+    if (!rq) return -1;
+    cpu->rq = rq;
+    return 0;
+}
+
+static int mlfq_enqueue(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms) {
+    mlfq_rq_t *rq = cpu->rq;
+    boost_queue(rq, current_time_ms);
+    boost_task(task, current_time_ms);
+    if (task->mlfq_level >= mlfq_levels) task->mlfq_level = mlfq_levels - 1;
+
+    if (!enqueue_pcb(&rq->levels[task->mlfq_level], task)) return 0;
+    rq->nonempty |= 1u << task->mlfq_level;
+    return 1;
+}
+
+static pcb_t *mlfq_pick_next(cpu_t *cpu, uint32_t current_time_ms) {
+    mlfq_rq_t *rq = cpu->rq;
+    boost_queue(rq, current_time_ms);
+    if (!rq->nonempty) return NULL;
+    return take(rq, __builtin_ctz(rq->nonempty), 0);
+}
+
+static pcb_t *mlfq_steal(cpu_t *cpu) {
+    // Give away the last task of the lowest non-empty level
+    mlfq_rq_t *rq = cpu->rq;
+    if (!rq->nonempty) return NULL;
+    return take(rq, 31 - __builtin_clz(rq->nonempty), 1);
+}
+
+static int mlfq_tick(cpu_t *cpu, pcb_t *task, uint32_t delta_ms, uint32_t current_time_ms) {
+    (void) cpu;
+    (void) delta_ms;
+    boost_task(task, current_time_ms);
+    uint32_t used = current_time_ms - task->slice_start_ms;
+    uint32_t quantum = mlfq_quantum_ms(task->mlfq_level);
+
+    if (task->ellapsed_time_ms >= task->time_ms) {
+        // Burst done: blocking before the quantum ended moves the task up
+        if (used < quantum && task->mlfq_level > 0) task->mlfq_level--;
+        return 0;
+    }
+    if (used >= quantum) {
+        // Used the whole quantum: move down
+        if (task->mlfq_level < mlfq_levels - 1) task->mlfq_level++;
+        return 1;
+    }
+    return 0;
+}
+
+static int mlfq_preempt(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms) {
+    mlfq_rq_t *rq = cpu->rq;
+    boost_queue(rq, current_time_ms);
+    boost_task(task, current_time_ms);
+    return rq->nonempty && __builtin_ctz(rq->nonempty) < task->mlfq_level;
+}
+
+static uint32_t mlfq_slice_left(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms) {
+    (void) cpu;
+    uint32_t used = current_time_ms - task->slice_start_ms;
+    uint32_t quantum = mlfq_quantum_ms(task->mlfq_level);
+    return used < quantum ? quantum - used : 0;
+}
+
+const sched_class_t sched_mlfq = {
+    .name = "mlfq",
+    .description = "Multi-level feedback queue (--mlfq-levels, --mlfq-quantum, --mlfq-boost)",
+    .init = mlfq_init,
+    .enqueue = mlfq_enqueue,
+    .pick_next = mlfq_pick_next,
+    .steal = mlfq_steal,
+    .tick = mlfq_tick,
+    .preempt = mlfq_preempt,
+    .slice_left_ms = mlfq_slice_left,
+};
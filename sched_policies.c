@@ -0,0 +1,198 @@
+/*
+ * Scheduling policies selectable with --scheduler. Every policy keeps one ready queue
+ * per CPU in cpu->rq, with a data structure that fits the order it runs tasks in:
+ *   rr, fifo   FIFO list (queue_t), O(1)
+ *   sjf, srtf  min-heap on the (remaining) burst time, O(log n)
+ *   prio       min-heap on the nice value, O(log n)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "scheduler.h"
+#include "sched_heap.h"
+
+// ============================================ Helpers ================================================================
+
+static uint32_t remaining_ms(pcb_t *task) {
+    return (task->time_ms > task->ellapsed_time_ms) ? task->time_ms - task->ellapsed_time_ms : 0;
+}
+
+static uint32_t slice_left(pcb_t *task, uint32_t current_time_ms) {
+    uint32_t used = current_time_ms - task->slice_start_ms;
+    return (used < sched_time_slice_ms) ? sched_time_slice_ms - used : 0;
+}
+
+static int slice_expired(cpu_t *cpu, pcb_t *task, uint32_t delta_ms, uint32_t current_time_ms) {
+    (void) cpu;
+    (void) delta_ms;
+    return slice_left(task, current_time_ms) == 0;
+}
+
+static int never(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms) {
+    (void) cpu;
+    (void) task;
+    (void) current_time_ms;
+    return 0;
+}
+
+static int no_slice(cpu_t *cpu, pcb_t *task, uint32_t delta_ms, uint32_t current_time_ms) {
+    (void) cpu;
+    (void) task;
+    (void) delta_ms;
+    (void) current_time_ms;
+    return 0;
+}
+
+static uint32_t no_slice_left(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms) {
+    (void) cpu;
+    (void) task;
+    (void) current_time_ms;
+    return UINT32_MAX;
+}
+
+// ========================================= FIFO list policies ========================================================
+
+static int list_init(cpu_t *cpu) {
+    queue_t *q = calloc(1, sizeof(queue_t));
+    if (!q) return -1;
+    cpu->rq = q;
+    return 0;
+}
+
+static int list_enqueue(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms) {
+    (void) current_time_ms;
+    return enqueue_pcb(cpu->rq, task);      // Add to tail of ready queue
+}
+
+static pcb_t *list_pick_next(cpu_t *cpu, uint32_t current_time_ms) {
+    (void) current_time_ms;
+    return dequeue_pcb(cpu->rq);            // Dequeue from head
+}
+
+static pcb_t *list_steal(cpu_t *cpu) {
+    // The tail is the task that would wait the longest here
+    queue_t *q = cpu->rq;
+    pcb_t *task = q->tail;
+    if (task) remove_pcb(q, task);
+    return task;
+}
+
+static uint32_t sliced_left(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms) {
+    (void) cpu;
+    return slice_left(task, current_time_ms);
+}
+
+// Round Robin: FIFO order, a task is preempted when its time slice ends
+const sched_class_t sched_rr = {
+    .name = "rr",
+    .description = "Round Robin with a fixed time slice (--slice)",
+    .init = list_init,
+    .enqueue = list_enqueue,
+    .pick_next = list_pick_next,
+    .steal = list_steal,
+    .tick = slice_expired,
+    .preempt = never,
+    .slice_left_ms = sliced_left,
+};
+
+// First come, first served: a task runs until its burst is done
+const sched_class_t sched_fifo = {
+    .name = "fifo",
+    .description = "First come first served, no preemption",
+    .init = list_init,
+    .enqueue = list_enqueue,
+    .pick_next = list_pick_next,
+    .steal = list_steal,
+    .tick = no_slice,
+    .preempt = never,
+    .slice_left_ms = no_slice_left,
+};
+
+// ============================================ Heap policies ==========================================================
+
+static int heap_init(cpu_t *cpu) {
+    pcb_heap_t *heap = calloc(1, sizeof(pcb_heap_t));
+    if (!heap) return -1;
+    cpu->rq = heap;
+    return 0;
+}
+
+static pcb_t *heap_pick_next(cpu_t *cpu, uint32_t current_time_ms) {
+    (void) current_time_ms;
+    return heap_pop(cpu->rq);
+}
+
+static pcb_t *heap_steal(cpu_t *cpu) {
+    return heap_pop_last(cpu->rq);
+}
+
+static int remaining_enqueue(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms) {
+    (void) current_time_ms;
+    return heap_push(cpu->rq, task, remaining_ms(task));
+}
+
+// Preempt when a waiting task needs less time than what the running task has left
+static int srtf_preempt(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms) {
+    (void) current_time_ms;
+    uint64_t shortest;
+    if (!heap_peek(cpu->rq, &shortest)) return 0;
+    return shortest < remaining_ms(task);
+}
+
+// Shortest job first: the shortest burst runs first and is not preempted
+const sched_class_t sched_sjf = {
+    .name = "sjf",
+    .description = "Shortest job first, no preemption",
+    .init = heap_init,
+    .enqueue = remaining_enqueue,
+    .pick_next = heap_pick_next,
+    .steal = heap_steal,
+    .tick = no_slice,
+    .preempt = never,
+    .slice_left_ms = no_slice_left,
+};
+
+// Shortest remaining time first: preemptive version of SJF
+const sched_class_t sched_srtf = {
+    .name = "srtf",
+    .description = "Shortest remaining time first (preemptive SJF)",
+    .init = heap_init,
+    .enqueue = remaining_enqueue,
+    .pick_next = heap_pick_next,
+    .steal = heap_steal,
+    .tick = no_slice,
+    .preempt = srtf_preempt,
+    .slice_left_ms = no_slice_left,
+};
+
+// Lower nice = higher priority; shift nice (-20..19) so the key is unsigned
+static uint64_t prio_key(pcb_t *task) {
+    return (uint64_t) ((int64_t) task->nice + 128);
+}
+
+static int prio_enqueue(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms) {
+    (void) current_time_ms;
+    return heap_push(cpu->rq, task, prio_key(task));
+}
+
+static int prio_preempt(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms) {
+    (void) current_time_ms;
+    uint64_t best;
+    if (!heap_peek(cpu->rq, &best)) return 0;
+    return best < prio_key(task);
+}
+
+// Static priority from the nice value, preemptive. Tasks of equal priority take turns:
+// when the slice ends the task is re-inserted behind the others with the same key
+const sched_class_t sched_prio = {
+    .name = "prio",
+    .description = "Preemptive priority on the nice value, round robin on ties",
+    .init = heap_init,
+    .enqueue = prio_enqueue,
+    .pick_next = heap_pick_next,
+    .steal = heap_steal,
+    .tick = slice_expired,
+    .preempt = prio_preempt,
+    .slice_left_ms = sliced_left,
+};
@@ -3,52 +3,285 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "msg.h"
-#include <unistd.h>
+#include "wire.h"
+
+// Policies, implemented in sched_policies.c
+extern const sched_class_t sched_rr;
+extern const sched_class_t sched_fifo;
+extern const sched_class_t sched_sjf;
+extern const sched_class_t sched_srtf;
+extern const sched_class_t sched_prio;
+// Implemented in sched_cfs.c and sched_mlfq.c
+extern const sched_class_t sched_cfs;
+extern const sched_class_t sched_mlfq;
+
+// Registry of the policies that can be selected with --scheduler
+static const sched_class_t *const sched_classes[] = {
+    &sched_rr,
+    &sched_fifo,
+    &sched_sjf,
+    &sched_srtf,
+    &sched_prio,
+    &sched_cfs,
+    &sched_mlfq,
+};
+#define NUM_SCHED_CLASSES (sizeof(sched_classes) / sizeof(sched_classes[0]))
+
+const sched_class_t *current_scheduler = &sched_rr;
+uint32_t sched_time_slice_ms = TIME_SLICE_MS;
+
+/**
+ * @brief Select the scheduling policy by name.
+ *
+ * Must be called before create_cpus().
+ *
+ * @param name Name of the policy (rr, fifo, ...).
+ * @return 0 on success, -1 if there is no such policy.
+ */
+int set_scheduler(const char *name) {
+    for (size_t i = 0; i < NUM_SCHED_CLASSES; i++) {
+        if (strcmp(sched_classes[i]->name, name) == 0) {
+            current_scheduler = sched_classes[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Print the available scheduling policies.
+ */
+void list_schedulers(FILE *out) {
+    for (size_t i = 0; i < NUM_SCHED_CLASSES; i++) {
+        fprintf(out, "  %-6s %s\n", sched_classes[i]->name, sched_classes[i]->description);
+    }
+}
+
+/**
+ * @brief Create the simulated processors.
+ *
+ * @param num_cpus Number of CPUs (1 to MAX_CPUS).
+ * @return Array of idle CPUs with empty ready queues, or NULL on failure.
+ */
+cpu_t *create_cpus(int num_cpus) {
+    if (num_cpus <= 0 || num_cpus > MAX_CPUS) {
+        printf("create_cpus: invalid num_cpus=%d\n", num_cpus);
+        return NULL;
+    }
+    cpu_t *cpus = calloc((size_t) num_cpus, sizeof(cpu_t));
+    if (!cpus) {
+        printf("Cannot allocate memory for CPUs\n");
+        return NULL;
+    }
+    for (int i = 0; i < num_cpus; i++) {
+        cpus[i].id = i;
+        if (current_scheduler->init(&cpus[i]) < 0) {
+            printf("Cannot create the ready queue of CPU %d\n", i);
+            free(cpus);
+            return NULL;
+        }
+        if (tlb_init(&cpus[i].tlb) < 0) {
+            printf("Cannot create the TLB of CPU %d\n", i);
+            free(cpus);
+            return NULL;
+        }
+    }
+    return cpus;
+}
+
+// Tasks on a CPU: the running one plus the ones waiting in its ready queue
+static int cpu_load(cpu_t *cpu) {
+    return cpu->nr_ready + (cpu->task ? 1 : 0);
+}
+
+/**
+ * @brief Put a task in the ready queue of a CPU.
+ *
+ * If the policy cannot take it (out of memory), the task goes back to the global ready
+ * queue rq instead, so it is not lost: scheduler() places it again on its next call.
+ */
+static void cpu_enqueue(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms, queue_t *rq) {
+    if (current_scheduler->enqueue(cpu, task, current_time_ms)) {
+        cpu->nr_ready++;
+        return;
+    }
+    printf("Task %d could not be queued on CPU %d, it stays in the ready queue\n", task->pid, cpu->id);
+    enqueue_pcb(rq, task);
+}
+
+/**
+ * @brief Choose the CPU for a task that became ready.
+ *
+ * The task goes back to the CPU it last ran on (its cache/TLB may still be warm),
+ * unless that CPU has more than one task more than the least loaded CPU.
+ */
+static cpu_t *select_cpu(pcb_t *task, cpu_t *cpus, int num_cpus) {
+    cpu_t *least = &cpus[0];
+    for (int i = 1; i < num_cpus; i++) {
+        if (cpu_load(&cpus[i]) < cpu_load(least)) least = &cpus[i];
+    }
+    if (task->last_cpu >= 0 && task->last_cpu < num_cpus) {
+        cpu_t *last = &cpus[task->last_cpu];
+        if (cpu_load(last) <= cpu_load(least) + 1) return last;
+    }
+    return least;
+}
+
+/**
+ * @brief Work stealing: take a waiting task from the CPU with the longest ready queue.
+ *
+ * Which task is given away is up to the policy. The task is put in the thief's ready
+ * queue, so the policy can place it there (e.g. CFS adjusts its vruntime).
+ *
+ * @return 1 if a task was stolen, 0 otherwise.
+ */
+static int steal_task(cpu_t *thief, cpu_t *cpus, int num_cpus, uint32_t current_time_ms, queue_t *rq) {
+    cpu_t *victim = NULL;
+    for (int i = 0; i < num_cpus; i++) {
+        if (&cpus[i] == thief || cpus[i].nr_ready == 0) continue;
+        if (!victim || cpus[i].nr_ready > victim->nr_ready) victim = &cpus[i];
+    }
+    if (!victim) return 0;
+
+    pcb_t *task = current_scheduler->steal(victim);
+    if (!task) return 0;
+    victim->nr_ready--;
+    thief->steals++;
+    cpu_enqueue(thief, task, current_time_ms, rq);
+    return 1;
+}
+
+/**
+ * @brief Account the time the running task spent on a CPU and take it off when needed.
+ *
+ * A task that finished its burst gets a DONE message and goes to the command queue;
+ * a task whose time slice expired goes back to the CPU's ready queue.
+ */
+static void update_running_task(uint32_t current_time_ms, cpu_t *cpu, queue_t *rq, queue_t *cq) {
+    pcb_t *task = cpu->task;
+    // Add the time since the last update to the running time of the application/task
+    // (one tick with the real clock, possibly more when the virtual clock skipped ahead)
+    uint32_t delta = current_time_ms - task->last_update_time_ms;
+    task->ellapsed_time_ms += delta;
+    task->last_update_time_ms = current_time_ms;
+    cpu->busy_ms += delta;
+    int slice_expired = current_scheduler->tick(cpu, task, delta, current_time_ms);
+
+    if (task->ellapsed_time_ms >= task->time_ms) {
+        // Task finished
+        // Send msg to application
+        msg_t msg = {
+            .pid = task->pid,
+            .request = PROCESS_REQUEST_DONE,
+            .time_ms = current_time_ms
+        };
+        send_to_app(task, &msg);
+        cpu->turnaround_ms += current_time_ms - task->ready_time_ms;
+        cpu->completions++;
+        // Burst is finished, wait for the next instruction
+        enqueue_command(cq, task);
+        cpu->task = NULL;
+    } else if (slice_expired) {
+        // Time slice expired, preempt and put back in ready queue
+        task->slice_start_ms = 0;
+        cpu_enqueue(cpu, task, current_time_ms, rq);
+        cpu->task = NULL;
+    }
+}
 
 /**
  * @brief Scheduling algorithm.
  *
- * This function implements the scheduling algorithm.
- * It is a simple RR (Round Robin) scheduler with time slices and preemption.
+ * This function runs the selected scheduling policy (current_scheduler) on every CPU.
+ * Tasks that became ready (rq) are first spread over the per-CPU ready queues, a
+ * running task is preempted if the policy says a waiting one should go first, and
+ * an idle CPU with an empty ready queue steals from the busiest one.
  *
  * @param current_time_ms The current time in milliseconds.
- * @param rq Pointer to the ready queue containing tasks that are ready to run.
- * @param cpu_task Double pointer to the currently running task. This will be updated
- *                 to point to the next task to run.
- * @return int Returns 0 if the same task continues, 1 if a new task was scheduled onto the CPU.
- */
-int scheduler(uint32_t current_time_ms, queue_t *rq, queue_t *cq, pcb_t **cpu_task) {
-    if (*cpu_task) {
-        (*cpu_task)->ellapsed_time_ms += TICKS_MS;      // Add to the running time of the application/task
-        if ((*cpu_task)->ellapsed_time_ms >= (*cpu_task)->time_ms) {
-            // Task finished
-            // Send msg to application
-            msg_t msg = {
-                .pid = (*cpu_task)->pid,
-                .request = PROCESS_REQUEST_DONE,
-                .time_ms = current_time_ms
-            };
-            if (write((*cpu_task)->sockfd, &msg, sizeof(msg_t)) != sizeof(msg_t)) {
-                perror("write");
+ * @param rq Pointer to the queue of tasks that became ready since the last call (and of the
+ *           ones a CPU could not take, see cpu_enqueue()).
+ * @param cq Pointer to the command queue, for tasks that finished their burst.
+ * @param cpus The simulated CPUs. cpus[i].dispatched is set for every CPU that
+ *             got a new task.
+ * @param num_cpus Number of CPUs.
+ * @return int Returns the number of CPUs on which a new task was scheduled.
+ */
+int scheduler(uint32_t current_time_ms, queue_t *rq, queue_t *cq, cpu_t *cpus, int num_cpus) {
+    for (int i = 0; i < num_cpus; i++) {
+        cpus[i].dispatched = 0;
+        if (cpus[i].task) update_running_task(current_time_ms, &cpus[i], rq, cq);
+    }
+
+    // Only the tasks queued so far: one a CPU could not take is back at the tail
+    pcb_t *task;
+    pcb_t *last = rq->tail;
+    while (last && (task = dequeue_pcb(rq)) != NULL) {
+        int more = task != last;
+        cpu_enqueue(select_cpu(task, cpus, num_cpus), task, current_time_ms, rq);
+        if (!more) break;
+    }
+
+    int dispatched = 0;
+    for (int i = 0; i < num_cpus; i++) {
+        cpu_t *cpu = &cpus[i];
+        if (cpu->task != NULL) {
+            if (cpu->nr_ready == 0 || !current_scheduler->preempt(cpu, cpu->task, current_time_ms)) {
+                continue;                           // CPU is busy
             }
-            // Burst is finished
-            enqueue_pcb(cq, *cpu_task);
-            (*cpu_task) = NULL;
-        } else if ((current_time_ms - (*cpu_task)->slice_start_ms) >= TIME_SLICE_MS) {
-            // Time slice expired, preempt and put back in ready queue
-            (*cpu_task)->slice_start_ms = 0;
-            enqueue_pcb(rq, *cpu_task);  // Add to tail of ready queue
-            (*cpu_task) = NULL;
+            cpu->preemptions++;
+            cpu_enqueue(cpu, cpu->task, current_time_ms, rq);
+            cpu->task = NULL;
         }
-    }
-    if (*cpu_task == NULL) {            // If CPU is idle
-        *cpu_task = dequeue_pcb(rq);   // Get next task from ready queue (dequeue from head)
-        // TODO: Handle the swapping, if any add a 50ms penalty to the slice time
-        if (*cpu_task) {
-            (*cpu_task)->slice_start_ms = current_time_ms;
-            return 1;
+
+        // Get next task from the CPU's ready queue, or steal one
+        if (cpu->nr_ready == 0) steal_task(cpu, cpus, num_cpus, current_time_ms, rq);
+        task = current_scheduler->pick_next(cpu, current_time_ms);
+        if (task) cpu->nr_ready--;
+        if (!task) continue;
+
+        if (task->last_cpu >= 0 && task->last_cpu != cpu->id) cpu->migrations++;
+        if (task->first_run_pending) {
+            cpu->response_ms += current_time_ms - task->ready_time_ms;
+            cpu->responses++;
+            task->first_run_pending = 0;
         }
+        task->last_cpu = cpu->id;
+        tlb_switch(&cpu->tlb, task->pid);
+        task->slice_start_ms = current_time_ms;
+        task->last_update_time_ms = current_time_ms;
+        cpu->task = task;
+        cpu->dispatched = 1;
+        cpu->dispatches++;
+        dispatched++;
+    }
+    return dispatched;
+}
+
+/**
+ * @brief Time until the scheduler has something to do for a running task.
+ *
+ * This is either the end of a burst or the end of a time slice on any CPU,
+ * whichever comes first. Used by the virtual clock to skip idle ticks.
+ *
+ * @param current_time_ms The current time in milliseconds.
+ * @param cpus The simulated CPUs.
+ * @param num_cpus Number of CPUs.
+ * @return Milliseconds until the next scheduling event, or UINT32_MAX if all CPUs are idle.
+ */
+uint32_t scheduler_next_event_ms(uint32_t current_time_ms, cpu_t *cpus, int num_cpus) {
+    uint32_t next = UINT32_MAX;
+    for (int i = 0; i < num_cpus; i++) {
+        pcb_t *task = cpus[i].task;
+        if (!task) continue;
+
+        uint32_t burst_left = (task->time_ms > task->ellapsed_time_ms)
+                                  ? task->time_ms - task->ellapsed_time_ms : 0;
+        uint32_t slice_left = current_scheduler->slice_left_ms(&cpus[i], task, current_time_ms);
+        if (burst_left < next) next = burst_left;
+        if (slice_left < next) next = slice_left;
     }
-}
\ No newline at end of file
+    return next;
+}
@@ -1,10 +1,84 @@
 #ifndef FIFO_H
 #define FIFO_H
 
+#include <stdio.h>
+
 #include "queue.h"
+#include "tlb.h"
 
 #define TIME_SLICE_MS 500
 
-int scheduler(uint32_t current_time_ms, queue_t *rq, queue_t *cq, pcb_t **cpu_task);
+#define MAX_CPUS 256
+
+#define MLFQ_MAX_LEVELS 32
+
+typedef struct sched_class_st sched_class_t;
+
+// A simulated processor: the task running on it and its own ready queue
+typedef struct cpu_st {
+    int      id;
+    pcb_t   *task;              // Task running on this CPU, NULL when idle
+    void    *rq;                // Ready queue of this CPU, its type depends on the scheduling policy
+    int      nr_ready;          // Number of tasks in the ready queue
+    int      dispatched;        // Set by scheduler() when a new task was put on the CPU this tick
+    tlb_t    tlb;               // Translations of the pages accessed on this CPU
+
+    // Statistics
+    uint32_t busy_ms;           // Time spent running tasks
+    uint32_t dispatches;        // Number of tasks put on the CPU
+    uint32_t migrations;        // Dispatches of tasks that last ran on another CPU
+    uint32_t steals;            // Tasks taken from the ready queue of another CPU
+    uint32_t preemptions;       // Running tasks taken off for a better one
+    uint32_t swap_waits;        // Tasks taken off to wait for a page from swap
+    uint64_t response_ms;       // Sum of the times from RUN to the first dispatch of a burst
+    uint32_t responses;         // Bursts that got their first dispatch on this CPU
+    uint64_t turnaround_ms;     // Sum of the times from RUN to DONE
+    uint32_t completions;       // Bursts that finished on this CPU
+} cpu_t;
+
+/*
+ * A scheduling policy. The generic part of the scheduler (scheduler.c) does the time
+ * accounting, sends DONE, balances the CPUs and decides when to call these; the policy
+ * only owns the ready queue of each CPU and the order in which tasks run.
+ */
+struct sched_class_st {
+    const char *name;
+    const char *description;
+
+    // Allocate the (empty) ready queue of a CPU in cpu->rq
+    int      (*init)(cpu_t *cpu);
+    // Add a task that became ready, or that was taken off the CPU, to the ready queue;
+    // returns 1 on success, 0 if the queue could not take it (out of memory)
+    int      (*enqueue)(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms);
+    // Remove and return the task that should run next (NULL if none)
+    pcb_t   *(*pick_next)(cpu_t *cpu, uint32_t current_time_ms);
+    // Remove and return a task to be migrated to another CPU (NULL if none)
+    pcb_t   *(*steal)(cpu_t *cpu);
+    // Account a tick of the running task; returns 1 when it used up its time slice
+    int      (*tick)(cpu_t *cpu, pcb_t *task, uint32_t delta_ms, uint32_t current_time_ms);
+    // Returns 1 if a task in the ready queue should preempt the running task now
+    int      (*preempt)(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms);
+    // Time until the running task's slice ends (UINT32_MAX if the policy has no slices)
+    uint32_t (*slice_left_ms)(cpu_t *cpu, pcb_t *task, uint32_t current_time_ms);
+};
+
+extern const sched_class_t *current_scheduler;
+extern uint32_t sched_time_slice_ms;
+extern uint32_t cfs_target_latency_ms;
+extern uint32_t cfs_min_granularity_ms;
+extern int mlfq_levels;
+extern uint32_t mlfq_boost_ms;
+
+int mlfq_set_quanta(const char *list);
+uint32_t mlfq_quantum_ms(int level);
+
+int set_scheduler(const char *name);
+void list_schedulers(FILE *out);
+
+cpu_t *create_cpus(int num_cpus);
+
+int scheduler(uint32_t current_time_ms, queue_t *rq, queue_t *cq, cpu_t *cpus, int num_cpus);
+
+uint32_t scheduler_next_event_ms(uint32_t current_time_ms, cpu_t *cpus, int num_cpus);
 
 #endif //FIFO_H
@@ -2,8 +2,19 @@
 // Created by Martijn Kuipers on 10/10/2025.
 //
 
+// O_DIRECT
+#define _GNU_SOURCE
+
 #include "swap.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
 #include "uthash.h"
 
 typedef struct {
@@ -12,3 +23,312 @@ typedef struct {
     UT_hash_handle hh;     // Makes this structure hashable
 } page_table_entry_t;
 
+uint32_t swap_latency_us = 5000;
+uint32_t swap_bandwidth_mbs = 100;
+
+/**
+ * Turn the swap device on, with an empty queue
+ * @param dev the swap device
+ */
+void swap_device_init(swap_device_t *dev) {
+    memset(dev, 0, sizeof(*dev));
+    dev->enabled = 1;
+}
+
+void swap_device_free(swap_device_t *dev) {
+    free(dev->done_us);
+    dev->done_us = NULL;
+    dev->capacity = 0;
+    dev->count = 0;
+}
+
+/**
+ * Make room for one more request in the queue, doubling the ring buffer if it is full
+ * @return 0 on success, -1 on failure
+ */
+static int reserve_request(swap_device_t *dev) {
+    if (dev->count < dev->capacity) return 0;
+    uint32_t capacity = dev->capacity ? dev->capacity * 2 : 16;
+    uint64_t *done_us = malloc((size_t) capacity * sizeof(uint64_t));
+    if (!done_us) {
+        printf("Cannot allocate memory for the swap device queue\n");
+        return -1;
+    }
+    for (uint32_t i = 0; i < dev->count; i++) {
+        done_us[i] = dev->done_us[(dev->head + i) % dev->capacity];
+    }
+    free(dev->done_us);
+    dev->done_us = done_us;
+    dev->head = 0;
+    dev->capacity = capacity;
+    return 0;
+}
+
+/**
+ * Queue a page transfer on the swap device. It starts when the requests before it
+ * are done and takes swap_latency_us plus one page at swap_bandwidth_mbs.
+ * @param dev the swap device
+ * @param current_time_ms the time the request is made
+ * @param type SWAP_READ or SWAP_WRITE
+ * @return the time the transfer completes, rounded up to a ms (current_time_ms if the device is off)
+ */
+uint32_t swap_device_submit(swap_device_t *dev, uint32_t current_time_ms, swap_io_t type) {
+    if (!dev->enabled) return current_time_ms;
+    uint64_t now_us = (uint64_t) current_time_ms * 1000;
+
+    // Requests that completed in the meantime leave the queue
+    while (dev->count > 0 && dev->done_us[dev->head] <= now_us) {
+        dev->head = (dev->head + 1) % dev->capacity;
+        dev->count--;
+    }
+
+    // 1 MB/s is one byte per us
+    uint64_t service_us = swap_latency_us;
+    if (swap_bandwidth_mbs > 0) service_us += (SWAP_PAGE_SIZE + swap_bandwidth_mbs - 1) / swap_bandwidth_mbs;
+    uint64_t start_us = dev->busy_until_us > now_us ? dev->busy_until_us : now_us;
+    uint64_t done_us = start_us + service_us;
+    dev->busy_until_us = done_us;
+    dev->busy_us += service_us;
+
+    // If the queue cannot grow the request is still served, it only is not counted as queued
+    if (reserve_request(dev) == 0) {
+        dev->done_us[(dev->head + dev->count) % dev->capacity] = done_us;
+        dev->count++;
+        if (dev->count > dev->max_queued) dev->max_queued = dev->count;
+    }
+    if (type == SWAP_READ) {
+        dev->reads++;
+        dev->read_wait_us += done_us - now_us;
+    } else {
+        dev->writes++;
+    }
+    return (uint32_t) ((done_us + 999) / 1000);
+}
+
+/**
+ * Create the swap space, and the swap file if a path is given. The file is allocated
+ * in full now, so swapping never has to grow it.
+ * @param space the swap space
+ * @param path the swap file, NULL to only keep track of the slots
+ * @param nslots number of pages the swap can hold (rounded up to whole clusters)
+ * @return 0 on success, -1 on failure
+ */
+int swap_space_init(swap_space_t *space, const char *path, uint32_t nslots) {
+    memset(space, 0, sizeof(*space));
+    space->fd = -1;
+    if (nslots == 0) {
+        printf("swap_space_init: the swap needs at least one slot\n");
+        return -1;
+    }
+    space->nclusters = (uint32_t) (((uint64_t) nslots + SWAP_CLUSTER_SLOTS - 1) / SWAP_CLUSTER_SLOTS);
+    space->nslots = space->nclusters * SWAP_CLUSTER_SLOTS;
+    space->bitmap = calloc((size_t) space->nclusters * SWAP_CLUSTER_WORDS, sizeof(uint64_t));
+    space->cluster_used = calloc(space->nclusters, sizeof(uint16_t));
+    space->free_clusters = malloc((size_t) space->nclusters * sizeof(uint32_t));
+    if (!space->bitmap || !space->cluster_used || !space->free_clusters) {
+        printf("Cannot allocate memory for the swap slots\n");
+        swap_space_free(space);
+        return -1;
+    }
+    // Cluster 0 is filled first, then 1, 2, ... (the top of the stack is at the end)
+    space->current = 0;
+    for (uint32_t i = 0; i + 1 < space->nclusters; i++) {
+        space->free_clusters[i] = space->nclusters - 1 - i;
+    }
+    space->nfree_clusters = space->nclusters - 1;
+    if (path == NULL) return 0;
+
+    // Bypass the page cache where the file system allows it, so the I/O reaches the disk
+    space->fd = open(path, O_RDWR | O_CREAT | O_DIRECT, 0600);
+    if (space->fd < 0 && errno == EINVAL) space->fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (space->fd < 0) {
+        perror("open swap file");
+        swap_space_free(space);
+        return -1;
+    }
+    int err = posix_fallocate(space->fd, 0, (off_t) space->nslots * SWAP_PAGE_SIZE);
+    if (err != 0) {
+        fprintf(stderr, "Cannot allocate %u pages for swap file %s: %s\n", space->nslots, path, strerror(err));
+        swap_space_free(space);
+        return -1;
+    }
+    if (posix_memalign((void **) &space->page, SWAP_PAGE_SIZE, SWAP_PAGE_SIZE) != 0) {
+        printf("Cannot allocate memory for the swap page buffer\n");
+        swap_space_free(space);
+        return -1;
+    }
+    return 0;
+}
+
+void swap_space_free(swap_space_t *space) {
+    if (space->fd >= 0) close(space->fd);
+    space->fd = -1;
+    free(space->bitmap);
+    free(space->cluster_used);
+    free(space->free_clusters);
+    free(space->page);
+    free(space->refs);
+    space->refs = NULL;
+    space->bitmap = NULL;
+    space->cluster_used = NULL;
+    space->free_clusters = NULL;
+    space->page = NULL;
+}
+
+/**
+ * Take a free slot: the next one of the current cluster, or of a new cluster when it is full
+ * @param space the swap space
+ * @return the slot, or SWAP_NO_SLOT if the swap is full
+ */
+uint32_t swap_slot_alloc(swap_space_t *space) {
+    if (space->used >= space->nslots) {
+        space->failed_allocs++;
+        return SWAP_NO_SLOT;
+    }
+    if (space->cluster_used[space->current] == SWAP_CLUSTER_SLOTS) {
+        if (space->nfree_clusters > 0) {
+            space->current = space->free_clusters[--space->nfree_clusters];
+            space->current_has_holes = 0;
+        } else {
+            // No empty cluster left: fill the holes of the next partly used one
+            while (space->cluster_used[space->scan] == SWAP_CLUSTER_SLOTS) {
+                space->scan = (space->scan + 1) % space->nclusters;
+            }
+            space->current = space->scan;
+            space->current_has_holes = 1;
+        }
+    }
+    uint64_t *words = &space->bitmap[(size_t) space->current * SWAP_CLUSTER_WORDS];
+    int w = 0;
+    while (words[w] == UINT64_MAX) w++;         // The cluster is not full, so this stops
+    int bit = __builtin_ctzll(~words[w]);
+    words[w] |= 1ull << bit;
+    space->cluster_used[space->current]++;
+    space->used++;
+    if (space->used > space->max_used) space->max_used = space->used;
+    if (space->current_has_holes) space->fragmented_allocs++;
+    return space->current * SWAP_CLUSTER_SLOTS + (uint32_t) (w * 64 + bit);
+}
+
+/**
+ * Give a slot back. A cluster that becomes empty goes back on the stack of empty clusters.
+ * A slot with more than one reference only loses one (see swap_slot_dup()).
+ * @param space the swap space
+ * @param slot the slot, as returned by swap_slot_alloc()
+ */
+void swap_slot_free(swap_space_t *space, uint32_t slot) {
+    if (slot >= space->nslots) return;
+    if (space->refs && space->refs[slot] > 0) {
+        space->refs[slot]--;
+        return;
+    }
+    uint64_t *word = &space->bitmap[slot / 64];
+    uint64_t mask = 1ull << (slot % 64);
+    if (!(*word & mask)) {
+        printf("swap_slot_free: slot %u is not in use\n", slot);
+        return;
+    }
+    *word &= ~mask;
+    uint32_t cluster = slot / SWAP_CLUSTER_SLOTS;
+    space->used--;
+    if (--space->cluster_used[cluster] == 0 && cluster != space->current) {
+        space->free_clusters[space->nfree_clusters++] = cluster;
+    }
+}
+
+/**
+ * Take one more reference to a slot in use: a forked process shares the copy of a page
+ * with its parent, and each of them frees it once
+ * @param space the swap space
+ * @param slot the slot
+ * @return 0 on success, -1 if out of memory or the slot has too many references
+ */
+int swap_slot_dup(swap_space_t *space, uint32_t slot) {
+    if (slot >= space->nslots) return -1;
+    if (!space->refs) {
+        space->refs = calloc(space->nslots, sizeof(uint16_t));
+        if (!space->refs) {
+            printf("Cannot allocate memory for the swap slot references\n");
+            return -1;
+        }
+    }
+    if (space->refs[slot] == UINT16_MAX) return -1;
+    space->refs[slot]++;
+    return 0;
+}
+
+/**
+ * @return 1 if more than one page refers to the slot, so it must not be written over
+ */
+int swap_slot_shared(const swap_space_t *space, uint32_t slot) {
+    return space->refs && slot < space->nslots && space->refs[slot] > 0;
+}
+
+static uint64_t elapsed_ns(const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (uint64_t) (end.tv_sec - start->tv_sec) * 1000000000ull + (uint64_t) end.tv_nsec - (uint64_t) start->tv_nsec;
+}
+
+/**
+ * Write a page to its slot in the swap file. The simulated pages have no contents, so
+ * the page is filled from its id, which swap_slot_read() checks.
+ * @param space the swap space
+ * @param slot the slot
+ * @param page_id the page, (pid<<32)|vfn
+ * @return 0 on success (or if there is no swap file), -1 on failure
+ */
+int swap_slot_write(swap_space_t *space, uint32_t slot, uint64_t page_id) {
+    if (space->fd < 0) return 0;
+    memset(space->page, (int) (page_id & 0xff), SWAP_PAGE_SIZE);
+    memcpy(space->page, &page_id, sizeof(page_id));
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ssize_t n = pwrite(space->fd, space->page, SWAP_PAGE_SIZE, (off_t) slot * SWAP_PAGE_SIZE);
+    space->file_io_ns += elapsed_ns(&start);
+    if (n != SWAP_PAGE_SIZE) {
+        perror("pwrite swap file");
+        return -1;
+    }
+    space->file_writes++;
+    return 0;
+}
+
+/**
+ * Read a page back from its slot in the swap file
+ * @param space the swap space
+ * @param slot the slot
+ * @param page_id the page that should be in the slot
+ * @return 0 on success (or if there is no swap file), -1 if it could not be read or holds another page
+ */
+int swap_slot_read(swap_space_t *space, uint32_t slot, uint64_t page_id) {
+    if (space->fd < 0) return 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ssize_t n = pread(space->fd, space->page, SWAP_PAGE_SIZE, (off_t) slot * SWAP_PAGE_SIZE);
+    space->file_io_ns += elapsed_ns(&start);
+    if (n != SWAP_PAGE_SIZE) {
+        perror("pread swap file");
+        return -1;
+    }
+    space->file_reads++;
+    uint64_t stored;
+    memcpy(&stored, space->page, sizeof(stored));
+    if (stored != page_id) {
+        printf("Swap slot %u holds page %llx instead of %llx\n", slot, (unsigned long long) stored,
+               (unsigned long long) page_id);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @return the number of clusters that are neither empty nor full
+ */
+uint32_t swap_partial_clusters(const swap_space_t *space) {
+    uint32_t partial = 0;
+    for (uint32_t c = 0; c < space->nclusters; c++) {
+        if (space->cluster_used[c] > 0 && space->cluster_used[c] < SWAP_CLUSTER_SLOTS) partial++;
+    }
+    return partial;
+}
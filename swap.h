@@ -5,4 +5,89 @@
 #ifndef SWAP_H
 #define SWAP_H
 
+#include <stdint.h>
+
+/*
+ * Simulated swap device. Page reads and writes are served one at a time in FIFO
+ * order; each takes the latency of the device plus the transfer of one page at its
+ * bandwidth. Writes of evicted pages only occupy the device, a read makes the
+ * faulting process wait (BLOCKED) until it completes.
+ *
+ * Times are kept in microseconds so that transfers much shorter than a tick add up.
+ */
+#define SWAP_PAGE_SIZE 4096
+
+extern uint32_t swap_latency_us;        // Access time of every request (--swap-latency)
+extern uint32_t swap_bandwidth_mbs;     // Transfer rate in MB/s, 0 for instant transfers (--swap-bandwidth)
+
+typedef enum { SWAP_READ = 0, SWAP_WRITE } swap_io_t;
+
+typedef struct swap_device_st {
+    int       enabled;          // Off (all requests complete at once) until swap_device_init()
+    uint64_t *done_us;          // Completion times of the requests in the queue (ring buffer)
+    uint32_t  head;
+    uint32_t  count;
+    uint32_t  capacity;
+    uint64_t  busy_until_us;    // When the last request in the queue completes
+
+    // Statistics
+    uint64_t  reads;
+    uint64_t  writes;
+    uint64_t  busy_us;          // Time spent serving requests
+    uint64_t  read_wait_us;     // Sum of the times from submitting a read to its completion
+    uint32_t  max_queued;       // Longest the queue got (including the request in service)
+} swap_device_t;
+
+void swap_device_init(swap_device_t *dev);
+void swap_device_free(swap_device_t *dev);
+uint32_t swap_device_submit(swap_device_t *dev, uint32_t current_time_ms, swap_io_t type);
+
+/*
+ * Swap space: the slots the swapped out pages are stored in, optionally backed by a
+ * real swap file (--swap-file) that the pages are written to and read from.
+ *
+ * Slots are handed out from clusters of SWAP_CLUSTER_SLOTS, like Linux does: a cluster
+ * is filled before the next one is started, so pages evicted together end up next to
+ * each other in the file. Empty clusters are kept on a stack; only when there is none
+ * left are slots taken from the holes in partly used clusters, which is what makes the
+ * swap fragmented.
+ */
+#define SWAP_CLUSTER_SLOTS 256
+#define SWAP_CLUSTER_WORDS (SWAP_CLUSTER_SLOTS / 64)
+#define SWAP_NO_SLOT UINT32_MAX
+
+typedef struct swap_space_st {
+    int        fd;                  // The swap file, -1 if the slots are only counted
+    uint32_t   nslots;
+    uint32_t   nclusters;
+    uint64_t  *bitmap;              // One bit per slot, set when in use
+    uint16_t  *cluster_used;        // Slots in use per cluster
+    uint32_t  *free_clusters;       // Stack of the empty clusters (but the current one)
+    uint32_t   nfree_clusters;
+    uint32_t   current;             // Cluster slots are taken from
+    uint32_t   scan;                // Where the search for a hole in a partly used cluster goes on
+    int        current_has_holes;   // The current cluster was partly used when it was taken
+    uint8_t   *page;                // Page buffer for the file (aligned for O_DIRECT)
+    uint16_t  *refs;                // More references to each slot than the first (fork shares slots), NULL until one
+
+    // Statistics
+    uint32_t   used;
+    uint32_t   max_used;
+    uint64_t   fragmented_allocs;   // Slots taken from a partly used cluster
+    uint64_t   failed_allocs;       // Swap outs that found the swap full
+    uint64_t   file_writes;
+    uint64_t   file_reads;
+    uint64_t   file_io_ns;          // Wall-clock time spent in pwrite/pread
+} swap_space_t;
+
+int swap_space_init(swap_space_t *space, const char *path, uint32_t nslots);
+void swap_space_free(swap_space_t *space);
+uint32_t swap_slot_alloc(swap_space_t *space);
+void swap_slot_free(swap_space_t *space, uint32_t slot);
+int swap_slot_dup(swap_space_t *space, uint32_t slot);
+int swap_slot_shared(const swap_space_t *space, uint32_t slot);
+int swap_slot_write(swap_space_t *space, uint32_t slot, uint64_t page_id);
+int swap_slot_read(swap_space_t *space, uint32_t slot, uint64_t page_id);
+uint32_t swap_partial_clusters(const swap_space_t *space);
+
 #endif //SWAP_H
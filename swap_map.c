@@ -0,0 +1,174 @@
+#include "swap_map.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SWAP_MAP_MIN_BUCKETS 64
+#define NO_ENTRY UINT32_MAX
+
+static swapped_frame_t *entry_at(const swap_map_t *map, uint32_t index) {
+    return &map->slabs[index >> SWAP_MAP_SLAB_BITS][index & (SWAP_MAP_SLAB - 1)];
+}
+
+// Fibonacci hashing: the top bits of the product depend on every bit of the key
+static uint32_t home_bucket(const swap_map_t *map, uint64_t key) {
+    return (uint32_t) ((key * 0x9E3779B97F4A7C15ull) >> map->shift);
+}
+
+/**
+ * Find the bucket of a key
+ * @return the bucket index, or NO_ENTRY if the key is not in the map
+ */
+static uint32_t find_bucket(const swap_map_t *map, uint64_t key) {
+    if (map->buckets == NULL) return NO_ENTRY;
+    uint32_t i = home_bucket(map, key);
+    for (uint32_t dist = 1; ; dist++) {
+        const swap_map_bucket_t *b = &map->buckets[i];
+        // Empty, or a key closer to its home than ours would be: ours would have taken this bucket
+        if (b->dist < dist) return NO_ENTRY;
+        if (b->key == key) return i;
+        i = (i + 1) & map->mask;
+    }
+}
+
+/**
+ * Put a key in the table, taking the bucket of every key that is closer to its home
+ * on the way; the key that was displaced goes on looking further. There must be room.
+ */
+static void place(swap_map_t *map, uint64_t key, uint32_t entry) {
+    swap_map_bucket_t cur = {.key = key, .dist = 1, .entry = entry};
+    uint32_t i = home_bucket(map, key);
+    for (;;) {
+        swap_map_bucket_t *b = &map->buckets[i];
+        if (b->dist == 0) {
+            *b = cur;
+            return;
+        }
+        if (b->dist < cur.dist) {
+            swap_map_bucket_t displaced = *b;
+            *b = cur;
+            cur = displaced;
+        }
+        i = (i + 1) & map->mask;
+        cur.dist++;
+    }
+}
+
+/**
+ * Double the number of buckets (or create the first ones) and put all keys back
+ * @return 0 on success, -1 on failure
+ */
+static int grow(swap_map_t *map) {
+    uint32_t old_size = map->buckets ? map->mask + 1 : 0;
+    uint32_t size = old_size ? old_size * 2 : SWAP_MAP_MIN_BUCKETS;
+    swap_map_bucket_t *old = map->buckets;
+    map->buckets = calloc(size, sizeof(swap_map_bucket_t));
+    if (!map->buckets) {
+        printf("Cannot allocate memory for the swap map\n");
+        map->buckets = old;
+        return -1;
+    }
+    map->mask = size - 1;
+    map->shift = 64 - (uint32_t) __builtin_ctz(size);
+    for (uint32_t i = 0; i < old_size; i++) {
+        if (old[i].dist) place(map, old[i].key, old[i].entry);
+    }
+    free(old);
+    return 0;
+}
+
+/**
+ * Take an entry: the last one freed, or the next one of the slabs (adding a slab if needed)
+ * @return the index of the entry, or NO_ENTRY if out of memory
+ */
+static uint32_t new_entry(swap_map_t *map) {
+    if (map->free_head) {
+        uint32_t index = map->free_head - 1;
+        map->free_head = entry_at(map, index)->next_free;
+        return index;
+    }
+    if (map->nentries == map->nslabs * SWAP_MAP_SLAB) {
+        swapped_frame_t **slabs = realloc(map->slabs, (map->nslabs + 1) * sizeof(swapped_frame_t *));
+        if (!slabs) return NO_ENTRY;
+        map->slabs = slabs;
+        map->slabs[map->nslabs] = malloc(SWAP_MAP_SLAB * sizeof(swapped_frame_t));
+        if (!map->slabs[map->nslabs]) return NO_ENTRY;
+        map->nslabs++;
+    }
+    return map->nentries++;
+}
+
+/**
+ * Look a swapped out page up
+ * @param map the swap map
+ * @param key the page, (pid<<32)|vfn
+ * @return the entry, or NULL if the page is not in swap
+ */
+swapped_frame_t *swap_map_find(const swap_map_t *map, uint64_t key) {
+    uint32_t i = find_bucket(map, key);
+    return i == NO_ENTRY ? NULL : entry_at(map, map->buckets[i].entry);
+}
+
+/**
+ * Add a swapped out page
+ * @param map the swap map
+ * @param key the page, (pid<<32)|vfn
+ * @return the entry, with only page_id set (the existing entry if the page is in the map already),
+ *         or NULL if out of memory
+ */
+swapped_frame_t *swap_map_insert(swap_map_t *map, uint64_t key) {
+    swapped_frame_t *existing = swap_map_find(map, key);
+    if (existing) return existing;
+    // Grow at 7/8 full, Robin Hood keeps the probes short up to there
+    if (map->buckets == NULL || map->count + 1 > (map->mask + 1) - (map->mask + 1) / 8) {
+        if (grow(map) < 0) return NULL;
+    }
+    uint32_t index = new_entry(map);
+    if (index == NO_ENTRY) {
+        printf("Cannot allocate memory for swapped frame\n");
+        return NULL;
+    }
+    swapped_frame_t *entry = entry_at(map, index);
+    memset(entry, 0, sizeof(*entry));
+    entry->page_id = key;
+    place(map, key, index);
+    map->count++;
+    return entry;
+}
+
+/**
+ * Remove a swapped out page from the map
+ * @param map the swap map
+ * @param key the page, (pid<<32)|vfn
+ * @param out where the entry is copied to before it is reused (may be NULL)
+ * @return 1 if the page was in the map, 0 otherwise
+ */
+int swap_map_take(swap_map_t *map, uint64_t key, swapped_frame_t *out) {
+    uint32_t i = find_bucket(map, key);
+    if (i == NO_ENTRY) return 0;
+    uint32_t index = map->buckets[i].entry;
+    swapped_frame_t *entry = entry_at(map, index);
+    if (out) *out = *entry;
+    entry->next_free = map->free_head;
+    map->free_head = index + 1;
+
+    // Shift the keys after it back by one, until one that is at home or an empty bucket
+    uint32_t next = (i + 1) & map->mask;
+    while (map->buckets[next].dist > 1) {
+        map->buckets[i] = map->buckets[next];
+        map->buckets[i].dist--;
+        i = next;
+        next = (next + 1) & map->mask;
+    }
+    map->buckets[i].dist = 0;
+    map->count--;
+    return 1;
+}
+
+void swap_map_free(swap_map_t *map) {
+    for (uint32_t s = 0; s < map->nslabs; s++) free(map->slabs[s]);
+    free(map->slabs);
+    free(map->buckets);
+    memset(map, 0, sizeof(*map));
+}
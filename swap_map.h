@@ -0,0 +1,28 @@
+#ifndef SWAP_MAP_H
+#define SWAP_MAP_H
+
+/*
+ * Map of the swapped out pages, keyed on page_id = (pid<<32)|vfn.
+ *
+ * Open addressing with Robin Hood hashing: a key that is further from its home
+ * bucket takes the place of one that is closer, so probe lengths stay short even
+ * with a full table, and a lookup can stop as soon as it meets a key closer to
+ * home than it would be. Removal shifts the following keys back, there are no
+ * tombstones. Buckets are 16 bytes (key, distance, entry index), four per cache line.
+ *
+ * The entries themselves come from slabs of SWAP_MAP_SLAB entries that are never
+ * freed or moved: a removed entry goes on a free list and is the next one reused,
+ * so swap churn does not call malloc.
+ */
+
+#include "virtmem_types.h"
+
+#define SWAP_MAP_SLAB_BITS 10
+#define SWAP_MAP_SLAB      (1u << SWAP_MAP_SLAB_BITS)
+
+swapped_frame_t *swap_map_find(const swap_map_t *map, uint64_t key);
+swapped_frame_t *swap_map_insert(swap_map_t *map, uint64_t key);
+int swap_map_take(swap_map_t *map, uint64_t key, swapped_frame_t *out);
+void swap_map_free(swap_map_t *map);
+
+#endif //SWAP_MAP_H
@@ -0,0 +1,163 @@
+//
+// Micro-benchmark of the swap map against the uthash table it replaced.
+//
+// Both sides run the same swap churn: fill the swap with pages of a few processes,
+// then repeatedly swap one page in (lookup + remove) and another out (insert),
+// plus lookups of pages that are not in swap, as page_request() does on a fault.
+//
+// Usage: swap_map_bench [pages in swap] [operations]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "swap_map.h"
+#include "uthash.h"
+
+#define NUM_PIDS 16
+
+// The entry of the swap hash before the swap map: one malloc per swapped out page
+typedef struct legacy_frame_st {
+    uint64_t page_id;
+    uint32_t slot;
+    uint32_t last_accessed;
+    uint8_t dirty:1;
+    UT_hash_handle hh;
+} legacy_frame_t;
+
+static uint64_t rng_state = 0x2545F4914F6CDD1Dull;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static uint64_t make_key(uint64_t n) {
+    uint64_t pid = 1 + n % NUM_PIDS;
+    uint32_t vfn = (uint32_t) (1 + n / NUM_PIDS);
+    return (pid << 32) | vfn;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+/**
+ * Build the workload: the pages in swap at the start, and for every operation the page
+ * swapped in (one of those in swap), the page swapped out and a page that is not in swap
+ * @return 0 on success, -1 if out of memory
+ */
+static int make_workload(uint32_t pages, uint32_t ops, uint64_t **keys, uint32_t **victims, uint64_t **misses) {
+    *keys = malloc((size_t) pages * sizeof(uint64_t));
+    *victims = malloc((size_t) ops * sizeof(uint32_t));
+    *misses = malloc((size_t) ops * sizeof(uint64_t));
+    if (!*keys || !*victims || !*misses) return -1;
+    for (uint32_t i = 0; i < pages; i++) (*keys)[i] = make_key(i);
+    for (uint32_t i = 0; i < ops; i++) {
+        (*victims)[i] = (uint32_t) (next_random() % pages);
+        (*misses)[i] = make_key(pages + ops + next_random() % pages);
+    }
+    return 0;
+}
+
+static uint64_t run_uthash(uint64_t *keys, uint32_t pages, const uint32_t *victims, const uint64_t *misses,
+                           uint32_t ops, uint64_t next) {
+    legacy_frame_t *table = NULL;
+    uint64_t checksum = 0;
+    for (uint32_t i = 0; i < pages; i++) {
+        legacy_frame_t *e = malloc(sizeof(legacy_frame_t));
+        if (!e) exit(EXIT_FAILURE);
+        e->page_id = keys[i];
+        e->slot = i;
+        HASH_ADD(hh, table, page_id, sizeof(uint64_t), e);
+    }
+    for (uint32_t i = 0; i < ops; i++) {
+        legacy_frame_t *e = NULL;
+        HASH_FIND(hh, table, &misses[i], sizeof(uint64_t), e);
+        if (e) checksum++;
+        HASH_FIND(hh, table, &keys[victims[i]], sizeof(uint64_t), e);
+        checksum += e->slot;
+        HASH_DEL(table, e);
+        free(e);
+        keys[victims[i]] = make_key(next++);
+        e = malloc(sizeof(legacy_frame_t));
+        if (!e) exit(EXIT_FAILURE);
+        e->page_id = keys[victims[i]];
+        e->slot = i;
+        HASH_ADD(hh, table, page_id, sizeof(uint64_t), e);
+    }
+    legacy_frame_t *e, *tmp;
+    HASH_ITER(hh, table, e, tmp) {
+        HASH_DEL(table, e);
+        free(e);
+    }
+    return checksum;
+}
+
+static uint64_t run_swap_map(uint64_t *keys, uint32_t pages, const uint32_t *victims, const uint64_t *misses,
+                             uint32_t ops, uint64_t next) {
+    swap_map_t map = {0};
+    uint64_t checksum = 0;
+    for (uint32_t i = 0; i < pages; i++) {
+        swapped_frame_t *e = swap_map_insert(&map, keys[i]);
+        if (!e) exit(EXIT_FAILURE);
+        e->slot = i;
+    }
+    for (uint32_t i = 0; i < ops; i++) {
+        if (swap_map_find(&map, misses[i])) checksum++;
+        swapped_frame_t taken;
+        swap_map_take(&map, keys[victims[i]], &taken);
+        checksum += taken.slot;
+        keys[victims[i]] = make_key(next++);
+        swapped_frame_t *e = swap_map_insert(&map, keys[victims[i]]);
+        if (!e) exit(EXIT_FAILURE);
+        e->slot = i;
+    }
+    swap_map_free(&map);
+    return checksum;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t pages = argc > 1 ? (uint32_t) strtoul(argv[1], NULL, 10) : 1u << 20;
+    uint32_t ops = argc > 2 ? (uint32_t) strtoul(argv[2], NULL, 10) : 1u << 22;
+    if (pages == 0 || ops == 0) {
+        fprintf(stderr, "Usage: %s [pages in swap] [operations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    uint64_t *keys;
+    uint32_t *victims;
+    uint64_t *misses;
+    if (make_workload(pages, ops, &keys, &victims, &misses) < 0) {
+        printf("Cannot allocate memory for the workload\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%u pages in swap, %u swap ins + swap outs + misses\n", pages, ops);
+    double start = now_ns();
+    uint64_t sum_uthash = run_uthash(keys, pages, victims, misses, ops, pages);
+    double uthash_ns = now_ns() - start;
+
+    // Same keys again for the swap map
+    for (uint32_t i = 0; i < pages; i++) keys[i] = make_key(i);
+    start = now_ns();
+    uint64_t sum_map = run_swap_map(keys, pages, victims, misses, ops, pages);
+    double map_ns = now_ns() - start;
+
+    if (sum_uthash != sum_map) {
+        printf("Results differ: %llu != %llu\n", (unsigned long long) sum_uthash, (unsigned long long) sum_map);
+        return EXIT_FAILURE;
+    }
+    // Every operation is a lookup of a miss, a swap in and a swap out
+    printf("uthash:   %8.1f ns/op\n", uthash_ns / ops);
+    printf("swap map: %8.1f ns/op (%.2fx)\n", map_ns / ops, uthash_ns / map_ns);
+    free(keys);
+    free(victims);
+    free(misses);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+#include "timer_wheel.h"
+
+#include <stdio.h>
+
+#include "msg.h"
+
+static uint32_t ms_to_tick(uint32_t time_ms) {
+    return (uint32_t) (((uint64_t) time_ms + TICKS_MS - 1) / TICKS_MS);
+}
+
+/**
+ * Put a PCB in the slot matching its wake-up tick, relative to the current tick
+ * @param w the timing wheel
+ * @param pcb the PCB (wakeup_time_ms already set)
+ * @param tick the wake-up tick, strictly after w->now_tick
+ * @return 1 on success, 0 on failure
+ */
+static int place(timer_wheel_t *w, pcb_t *pcb, uint32_t tick) {
+    uint32_t delta = tick - w->now_tick;
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1u << (WHEEL_BITS * (level + 1)))) level++;
+
+    uint32_t slot = (tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    if (!enqueue_pcb(&w->slots[level][slot], pcb)) return 0;
+    w->occupied[level] |= 1ull << slot;
+    return 1;
+}
+
+/**
+ * Move the slots of the upper levels that start at the current tick one level down
+ * @param w the timing wheel (now_tick is a multiple of WHEEL_SIZE)
+ */
+static void cascade(timer_wheel_t *w) {
+    for (int level = 1; level < WHEEL_LEVELS; level++) {
+        uint32_t slot = (w->now_tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+        if (w->occupied[level] & (1ull << slot)) {
+            w->occupied[level] &= ~(1ull << slot);
+            pcb_t *pcb;
+            while ((pcb = dequeue_pcb(&w->slots[level][slot])) != NULL) {
+                uint32_t tick = ms_to_tick(pcb->wakeup_time_ms);
+                if (tick <= w->now_tick) {
+                    enqueue_pcb(&w->expired, pcb);
+                } else {
+                    place(w, pcb, tick);
+                }
+            }
+        }
+        // Only go up a level if this one wrapped as well
+        if (slot != 0) break;
+    }
+}
+
+/**
+ * Advance the wheel to the given tick, collecting everything that expires on the way.
+ * Empty stretches of level 0 are skipped using the occupancy bitmap.
+ * @param w the timing wheel
+ * @param target the tick to advance to
+ */
+static void advance(timer_wheel_t *w, uint32_t target) {
+    while (w->now_tick < target) {
+        uint32_t idx = w->now_tick & WHEEL_MASK;
+        uint64_t later = (idx == WHEEL_MASK) ? 0 : (w->occupied[0] & (~0ull << (idx + 1)));
+        uint32_t next = later ? w->now_tick - idx + (uint32_t) __builtin_ctzll(later)
+                              : w->now_tick - idx + WHEEL_SIZE;     // next wrap: cascade point
+        if (next > target) {
+            // Nothing expires and nothing cascades before the target
+            w->now_tick = target;
+            return;
+        }
+        w->now_tick = next;
+        if ((w->now_tick & WHEEL_MASK) == 0) cascade(w);
+
+        uint32_t slot = w->now_tick & WHEEL_MASK;
+        if (w->occupied[0] & (1ull << slot)) {
+            w->occupied[0] &= ~(1ull << slot);
+            pcb_t *pcb;
+            while ((pcb = dequeue_pcb(&w->slots[0][slot])) != NULL) {
+                enqueue_pcb(&w->expired, pcb);
+            }
+        }
+    }
+}
+
+/**
+ * Initialize an empty timing wheel
+ * @param w the timing wheel
+ * @param current_time_ms the current simulation time
+ */
+void timer_wheel_init(timer_wheel_t *w, uint32_t current_time_ms) {
+    w->now_tick = current_time_ms / TICKS_MS;
+    w->count = 0;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        w->occupied[level] = 0;
+        for (uint32_t slot = 0; slot < WHEEL_SIZE; slot++) {
+            w->slots[level][slot].head = NULL;
+            w->slots[level][slot].tail = NULL;
+        }
+    }
+    w->expired.head = NULL;
+    w->expired.tail = NULL;
+}
+
+/**
+ * Add a PCB to the wheel
+ * @param w the timing wheel
+ * @param pcb the PCB to block
+ * @param wakeup_time_ms absolute time at which the PCB wakes up
+ * @return 1 on success, 0 on failure
+ */
+int timer_wheel_add(timer_wheel_t *w, pcb_t *pcb, uint32_t wakeup_time_ms) {
+    pcb->wakeup_time_ms = wakeup_time_ms;
+    uint32_t tick = ms_to_tick(wakeup_time_ms);
+    int ok = (tick <= w->now_tick) ? enqueue_pcb(&w->expired, pcb) : place(w, pcb, tick);
+    if (ok) w->count++;
+    return ok;
+}
+
+/**
+ * Advance the wheel to the current time and take out one PCB whose wake-up time has passed
+ * @param w the timing wheel
+ * @param current_time_ms the current simulation time
+ * @return an expired PCB, or NULL if there is none (left)
+ */
+pcb_t *timer_wheel_expire(timer_wheel_t *w, uint32_t current_time_ms) {
+    advance(w, current_time_ms / TICKS_MS);
+    pcb_t *pcb = dequeue_pcb(&w->expired);
+    if (pcb) w->count--;
+    return pcb;
+}
+
+/**
+ * Earliest time at which something may expire. For PCBs in the upper levels this is
+ * the time their slot is cascaded, which is a lower bound of their wake-up time.
+ * @param w the timing wheel
+ * @return the time in ms, or UINT32_MAX if the wheel is empty
+ */
+uint32_t timer_wheel_next_expiry_ms(timer_wheel_t *w) {
+    if (w->count == 0) return UINT32_MAX;
+    if (w->expired.head) return w->now_tick * TICKS_MS;
+
+    uint64_t next = UINT64_MAX;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        if (!w->occupied[level]) continue;
+        // Slots come up in order starting with the one after the current slot; the
+        // current slot itself was processed already and only comes back a rotation later
+        uint32_t shift = WHEEL_BITS * level;
+        uint32_t cur = (w->now_tick >> shift) & WHEEL_MASK;
+        uint32_t start = (cur + 1) & WHEEL_MASK;
+        uint64_t rotated = (w->occupied[level] >> start) | (start ? w->occupied[level] << (WHEEL_SIZE - start) : 0);
+        uint64_t distance = 1 + (uint64_t) __builtin_ctzll(rotated);
+        uint64_t slot_tick = (((uint64_t) w->now_tick >> shift) + distance) << shift;
+        if (slot_tick < next) next = slot_tick;
+    }
+    if (next == UINT64_MAX) {
+        printf("timer_wheel: count is %u but the wheel is empty\n", w->count);
+        return UINT32_MAX;
+    }
+    next *= TICKS_MS;
+    return next > UINT32_MAX ? UINT32_MAX : (uint32_t) next;
+}
@@ -0,0 +1,40 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+#include "queue.h"
+
+/*
+ * Hierarchical timing wheel for the BLOCKED state.
+ *
+ * Blocked PCBs are kept by absolute wake-up time (in ticks of TICKS_MS). Level 0
+ * has one slot per tick, every next level has slots WHEEL_SIZE times wider. A PCB
+ * is put in the lowest level that can hold its remaining time; when a level wraps,
+ * the next slot of the level above is cascaded down. Adding is O(1), expiring is
+ * O(1) amortised, and PCBs that are not about to wake up are never touched.
+ *
+ * WHEEL_LEVELS * WHEEL_BITS = 30 bits of ticks, more than a uint32_t in ms can hold.
+ */
+#define WHEEL_BITS   6
+#define WHEEL_SIZE   (1u << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 5
+
+typedef struct timer_wheel_st {
+    uint32_t now_tick;                          // Last tick that has been processed
+    uint32_t count;                             // Number of PCBs in the wheel (including expired)
+    uint64_t occupied[WHEEL_LEVELS];            // Bitmap of the non-empty slots of every level
+    queue_t  slots[WHEEL_LEVELS][WHEEL_SIZE];
+    queue_t  expired;                           // Woken up, waiting to be collected
+} timer_wheel_t;
+
+void timer_wheel_init(timer_wheel_t *w, uint32_t current_time_ms);
+
+int timer_wheel_add(timer_wheel_t *w, pcb_t *pcb, uint32_t wakeup_time_ms);
+
+pcb_t *timer_wheel_expire(timer_wheel_t *w, uint32_t current_time_ms);
+
+uint32_t timer_wheel_next_expiry_ms(timer_wheel_t *w);
+
+#endif //TIMER_WHEEL_H
@@ -0,0 +1,158 @@
+#include "tlb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+tlb_config_t tlb_config = {
+    .entries = 64,
+    .ways = 4,
+    .replacement = TLB_LRU,
+    .flush_on_switch = 0,
+    .walk_ns = 30,
+};
+
+static const char *const tlb_replacement_names[] = {
+    [TLB_LRU] = "lru",
+    [TLB_FIFO] = "fifo",
+    [TLB_RANDOM] = "random",
+};
+#define NUM_TLB_REPLACEMENTS (sizeof(tlb_replacement_names) / sizeof(tlb_replacement_names[0]))
+
+/**
+ * Select the replacement of the TLB sets by name
+ * @param name lru, fifo or random
+ * @return 0 on success, -1 if there is no such replacement
+ */
+int tlb_set_replacement(const char *name) {
+    for (size_t i = 0; i < NUM_TLB_REPLACEMENTS; i++) {
+        if (strcmp(tlb_replacement_names[i], name) == 0) {
+            tlb_config.replacement = (tlb_replacement_t) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *tlb_replacement_to_string(tlb_replacement_t replacement) {
+    return tlb_replacement_names[replacement];
+}
+
+/**
+ * Create an empty TLB with the geometry of tlb_config
+ * @param tlb the TLB to initialize
+ * @return 0 on success (also when tlb_config.entries is 0: the TLB is then left out), -1 on failure
+ */
+int tlb_init(tlb_t *tlb) {
+    memset(tlb, 0, sizeof(*tlb));
+    tlb->asid = -1;
+    tlb->epoch = 1;         // Entries start at epoch 0, so they are all invalid
+    if (tlb_config.entries == 0) return 0;
+
+    int ways = tlb_config.ways;
+    int sets = (ways > 0 && tlb_config.entries % ways == 0) ? tlb_config.entries / ways : 0;
+    if (sets == 0 || (sets & (sets - 1)) != 0) {
+        printf("TLB: %d entries cannot be split in a power of two of sets of %d ways\n", tlb_config.entries, ways);
+        return -1;
+    }
+    tlb->entries = calloc((size_t) tlb_config.entries, sizeof(tlb_entry_t));
+    if (!tlb->entries) {
+        printf("Cannot allocate memory for the TLB\n");
+        return -1;
+    }
+    tlb->set_mask = (uint32_t) sets - 1;
+    tlb->ways = ways;
+    return 0;
+}
+
+/**
+ * A process is dispatched on the CPU of this TLB. With --tlb-flush, a switch to another
+ * address space invalidates all entries; otherwise they stay, tagged with their ASID.
+ * @param tlb the TLB of the CPU
+ * @param asid the address space of the process (its pid)
+ */
+void tlb_switch(tlb_t *tlb, int32_t asid) {
+    if (tlb == NULL || tlb->entries == NULL || tlb->asid == asid) return;
+    if (tlb_config.flush_on_switch && tlb->asid != -1) {
+        tlb->epoch++;
+        tlb->stats.flushes++;
+    }
+    tlb->asid = asid;
+}
+
+static int entry_valid(const tlb_t *tlb, const frame_table_t *frame_table, const tlb_entry_t *e) {
+    return e->epoch == tlb->epoch && frame_table->frames[e->frame_id].gen == e->frame_gen;
+}
+
+/**
+ * Look a translation up
+ * @return the entry, or NULL on a miss
+ */
+static tlb_entry_t *tlb_lookup(tlb_t *tlb, const frame_table_t *frame_table, int32_t asid, uint32_t vpn) {
+    tlb_entry_t *set = &tlb->entries[(size_t) (vpn & tlb->set_mask) * (size_t) tlb->ways];
+    for (int w = 0; w < tlb->ways; w++) {
+        tlb_entry_t *e = &set[w];
+        if (e->vpn == vpn && e->asid == asid && entry_valid(tlb, frame_table, e)) return e;
+    }
+    return NULL;
+}
+
+/**
+ * Cache a translation, in an invalid way of its set if there is one, otherwise in the
+ * way chosen by the replacement
+ */
+static void tlb_fill(tlb_t *tlb, const frame_table_t *frame_table, int32_t asid, uint32_t vpn, int32_t frame_id) {
+    tlb_entry_t *set = &tlb->entries[(size_t) (vpn & tlb->set_mask) * (size_t) tlb->ways];
+    tlb_entry_t *victim = NULL;
+    for (int w = 0; w < tlb->ways && !victim; w++) {
+        if (!entry_valid(tlb, frame_table, &set[w])) victim = &set[w];
+    }
+    if (!victim && tlb_config.replacement == TLB_RANDOM) {
+        victim = &set[rand() % tlb->ways];
+    } else if (!victim) {
+        // lru and fifo both replace the oldest stamp, only lru refreshes it on a hit
+        victim = &set[0];
+        for (int w = 1; w < tlb->ways; w++) {
+            if ((int32_t) (set[w].stamp - victim->stamp) < 0) victim = &set[w];
+        }
+    }
+    victim->vpn = vpn;
+    victim->asid = asid;
+    victim->frame_id = frame_id;
+    victim->frame_gen = frame_table->frames[frame_id].gen;
+    victim->epoch = tlb->epoch;
+    victim->stamp = tlb->clock++;
+}
+
+/**
+ * Translate an access of a process through the TLB. A hit goes straight to the frame,
+ * a miss walks the page table with page_request() and caches the result.
+ * @param tlb the TLB of the CPU the process runs on, NULL (or without entries) for no TLB
+ * @param current_time_ms the current simulation time
+ * @param pcb the process
+ * @param frame_table the frame table
+ * @param swap the swap
+ * @param vfn the virtual frame number
+ * @param is_write 1 if the page is written to
+ * @return the page table entry of the page, or NULL on failure (as page_request())
+ */
+pte_t *tlb_access(tlb_t *tlb, uint32_t current_time_ms, pcb_t *pcb, frame_table_t *frame_table, swap_hash_t *swap,
+                  uint32_t vfn, int is_write) {
+    if (tlb == NULL || tlb->entries == NULL) {
+        return page_request(current_time_ms, pcb, frame_table, swap, vfn, is_write);
+    }
+    tlb_entry_t *e = tlb_lookup(tlb, frame_table, pcb->pid, vfn);
+    // A copy-on-write page is read-only in the TLB: a write traps to page_request(), which copies it
+    if (e && is_write && frame_table->frames[e->frame_id].vp->cow) e = NULL;
+    if (e) {
+        tlb->stats.hits++;
+        if (tlb_config.replacement == TLB_LRU) e->stamp = tlb->clock++;
+        return page_hit(current_time_ms, frame_table, swap, e->frame_id, is_write);
+    }
+    tlb->stats.misses++;
+    pte_t *vp = page_request(current_time_ms, pcb, frame_table, swap, vfn, is_write);
+    // The walk that finds the translation once the page is in memory reads every level
+    tlb->stats.walk_levels += pcb->page_table.height;
+    if (vp) tlb_fill(tlb, frame_table, pcb->pid, vfn, vp->frame_id);
+    return vp;
+}
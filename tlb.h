@@ -0,0 +1,73 @@
+#ifndef TLB_H
+#define TLB_H
+
+/*
+ * Translation lookaside buffer of a simulated CPU.
+ *
+ * A set-associative cache of (ASID, virtual page) -> frame translations in front of
+ * the page table walk. The ASID is the pid of the process. On a context switch the
+ * TLB is either flushed (--tlb-flush) or keeps the entries of the other processes,
+ * which cannot match because of their ASID.
+ *
+ * Entries are never shot down explicitly. Every frame has a generation that is bumped
+ * whenever its page leaves it (evicted or released), and an entry only hits if the
+ * frame still has the generation it was cached with. A flush works the same way with
+ * the epoch of the TLB, so both are O(1).
+ *
+ * A miss walks the page table: it costs one memory reference per level of the tree
+ * (tlb_config.walk_ns each), which is reported as the miss penalty.
+ */
+
+#include <stdint.h>
+
+#include "virtmem.h"
+
+typedef enum { TLB_LRU = 0, TLB_FIFO, TLB_RANDOM } tlb_replacement_t;
+
+// TLB geometry and behaviour, the same for every CPU (set from the command line)
+typedef struct tlb_config_st {
+    int               entries;          // 0: no TLB, every access walks the page table
+    int               ways;             // Entries per set (ways == entries: fully associative)
+    tlb_replacement_t replacement;      // Which way of a full set is replaced
+    int               flush_on_switch;  // 1: flush when another process is dispatched, 0: keep (ASID)
+    uint32_t          walk_ns;          // Cost of reading one page table level on a miss
+} tlb_config_t;
+
+extern tlb_config_t tlb_config;
+
+typedef struct tlb_entry_st {
+    uint32_t vpn;
+    int32_t  asid;
+    int32_t  frame_id;
+    uint32_t frame_gen;     // Generation of the frame when the entry was filled
+    uint32_t epoch;         // Epoch of the TLB when the entry was filled
+    uint32_t stamp;         // Last use (lru) or fill (fifo)
+} tlb_entry_t;
+
+typedef struct tlb_stats_st {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t flushes;
+    uint64_t walk_levels;   // Page table levels read by the misses
+} tlb_stats_t;
+
+typedef struct tlb_st {
+    tlb_entry_t *entries;   // sets * ways, the ways of a set are adjacent
+    uint32_t     set_mask;
+    int          ways;
+    uint32_t     epoch;     // Entries of an older epoch were flushed
+    uint32_t     clock;     // Source of the stamps
+    int32_t      asid;      // Address space of the last process dispatched, -1 if none
+    tlb_stats_t  stats;
+} tlb_t;
+
+int tlb_set_replacement(const char *name);
+const char *tlb_replacement_to_string(tlb_replacement_t replacement);
+
+int tlb_init(tlb_t *tlb);
+void tlb_switch(tlb_t *tlb, int32_t asid);
+
+pte_t *tlb_access(tlb_t *tlb, uint32_t current_time_ms, pcb_t *pcb, frame_table_t *frame_table, swap_hash_t *swap,
+                  uint32_t vfn, int is_write);
+
+#endif //TLB_H
@@ -0,0 +1,186 @@
+#include "trace.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "queue.h"
+#include "uthash.h"
+
+// Processes of the trace, by pid; their PCBs only serve for the page table
+typedef struct trace_process_st {
+    int32_t pid;
+    pcb_t  *pcb;
+    UT_hash_handle hh;
+} trace_process_t;
+
+static trace_process_t *processes = NULL;
+static trace_process_t *last_process = NULL;    // Traces tend to stay with one process for a while
+
+static pcb_t *find_process(int32_t pid) {
+    if (last_process && last_process->pid == pid) return last_process->pcb;
+
+    trace_process_t *proc = NULL;
+    HASH_FIND(hh, processes, &pid, sizeof(int32_t), proc);
+    if (!proc) {
+        proc = malloc(sizeof(trace_process_t));
+        pcb_t *pcb = new_pcb(pid, 0, 0);
+        if (!proc || !pcb) {
+            printf("Cannot allocate memory for process %d of the trace\n", pid);
+            free(proc);
+            free_pcb(pcb);
+            return NULL;
+        }
+        proc->pid = pid;
+        proc->pcb = pcb;
+        HASH_ADD(hh, processes, pid, sizeof(int32_t), proc);
+    }
+    last_process = proc;
+    return proc->pcb;
+}
+
+static void end_process(int32_t pid, frame_table_t *frame_table, swap_hash_t *swap) {
+    trace_process_t *proc = NULL;
+    HASH_FIND(hh, processes, &pid, sizeof(int32_t), proc);
+    if (!proc) return;
+    release_process_memory(frame_table, swap, proc->pcb);
+    free_pcb(proc->pcb);
+    HASH_DEL(processes, proc);
+    if (last_process == proc) last_process = NULL;
+    free(proc);
+}
+
+/**
+ * A process of the trace forks: the child gets its address space, copy-on-write
+ * @return 0 on success, -1 if the child exists already or the fork failed
+ */
+static int fork_process(int32_t pid, int32_t child_pid, frame_table_t *frame_table, swap_hash_t *swap) {
+    trace_process_t *proc = NULL;
+    HASH_FIND(hh, processes, &child_pid, sizeof(int32_t), proc);
+    if (proc || child_pid == pid) {
+        printf("Process %d cannot fork into process %d, which exists already\n", pid, child_pid);
+        return -1;
+    }
+    pcb_t *parent = find_process(pid);
+    pcb_t *child = parent ? find_process(child_pid) : NULL;
+    if (!child) return -1;
+    return fork_process_memory(frame_table, swap, parent, child);
+}
+
+static const char *skip_blanks(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == ',' || *p == '\r')) p++;
+    return p;
+}
+
+static const char *parse_number(const char *p, const char *end, int64_t max, int64_t *out) {
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+    const char *start = p;
+    int64_t value = 0;
+    while (p < end && *p >= '0' && *p <= '9' && value <= max) value = value * 10 + (*p++ - '0');
+    if (p == start || value > max) return NULL;
+    *out = negative ? -value : value;
+    return p;
+}
+
+/**
+ * Replay a page reference trace
+ * @param path the trace file
+ * @param frame_table the frame table
+ * @param swap the swap
+ * @param tlb the TLB the references go through (switched whenever the pid changes)
+ * @param kswapd the background reclaim, NULL for none
+ * @param min_pages_threshold free frames to keep, as in the simulation
+ * @return 0 on success, -1 if the trace could not be read or has a malformed line
+ */
+int trace_run(const char *path, frame_table_t *frame_table, swap_hash_t *swap, tlb_t *tlb, kswapd_t *kswapd,
+              int min_pages_threshold) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("open trace");
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("fstat trace");
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    const char *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("mmap trace");
+        return -1;
+    }
+    madvise((void *) data, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+    const char *p = data, *end = data + st.st_size;
+    unsigned long line = 0;
+    unsigned long not_served = 0;
+    uint32_t time = 0;          // There is no clock, references are numbered instead
+    int ret = 0;
+    while (p < end) {
+        line++;
+        const char *eol = memchr(p, '\n', (size_t) (end - p));
+        if (!eol) eol = end;
+        const char *q = skip_blanks(p, eol);
+        p = eol + 1;
+        if (q == eol || *q == '#') continue;
+
+        int64_t pid, vfn;
+        char op = 'r';
+        q = parse_number(q, eol, INT32_MAX, &pid);
+        if (q) q = parse_number(skip_blanks(q, eol), eol, UINT32_MAX, &vfn);
+        if (q) {
+            q = skip_blanks(q, eol);
+            if (q < eol) op = *q++;
+            q = skip_blanks(q, eol);
+        }
+        if (!q || q != eol || (op != 'r' && op != 'R' && op != 'w' && op != 'W' && op != 'x' && op != 'X' &&
+                                    op != 'f' && op != 'F')) {
+            printf("%s:%lu: invalid reference (expected <pid> <vfn> [r|w|x] or <pid> <child> f)\n", path, line);
+            ret = -1;
+            break;
+        }
+
+        if (op == 'x' || op == 'X') {
+            end_process((int32_t) pid, frame_table, swap);
+            continue;
+        }
+        if (op == 'f' || op == 'F') {
+            if (vfn <= 0 || vfn > INT32_MAX || fork_process((int32_t) pid, (int32_t) vfn, frame_table, swap) < 0) {
+                printf("%s:%lu: cannot fork process %lld into %lld\n", path, line, (long long) pid, (long long) vfn);
+                ret = -1;
+                break;
+            }
+            continue;
+        }
+        pcb_t *pcb = find_process((int32_t) pid);
+        if (!pcb) {
+            ret = -1;
+            break;
+        }
+        int is_write = (op == 'w' || op == 'W' || vfn < 0);
+        if (vfn < 0) vfn = -vfn;
+        if (vfn == 0) {
+            printf("%s:%lu: page 0 does not exist, pages are numbered from 1\n", path, line);
+            ret = -1;
+            break;
+        }
+        kswapd_run(kswapd, time, frame_table, swap);
+        page_eviction(time, frame_table, swap, min_pages_threshold);
+        tlb_switch(tlb, pcb->pid);
+        if (!tlb_access(tlb, time++, pcb, frame_table, swap, (uint32_t) vfn, is_write)) not_served++;
+    }
+    munmap((void *) data, (size_t) st.st_size);
+    if (not_served > 0) printf("%s: %lu references could not be served\n", path, not_served);
+    return ret;
+}
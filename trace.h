@@ -0,0 +1,24 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * Trace driven mode (--trace): page references are read from a file and fed straight
+ * to page_eviction() and page_request(), without clients, sockets or a clock.
+ *
+ * One reference per line: "<pid> <vfn> [r|w|x]", separated by spaces, tabs or commas.
+ * A negative vfn is a write as well, like in the burst files. 'x' terminates the
+ * process (the vfn is ignored) and releases its memory. "<pid> <child> f" forks the
+ * process: the new process <child> gets its address space, copy-on-write (see
+ * fork_process_memory()). Lines starting with '#' and empty lines are skipped.
+ *
+ * Every reference takes 1 ms of simulated time, which is the clock kswapd runs on.
+ */
+
+#include "virtmem.h"
+#include "tlb.h"
+#include "kswapd.h"
+
+int trace_run(const char *path, frame_table_t *frame_table, swap_hash_t *swap, tlb_t *tlb, kswapd_t *kswapd,
+              int min_pages_threshold);
+
+#endif //TRACE_H
@@ -5,10 +5,17 @@
 #include "virtmem_types.h"
 #include "virtmem.h"
 #include "ossim.h"
+#include "vm_opt.h"
+#include "swap_map.h"
+#include "vm_load.h"
+#include "readahead.h"
+#include "vm_shared.h"
+#include "debug.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 // --pages 40 --frames 2 --threshold 1
 
@@ -22,24 +29,71 @@ vm_policy_t current_policy = VM_NRU;
 // --pages 20 --frames 10 --threshold 1
 
 
+
+extern const vm_policy_ops_t vm_random;
+extern const vm_policy_ops_t vm_fifo;
+extern const vm_policy_ops_t vm_nru;
+extern const vm_policy_ops_t vm_lru;
+extern const vm_policy_ops_t vm_clock;
+extern const vm_policy_ops_t vm_arc;
+extern const vm_policy_ops_t vm_2q;
+extern const vm_policy_ops_t vm_lirs;
+extern const vm_policy_ops_t vm_clockpro;
+extern const vm_policy_ops_t vm_mglru;
+
+// Indexed by vm_policy_t
+static const vm_policy_ops_t *const vm_policies[] = {
+    &vm_random,
+    &vm_fifo,
+    &vm_nru,
+    &vm_lru,
+    &vm_clock,
+    &vm_arc,
+    &vm_2q,
+    &vm_lirs,
+    &vm_clockpro,
+    &vm_mglru,
+};
+
+#define NUM_VM_POLICIES (sizeof(vm_policies) / sizeof(vm_policies[0]))
+
 const char *policy_to_string(vm_policy_t policy) {
-    switch (policy) {
-        case VM_FIFO: return "FIFO";
-        case VM_LRU:  return "LRU";
-        case VM_RANDOM: return "RANDOM";
-        case VM_NRU:  return "NRU";
-        case VM_CLOCK: return "CLOCK";
-        default:      return "DESCONHECIDO";
+    if ((size_t) policy >= NUM_VM_POLICIES) return "DESCONHECIDO";
+    return vm_policies[policy]->name;
+}
+
+/**
+ * Select the page replacement policy by name. Must be called before create_frame_table()
+ * @param name name of the policy (lru, arc, ...)
+ * @return 0 on success, -1 if there is no such policy
+ */
+int set_vm_policy(const char *name) {
+    for (size_t i = 0; i < NUM_VM_POLICIES; i++) {
+        if (strcmp(vm_policies[i]->name, name) == 0) {
+            current_policy = vm_policies[i]->id;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Print the available page replacement policies
+ * @param out the stream to print to
+ */
+void list_vm_policies(FILE *out) {
+    for (size_t i = 0; i < NUM_VM_POLICIES; i++) {
+        fprintf(out, "  %-9s %s\n", vm_policies[i]->name, vm_policies[i]->description);
     }
 }
-static int clock_pointer = 0;
 
 /**
  * This function creates and initializes the frame table
  * @param num_frames the number of frames in the frame table
+ * @param min_pages_threshold free frames page_eviction() keeps, which limits how many pages can be resident
  * @return pointer to the created frame table, or NULL on failure
  */
-frame_table_t *create_frame_table(int num_frames) {
+frame_table_t *create_frame_table(int num_frames, int min_pages_threshold) {
     if (num_frames <= 0) {
         printf("create_frame_table: invalid num_frames=%d\n", num_frames);
         return NULL;
@@ -59,6 +113,8 @@ frame_table_t *create_frame_table(int num_frames) {
     }
 
     ft->no_frames = num_frames;
+    ft->min_free = min_pages_threshold;
+    ft->capacity = num_frames - min_pages_threshold > 1 ? num_frames - min_pages_threshold : 1;
 
     if (init_free_stack(&ft->free_stack, num_frames) < 0) {
         free(ft->frames);
@@ -66,8 +122,10 @@ frame_table_t *create_frame_table(int num_frames) {
         return NULL;
     }
 
-    if (init_fifo_eviction(&ft->eviction_order, num_frames) < 0) {
-        printf("Cannot allocate memory for FIFO eviction order\n");
+    ft->policy = vm_policies[current_policy];
+    if (ft->policy->init(ft) < 0) {
+        printf("Cannot allocate memory for the %s eviction index\n", policy_to_string(current_policy));
+        free(ft->free_stack.ids);
         free(ft->frames);
         free(ft);
         return NULL;
@@ -75,30 +133,424 @@ frame_table_t *create_frame_table(int num_frames) {
     return ft;
 }
 
+// Memória ocupada pelas page tables de todos os processos, e o máximo que chegou a ocupar
+static size_t page_table_bytes = 0;
+static size_t page_table_bytes_max = 0;
+
+static void page_table_account(long bytes) {
+    page_table_bytes += bytes;
+    if (page_table_bytes > page_table_bytes_max) page_table_bytes_max = page_table_bytes;
+}
+
+/**
+ * Allocate a level of a page table: a leaf with PT_FANOUT unmapped PTEs, or an empty directory
+ * @param level 1 for a leaf, higher for a directory
+ * @return the new node, or NULL if out of memory
+ */
+static void *new_page_table_node(int level) {
+    if (level > 1) {
+        pt_dir_t *dir = calloc(1, sizeof(pt_dir_t));
+        if (dir) page_table_account(sizeof(pt_dir_t));
+        return dir;
+    }
+    pt_leaf_t *leaf = malloc(sizeof(pt_leaf_t));
+    if (!leaf) return NULL;
+    for (uint32_t i = 0; i < PT_FANOUT; ++i) {
+        leaf->ptes[i].frame_id = INVALID_FRAME;
+        leaf->ptes[i].present = 0;
+        leaf->ptes[i].referenced = 0;
+        leaf->ptes[i].dirty = 0;
+        leaf->ptes[i].swap_cached = 0;
+        leaf->ptes[i].swap_clean = 0;
+        leaf->ptes[i].prefetched = 0;
+        leaf->ptes[i].ra_marker = 0;
+        leaf->ptes[i].shared = 0;
+        leaf->ptes[i].cow = 0;
+        leaf->ptes[i].last_accessed = 0;
+    }
+    page_table_account(sizeof(pt_leaf_t));
+    return leaf;
+}
+
+/**
+ * Free a level of a page table and everything below it
+ * @param node the node
+ * @param level 1 for a leaf, higher for a directory
+ */
+static void free_page_table_node(void *node, int level) {
+    if (level > 1) {
+        pt_dir_t *dir = node;
+        for (uint32_t i = 0; i < PT_FANOUT; ++i) {
+            if (dir->slots[i]) free_page_table_node(dir->slots[i], level - 1);
+        }
+        page_table_account(-(long) sizeof(pt_dir_t));
+    } else {
+        page_table_account(-(long) sizeof(pt_leaf_t));
+    }
+    free(node);
+}
+
+/**
+ * Number of levels a page table needs to reach a virtual page
+ * @param vfn the virtual frame number
+ * @return 1 to PT_LEVELS
+ */
+static int page_table_height(uint32_t vfn) {
+    int height = 1;
+    while (height < PT_LEVELS && (vfn >> (PT_BITS * height)) != 0) height++;
+    return height;
+}
+
 /**
- * This function initializes the page table
+ * This function initializes the page table. It starts empty, levels are allocated
+ * when the first page below them is mapped (see map_page())
  * @param pt the page table to initialize
- * @param max_size maximum number of pages in the page table
  * @return 0 on success, -1 on failure
  */
-int create_page_table(page_table_t *pt, int max_size) {
-    if (pt == NULL || max_size <= 0) {
+int create_page_table(page_table_t *pt) {
+    if (pt == NULL) {
         printf("Invalid page table\n");
         return -1;
     }
-    pt->vp = (pte_t *) malloc((size_t) max_size * sizeof(pte_t));
-    if (pt->vp == NULL) {
-        printf("Cannot allocate memory for page table\n");
+    pt->root = NULL;
+    pt->height = 0;
+    return 0;
+}
+
+/**
+ * Empty a page table that is being reused for a new process, freeing all its levels
+ * @param pt the page table to clear
+ */
+void clear_page_table(page_table_t *pt) {
+    if (pt == NULL || pt->root == NULL) return;
+    free_page_table_node(pt->root, pt->height);
+    pt->root = NULL;
+    pt->height = 0;
+}
+
+/**
+ * Largest amount of memory all page tables used together during the run
+ * @return the size in bytes
+ */
+size_t page_table_peak_bytes(void) {
+    return page_table_bytes_max;
+}
+
+/**
+ * Drop the copy of a page from swap, its slot becomes free again
+ * @param swap the swap hash
+ * @param page_key the page, (pid<<32)|vfn
+ */
+static void swap_forget(swap_hash_t *swap, uint64_t page_key) {
+    swapped_frame_t swapped_page;
+    if (swap_map_take(&swap->pages, page_key, &swapped_page)) {
+        swap_slot_free(&swap->space, swapped_page.slot);
+        swap->num_swapped -= 1;
+    }
+}
+
+/**
+ * Give a page its own entry in swap for the copy another page has in a slot (a fork):
+ * nothing is written, the slot gets one more reference
+ * @param swap the swap hash
+ * @param copy the entry of the page whose copy is shared (by value, the swap map moves its entries)
+ * @param pid the process of the page that gets the entry
+ * @param vfn the page
+ * @return 0 on success, -1 on failure
+ */
+static int swap_share(swap_hash_t *swap, swapped_frame_t copy, int32_t pid, uint32_t vfn) {
+    uint64_t page_key = (((uint64_t) pid) << 32) | (uint64_t) vfn;
+    swap_forget(swap, page_key);
+    if (swap_slot_dup(&swap->space, copy.slot) < 0) return -1;
+    swapped_frame_t *swapped_page = swap_map_insert(&swap->pages, page_key);
+    if (!swapped_page) {
+        swap_slot_free(&swap->space, copy.slot);
         return -1;
     }
-    pt->nvalid = max_size - 1;
-    for (int i = 0; i < max_size; ++i) {
-        pt->vp[i].frame_id = INVALID_FRAME;
-        pt->vp[i].present = 0;
-        pt->vp[i].referenced = 0;
-        pt->vp[i].dirty = 0;
-        pt->vp[i].last_accessed = 0;
+    swapped_page->slot = copy.slot;
+    swapped_page->writer_pid = copy.writer_pid;
+    swapped_page->dirty = copy.dirty;
+    swapped_page->last_accessed = copy.last_accessed;
+    swap->num_swapped += 1;
+    return 0;
+}
+
+/**
+ * Add a page table entry to the reverse map of a frame: one more process maps its page
+ * @param fd the frame
+ * @param pte the page table entry, which the caller points to the frame
+ * @param owner the process of the page table entry
+ * @param pid its pid
+ * @param vfn the page the entry is for
+ * @return 0 on success, -1 if out of memory
+ */
+int rmap_add(frame_desc_t *fd, pte_t *pte, pcb_t *owner, int32_t pid, uint32_t vfn) {
+    rmap_t *entry = malloc(sizeof(rmap_t));
+    if (!entry) {
+        printf("Cannot allocate memory for the reverse map\n");
+        return -1;
     }
+    entry->pte = pte;
+    entry->owner = owner;
+    entry->pid = pid;
+    entry->vfn = vfn;
+    entry->next = fd->rmap;
+    fd->rmap = entry;
+    if (pte->shared) vm_shared_mapped(1);
+    return 0;
+}
+
+/**
+ * Take a page table entry out of the reverse map of a frame, e.g. its process terminated
+ * @param fd the frame
+ * @param pte the page table entry
+ */
+void rmap_remove(frame_desc_t *fd, pte_t *pte) {
+    for (rmap_t **link = &fd->rmap; *link; link = &(*link)->next) {
+        if ((*link)->pte == pte) {
+            rmap_t *entry = *link;
+            *link = entry->next;
+            if (pte->shared) vm_shared_mapped(-1);
+            free(entry);
+            // The last process that maps a copy-on-write page may write to it in place
+            if (fd->rmap == NULL && fd->vp) fd->vp->cow = 0;
+            return;
+        }
+    }
+}
+
+/**
+ * Unmap the page of a frame, which is being evicted, from every page table entry in its
+ * reverse map. A page of a shared region stays reachable through the region (fd->vp).
+ * A copy-on-write page of a forked process shares the copy fd->vp got in swap.
+ * @param swap the swap hash, which already has the copy of fd->vp (unless swap_out failed)
+ * @param fd the frame
+ */
+static void rmap_unmap_all(swap_hash_t *swap, frame_desc_t *fd) {
+    const swapped_frame_t *found = swap_map_find(&swap->pages, (((uint64_t) fd->pid) << 32) | (uint64_t) fd->vfn);
+    swapped_frame_t copy = found ? *found : (swapped_frame_t) {0};
+    while (fd->rmap) {
+        rmap_t *entry = fd->rmap;
+        pte_t *pte = entry->pte;
+        pte->present = 0;
+        if (pte->shared) {
+            pte->frame_id = INVALID_FRAME;
+            vm_shared_mapped(-1);
+            vm_shared_stats.unmaps++;
+        } else if (found && swap_share(swap, copy, entry->pid, entry->vfn) == 0) {
+            // Its own entry in swap, with the same copy: a current one, like after swap_out()
+            pte->cow = 0;
+            pte->dirty = copy.dirty;
+            pte->swap_cached = 1;
+            pte->swap_clean = 1;
+        } else {
+            printf("Page %u of process %d has no copy in swap, it is lost\n", entry->vfn, entry->pid);
+            pte->frame_id = INVALID_FRAME;
+        }
+        fd->rmap = entry->next;
+        free(entry);
+    }
+}
+
+/**
+ * The page table entry that owns a frame lets go of it (its process copies the page on a
+ * write, or terminates) while forked processes still map it: the first of them takes the
+ * frame over, with the state of the page. The policies know a frame by its page, so for
+ * them the old page leaves the frame and the new one comes in.
+ * @param frame_table the frame table
+ * @param frame_id the frame, with a reverse map
+ */
+static void rmap_promote(frame_table_t *frame_table, int32_t frame_id) {
+    frame_desc_t *fd = &frame_table->frames[frame_id];
+    rmap_t *entry = fd->rmap;
+    pte_t *old = fd->vp;
+    pte_t *vp = entry->pte;
+    if (old->prefetched || old->ra_marker) readahead_wasted(NULL, old);
+    frame_table->policy->on_unload(frame_table, frame_id, 0);
+    vp->referenced = old->referenced;
+    vp->dirty = old->dirty;
+    vp->last_accessed = old->last_accessed;
+    vp->swap_cached = 0;        // Its page has no copy in swap yet
+    vp->swap_clean = 0;
+    if (fd->owner) fd->owner->rss--;
+    fd->vp = vp;
+    fd->pid = entry->pid;
+    fd->vfn = entry->vfn;
+    fd->owner = entry->owner;
+    if (fd->owner) fd->owner->rss++;
+    fd->rmap = entry->next;
+    free(entry);
+    if (fd->rmap == NULL) vp->cow = 0;
+    frame_table->policy->on_load(frame_table, frame_id);
+    fd->gen++;
+}
+
+/**
+ * Give back the frames and swap of the pages in one level of a page table
+ * @param frame_table the frame table
+ * @param swap the swap
+ * @param pid the process the page table belongs to
+ * @param node the node
+ * @param level 1 for a leaf, higher for a directory
+ * @param base the first virtual frame number below this node
+ */
+static void release_page_table_node(frame_table_t *frame_table, swap_hash_t *swap, int32_t pid, void *node,
+                                    int level, uint32_t base) {
+    if (level > 1) {
+        pt_dir_t *dir = node;
+        int shift = PT_BITS * (level - 1);
+        for (uint32_t i = 0; i < PT_FANOUT; ++i) {
+            if (dir->slots[i]) release_page_table_node(frame_table, swap, pid, dir->slots[i], level - 1,
+                                                       base | (i << shift));
+        }
+        return;
+    }
+    pt_leaf_t *leaf = node;
+    for (uint32_t i = 0; i < PT_FANOUT; ++i) {
+        pte_t *vp = &leaf->ptes[i];
+        if (!is_valid(vp)) continue;
+        if (vp->shared) {
+            // A page of a shared region: only the mapping goes, the page stays with the region
+            if (is_active(vp)) {
+                frame_desc_t *fd = &frame_table->frames[vp->frame_id];
+                rmap_remove(fd, vp);
+                fd->gen++;      // Its TLB entries must not serve a process that reuses the pid
+            }
+            continue;
+        }
+        if (is_active(vp)) {
+            frame_desc_t *fd = &frame_table->frames[vp->frame_id];
+            if (fd->vp == vp && fd->rmap) {
+                // Forked processes still map the page, one of them takes the frame
+                rmap_promote(frame_table, vp->frame_id);
+            } else if (fd->vp != vp) {
+                rmap_remove(fd, vp);
+                fd->gen++;      // Its TLB entries must not serve a process that reuses the pid
+            } else {
+                frame_table->policy->on_unload(frame_table, vp->frame_id, 0);
+                if (vp->prefetched || vp->ra_marker) readahead_wasted(NULL, vp);
+                fd->owner = NULL;
+                fd->vp = NULL;
+                fd->gen++;
+                push_free_frame(&frame_table->free_stack, vp->frame_id);
+            }
+            if (vp->swap_cached) swap_forget(swap, (((uint64_t) pid) << 32) | (uint64_t) (base | i));
+        } else {
+            uint64_t page_key = (((uint64_t) pid) << 32) | (uint64_t) (base | i);
+            frame_table->policy->on_forget(frame_table, page_key);
+            swap_forget(swap, page_key);
+        }
+    }
+}
+
+/**
+ * Release all memory of a process that terminated: its frames go back to the free
+ * stack and its pages are dropped from swap, so no frame keeps pointing into a page
+ * table that is about to be reused
+ * @param frame_table the frame table
+ * @param swap the swap
+ * @param pcb the terminated process
+ */
+void release_process_memory(frame_table_t *frame_table, swap_hash_t *swap, pcb_t *pcb) {
+    page_table_t *pt = &pcb->page_table;
+    if (vm_opt_enabled) vm_opt_process_exit(pcb->pid);
+    if (pt->root) release_page_table_node(frame_table, swap, pcb->pid, pt->root, pt->height, 0);
+    clear_page_table(pt);
+    vm_shared_detach(pcb);
+    pcb->rss = 0;
+    vm_load_exit(pcb);
+}
+
+/**
+ * Copy a level of the page table of a process into the table of its fork. Pages in memory
+ * are not copied: the child maps the same frame (reverse map) and both become
+ * copy-on-write. Pages in swap share the slot of the parent.
+ * @param frame_table the frame table
+ * @param swap the swap
+ * @param parent the process that forks
+ * @param child the new process
+ * @param node a node of the table of the parent
+ * @param level its level, 1 for a leaf
+ * @param base the first page under the node
+ * @return the number of pages shared, or -1 on failure
+ */
+static long fork_page_table_node(frame_table_t *frame_table, swap_hash_t *swap, pcb_t *parent, pcb_t *child,
+                                 void *node, int level, uint32_t base) {
+    long shared = 0;
+    if (level > 1) {
+        pt_dir_t *dir = node;
+        uint32_t shift = PT_BITS * (level - 1);
+        for (uint32_t i = 0; i < PT_FANOUT; ++i) {
+            if (!dir->slots[i]) continue;
+            long n = fork_page_table_node(frame_table, swap, parent, child, dir->slots[i], level - 1,
+                                          base | (i << shift));
+            if (n < 0) return -1;
+            shared += n;
+        }
+        return shared;
+    }
+    pt_leaf_t *leaf = node;
+    for (uint32_t i = 0; i < PT_FANOUT; ++i) {
+        pte_t *vp = &leaf->ptes[i];
+        uint32_t vfn = base | i;
+        if (!is_valid(vp) || vp->shared) continue;      // Shared regions are mapped again on the first access
+        pte_t *cp = map_page(&child->page_table, vfn);
+        if (cp == NULL) {
+            printf("Cannot map page %u of process %d\n", vfn, child->pid);
+            return -1;
+        }
+        if (is_active(vp)) {
+            frame_desc_t *fd = &frame_table->frames[vp->frame_id];
+            if (rmap_add(fd, cp, child, child->pid, vfn) < 0) return -1;
+            cp->frame_id = vp->frame_id;
+            cp->present = 1;
+            cp->dirty = vp->dirty;
+            cp->last_accessed = vp->last_accessed;
+            cp->cow = 1;
+            // Every process that maps the frame copies it on a write, whoever holds it
+            fd->vp->cow = 1;
+            for (rmap_t *entry = fd->rmap; entry; entry = entry->next) entry->pte->cow = 1;
+        } else {
+            const swapped_frame_t *found = swap_map_find(&swap->pages, (((uint64_t) parent->pid) << 32) | vfn);
+            if (!found) continue;
+            swapped_frame_t copy = *found;
+            if (swap_share(swap, copy, child->pid, vfn) < 0) {
+                printf("Cannot share page %u of process %d in swap\n", vfn, parent->pid);
+                return -1;
+            }
+            cp->frame_id = vp->frame_id;    // Any valid frame: the page is in swap
+            cp->dirty = copy.dirty;
+            cp->last_accessed = copy.last_accessed;
+            cp->swap_cached = 1;
+            cp->swap_clean = 1;
+        }
+        shared++;
+    }
+    return shared;
+}
+
+/**
+ * Fork a process: the new process gets the address space of its parent, copy-on-write
+ * (a FORK request). Frames and swap slots are shared until one of them writes to a page.
+ * @param frame_table the frame table
+ * @param swap the swap
+ * @param parent the process that forks
+ * @param child the new process, with no memory yet
+ * @return 0 on success, -1 on failure
+ */
+int fork_process_memory(frame_table_t *frame_table, swap_hash_t *swap, pcb_t *parent, pcb_t *child) {
+    for (shared_map_t *m = parent->shared_maps; m; m = m->next) {
+        if (vm_shared_attach(child, m->region->key, m->first_vfn, m->pages) < 0) return -1;
+    }
+    long shared = 0;
+    if (parent->page_table.root) {
+        shared = fork_page_table_node(frame_table, swap, parent, child, parent->page_table.root,
+                                      parent->page_table.height, 0);
+        if (shared < 0) return -1;
+    }
+    total_forks++;
+    total_cow_shared += shared;
+    DBG("Process %d forked into %d, %ld pages shared", parent->pid, child->pid, shared);
     return 0;
 }
 
@@ -128,13 +580,62 @@ int is_valid(pte_t *page) {
  *  Find the page table entry for the given virtual frame number
  * @param pt  the page table
  * @param vfn  the virtual frame number
- * @return  pointer to the page table entry, or NULL if not found
+ * @return  pointer to the page table entry, or NULL if the page was never mapped
  */
-pte_t *find_page(page_table_t *pt, int32_t vfn) {
-    if (pt == NULL || vfn < 1 || vfn >= pt->nvalid) {
+pte_t *find_page(page_table_t *pt, uint32_t vfn) {
+    if (pt == NULL || pt->root == NULL || vfn == 0) {
+        return NULL;
+    }
+    if (pt->height < PT_LEVELS && (vfn >> (PT_BITS * pt->height)) != 0) {
         return NULL;
     }
-    return &pt->vp[vfn - 1];
+    void *node = pt->root;
+    for (int level = pt->height; level > 1; --level) {
+        node = ((pt_dir_t *) node)->slots[(vfn >> (PT_BITS * (level - 1))) & PT_MASK];
+        if (node == NULL) return NULL;
+    }
+    return &((pt_leaf_t *) node)->ptes[vfn & PT_MASK];
+}
+
+/**
+ * Find the page table entry for the given virtual frame number, allocating the levels
+ * that lead to it (and making the tree taller) if they do not exist yet
+ * @param pt the page table
+ * @param vfn the virtual frame number, 1 or more (0 cannot be written as a negative number)
+ * @return pointer to the page table entry, or NULL if out of memory or vfn is 0
+ */
+pte_t *map_page(page_table_t *pt, uint32_t vfn) {
+    if (pt == NULL || vfn == 0) {
+        return NULL;
+    }
+    int height = page_table_height(vfn);
+    if (pt->root == NULL) {
+        pt->height = height;
+    }
+    // The current tree becomes the first slot of a new root, its pages keep their address
+    while (pt->height < height) {
+        pt_dir_t *dir = new_page_table_node(pt->height + 1);
+        if (dir == NULL) {
+            printf("Cannot allocate memory for page table\n");
+            return NULL;
+        }
+        dir->slots[0] = pt->root;
+        pt->root = dir;
+        pt->height++;
+    }
+    void **slot = &pt->root;
+    for (int level = pt->height; ; --level) {
+        if (*slot == NULL) {
+            *slot = new_page_table_node(level);
+            if (*slot == NULL) {
+                printf("Cannot allocate memory for page table\n");
+                return NULL;
+            }
+        }
+        if (level == 1) break;
+        slot = &((pt_dir_t *) *slot)->slots[(vfn >> (PT_BITS * (level - 1))) & PT_MASK];
+    }
+    return &((pt_leaf_t *) *slot)->ptes[vfn & PT_MASK];
 }
 
 /**
@@ -178,83 +679,72 @@ int pop_free_frame(free_stack_t *stack) {
 }
 
 /**
- * Initialize the FIFO eviction structure
- * @param fifo the FIFO structure to initialize
- * @param num_frames the number of frames to allocate space for
- * @return 0 on success, -1 on failure
- */
-int init_fifo_eviction(fifo_t *fifo, int num_frames) {
-    if (fifo == NULL || num_frames <= 0) {
-        return -1;
-    }
-    fifo->ids = (uint32_t *) malloc((size_t) num_frames * sizeof(uint32_t));
-    if (fifo->ids == NULL) {
-        printf("Cannot allocate memory for FIFO eviction\n");
-        return -1;
-    }
-    fifo->top = -1;
-    fifo->max_size = num_frames;
-    return 0;
-}
-
-/**
- * Push a frame ID onto the FIFO eviction structure
- * @param fifo the FIFO structure
- * @param frame_id the frame ID to push
- * @return 1 on success, 0 on failure
- */
-int push_fifo_eviction(fifo_t *fifo, int frame_id) {
-    if (fifo == NULL || frame_id < 0 || fifo->top >= (fifo->max_size - 1)) {
-        return 0;
-    }
-    fifo->ids[++(fifo->top)] = (uint32_t) frame_id;
-    return 1;
-}
-
-/**
- * Pop a frame ID from the FIFO eviction structure
- * @param fifo the FIFO structure
- * @return the popped frame ID, or INVALID_FRAME if the structure is empty
- */
-
-int32_t pop_fifo_eviction(fifo_t *fifo) {
-    if (fifo == NULL || fifo->top < 0) return INVALID_FRAME;
-    int32_t frame_id = fifo->ids[0];
-
-    for (int i = 1; i <= fifo->top; ++i) {
-        fifo->ids[i - 1] = fifo->ids[i];
-    }
-
-    fifo->top--;
-    return frame_id;
-}
-
-
-/**
- * Swap out a page to the swap hash
+ * Swap out a page. A page whose copy in swap is still current (swap cache) is dropped
+ * without a write; one that was written to since is written over its old copy, unless a
+ * forked process shares that copy; any other page is written to a free slot of the swap
+ * space, which is remembered in the swap hash
  * @param swap the swap hash
  * @param fd the frame descriptor of the page to swap out
- * @return 0 on success, -1 on failure
+ * @return 0 if the page was written, 1 if the write was avoided, -1 on failure
  */
 int swap_out(swap_hash_t *swap, frame_desc_t *fd) {
     pte_t *vp = fd->vp;
     uint64_t page_key = (((uint64_t) fd->pid) << 32) | ((uint64_t) fd->vfn);
-    swapped_frame_t *swapped_page = (swapped_frame_t *) malloc(sizeof(swapped_frame_t));
+    swapped_frame_t *swapped_page = vp->swap_cached ? swap_map_find(&swap->pages, page_key) : NULL;
+    if (swapped_page) {
+        swapped_page->dirty = vp->dirty;
+        swapped_page->last_accessed = vp->last_accessed;
+        if (vp->swap_clean) {
+            total_swap_writes_avoided++;
+            return 1;
+        }
+        if (swap_slot_shared(&swap->space, swapped_page->slot)) {
+            // A forked process still reads the old copy: write to a slot of its own
+            uint32_t slot = swap_slot_alloc(&swap->space);
+            if (slot == SWAP_NO_SLOT) {
+                printf("Swap is full\n");
+                return -1;
+            }
+            swap_slot_free(&swap->space, swapped_page->slot);
+            swapped_page->slot = slot;
+            // The copy copy-on-write put off, made here since the write never faulted in RAM
+            total_cow_copies++;
+        }
+        if (swap_slot_write(&swap->space, swapped_page->slot, page_key) < 0) return -1;
+        swapped_page->writer_pid = fd->pid;
+        vp->swap_clean = 1;
+        total_swaps_out++;
+        return 0;
+    }
+    uint32_t slot = swap_slot_alloc(&swap->space);
+    if (slot == SWAP_NO_SLOT) {
+        printf("Swap is full\n");
+        return -1;
+    }
+    if (swap_slot_write(&swap->space, slot, page_key) < 0) {
+        swap_slot_free(&swap->space, slot);
+        return -1;
+    }
+    swapped_page = swap_map_insert(&swap->pages, page_key);
     if (!swapped_page) {
-        printf("Cannot allocate memory for swapped frame\n");
+        swap_slot_free(&swap->space, slot);
         return -1;
     }
-    swapped_page->page_id = page_key;
+    swapped_page->slot = slot;
+    swapped_page->writer_pid = fd->pid;
     swapped_page->dirty = vp->dirty;
     swapped_page->last_accessed = vp->last_accessed;
-    HASH_ADD(hh, swap->pages, page_id, sizeof(uint64_t), swapped_page);
+    vp->swap_cached = 1;
+    vp->swap_clean = 1;
     swap->num_swapped += 1;
     total_swaps_out++;
     return 0;
 }
 
 /**
- * Swap in a page from the swap hash
+ * Swap in a page: read it back from its slot. The slot keeps the copy (swap cache) until
+ * the page is written to or freed; only when more than half of the swap is in use is the
+ * slot freed right away, as before
  * @param swap the swap hash
  * @param fd the frame descriptor of the page to swap in
  * @return 0 on success, -1 on failure
@@ -262,118 +752,379 @@ int swap_out(swap_hash_t *swap, frame_desc_t *fd) {
 int swap_in(swap_hash_t *swap, frame_desc_t *fd) {
     pte_t *vp = fd->vp;
     uint64_t page_key = (((uint64_t) fd->pid) << 32) | ((uint64_t) fd->vfn);
-    swapped_frame_t *swapped_page = NULL;
-    HASH_FIND(hh, swap->pages, &page_key, sizeof(uint64_t), swapped_page);
+    swapped_frame_t *swapped_page = swap_map_find(&swap->pages, page_key);
     if (!swapped_page) {
         printf("Page not found in swap\n");
+        vp->swap_cached = 0;
+        vp->swap_clean = 0;
         return -1;
     }
+    // After a fork, the copy may be the one the parent wrote
+    uint64_t written_key = (((uint64_t) swapped_page->writer_pid) << 32) | ((uint64_t) fd->vfn);
+    if (swap_slot_read(&swap->space, swapped_page->slot, written_key) < 0) {
+        printf("Cannot read page %u of process %d from swap\nTrying to continue\n", fd->vfn, fd->pid);
+    }
     // Restore page properties
     vp->dirty = swapped_page->dirty;
     vp->last_accessed = swapped_page->last_accessed;
-    // Remove from swap
-    HASH_DEL(swap->pages, swapped_page);
-    free(swapped_page);
-    swap->num_swapped -= 1;
+    if ((uint64_t) swap->space.used * 2 > swap->space.nslots) {
+        swap_forget(swap, page_key);
+        vp->swap_cached = 0;
+        vp->swap_clean = 0;
+    }
     total_swaps_in++;
     return 0;
 }
 
 /**
- * This function handles a page request for a given process
- * @param pcb Process Control Block of the requesting process
- * @param frame_table The frame table
- * @param swap The swap
- * @param vfn The virtual frame number requested
- * @return Pointer to the page table entry of the requested page, or NULL on failure
+ * Account an access to a page that is in memory (found in the page table or the TLB)
+ * @param current_time_ms the current simulation time
+ * @param frame_table the frame table
+ * @param swap the swap (a prefetched page can start the next readahead)
+ * @param frame_id the frame that holds the page
+ * @param is_write 1 if the page is written to, which makes it dirty
+ * @return pointer to the page table entry of the page
  */
-pte_t *page_request(uint32_t current_time_ms,pcb_t *pcb, frame_table_t *frame_table, swap_hash_t *swap, int vfn) {
+pte_t *page_hit(uint32_t current_time_ms, frame_table_t *frame_table, swap_hash_t *swap, int32_t frame_id,
+                int is_write) {
+    frame_desc_t *fd = &frame_table->frames[frame_id];
+    pte_t *vp = fd->vp;
     total_page_accesses++;
-    printf("Requesting page %d for process %d\n", vfn, pcb->pid);
-    pte_t *vp = find_page(&pcb->page_table, vfn);
+    if (fd->owner) fd->owner->vm_accesses++;
+    if (vm_opt_enabled) vm_opt_record(fd->pid, fd->vfn);
+    vp->referenced = 1;
+    vp->last_accessed = current_time_ms;
+    if (is_write) {
+        vp->dirty = 1;
+        vp->swap_clean = 0;     // The copy in swap (if any) is now out of date
+    }
+    frame_table->policy->on_access(frame_table, frame_id);
+    if (vp->prefetched || vp->ra_marker) readahead_hit(current_time_ms, fd->owner, frame_table, swap, vp);
+    return vp;
+}
 
-    if (is_active(vp)) {
-        // Page is present in RAM
-        printf("Page %d is active in RAM, just bookkeeping\n", vfn);
-        vp->referenced = 1;
+/**
+ * A page fault of a process: size its readahead window and free the frames for it now,
+ * before the page that faulted takes one (prefetch_page() only takes spare free frames)
+ * @return the number of pages to prefetch once the page is loaded
+ */
+static uint32_t readahead_reserve(uint32_t current_time_ms, pcb_t *pcb, frame_table_t *frame_table,
+                                  swap_hash_t *swap, uint32_t vfn) {
+    uint32_t pages = readahead_window(pcb, vfn);
+    // Never more than half of what can be resident, a window does not flush the memory
+    if (pages > (uint32_t) frame_table->capacity / 2) pages = (uint32_t) frame_table->capacity / 2;
+    if (pages == 0) return 0;
+    int reclaimed = reclaim_frames(current_time_ms, frame_table, swap, frame_table->min_free + (int32_t) pages + 1);
+    if (reclaimed > 0) total_readahead_reclaims += reclaimed;
+    return pages;
+}
+
+/**
+ * Bring a page of a process in before it is accessed (readahead): read it back from swap,
+ * or allocate it if it was never used. It comes in unreferenced and marked as prefetched,
+ * and the access is not counted. Only takes a frame if more than min_free are free.
+ * @param current_time_ms The current simulation time (the read is queued on the swap device)
+ * @param pcb The process
+ * @param frame_table The frame table
+ * @param swap The swap
+ * @param vfn The page, which must not be in RAM
+ * @return Pointer to the page table entry of the page, or NULL if there is no frame to spare
+ */
+pte_t *prefetch_page(uint32_t current_time_ms, pcb_t *pcb, frame_table_t *frame_table, swap_hash_t *swap,
+                     uint32_t vfn) {
+    if (frame_table->free_stack.top <= frame_table->min_free) return NULL;
+    pte_t *vp = map_page(&pcb->page_table, vfn);
+    if (vp == NULL) return NULL;
+    int32_t next_frame = pop_free_frame(&frame_table->free_stack);
+    if (next_frame == INVALID_FRAME) return NULL;
+    frame_desc_t *fd = &frame_table->frames[next_frame];
+    fd->vp = vp;
+    fd->pid = pcb->pid;
+    fd->vfn = vfn;
+    fd->owner = pcb;
+    pcb->rss++;
+    if (is_valid(vp)) {
+        // Nobody waits for this read, but it holds up the ones queued after it
+        if (swap_in(swap, fd) == 0) swap_device_submit(&swap->device, current_time_ms, SWAP_READ);
+    } else {
+        vp->dirty = 0;
         vp->last_accessed = current_time_ms;
-        return vp;
     }
+    vp->frame_id = next_frame;
+    vp->present = 1;
+    vp->referenced = 0;
+    vp->prefetched = 1;
+    frame_table->policy->on_load(frame_table, next_frame);
+    return vp;
+}
+
+/**
+ * Load a page that is not in memory into a free frame: read it back from swap, or
+ * allocate it if it was never used
+ * @param pcb The process that faulted, it waits for the read
+ * @param frame_table The frame table
+ * @param swap The swap
+ * @param vp The page table entry of the page, which the frame points to
+ * @param pid The page in the frame table and in swap: the process, or the shared region
+ * @param vfn The page in the frame table and in swap: the page in the process or region
+ * @param owner The process whose resident set the frame counts in, NULL for a shared page
+ * @param is_write 1 if the page is written to, which makes it dirty
+ * @return vp, or NULL if there is no free frame
+ */
+static pte_t *page_fault(uint32_t current_time_ms, pcb_t *pcb, frame_table_t *frame_table, swap_hash_t *swap,
+                         pte_t *vp, int32_t pid, uint32_t vfn, pcb_t *owner, int is_write) {
+    uint32_t ahead = owner ? readahead_reserve(current_time_ms, pcb, frame_table, swap, vfn) : 0;
     if (is_valid(vp)) {
-        total_page_faults++;
         // Page is swapped out
         // Assume there is a free frame, so get one
-        printf("Swap in page %d for process %d\n", vfn, pcb->pid);
+        DBG("Swap in page %u for process %d", vfn, pid);
         int32_t next_frame = pop_free_frame(&frame_table->free_stack);
+        if (next_frame == INVALID_FRAME) {
+            printf("ERROR: No free frame to swap in page %u for process %d\n", vfn, pid);
+            return NULL;
+        }
         frame_desc_t *fd = &frame_table->frames[next_frame];
+        // The frame now holds this page; swap_in looks it up by (pid, vfn)
+        fd->vp = vp;
+        fd->pid = pid;
+        fd->vfn = vfn;
+        fd->owner = owner;
+        if (owner) owner->rss++;
         if (swap_in(swap, fd) < 0) {
-            printf("ERROR: Failed to swap in page %d for process %d\nTrying to continue\n", vfn, pcb->pid);
+            printf("ERROR: Failed to swap in page %u for process %d\nTrying to continue\n", vfn, pid);
+        } else {
+            // The process has to wait for the read, the caller blocks it
+            uint32_t ready_ms = swap_device_submit(&swap->device, current_time_ms, SWAP_READ);
+            if (ready_ms > current_time_ms) pcb->swap_ready_ms = ready_ms;
         }
         vp->frame_id = next_frame;
-        push_fifo_eviction(&frame_table->eviction_order, next_frame);
+        vp->present = 1;
         vp->referenced = 1;
         vp->last_accessed = current_time_ms;
+        if (is_write) {
+            vp->dirty = 1;
+            vp->swap_clean = 0;
+        }
+        frame_table->policy->on_load(frame_table, next_frame);
+        if (ahead) readahead_fetch(current_time_ms, pcb, frame_table, swap, vfn, ahead);
         return vp;
     }
     // Page not valid, need to allocate
-    total_page_faults++;
-    printf("Allocating page %d for process %d\n", vfn, pcb->pid);
+    DBG("Allocating page %u for process %d", vfn, pid);
     int32_t next_frame = pop_free_frame(&frame_table->free_stack);
+    if (next_frame == INVALID_FRAME) {
+        printf("ERROR: No free frame to allocate page %u for process %d\n", vfn, pid);
+        return NULL;
+    }
     frame_desc_t *fd = &frame_table->frames[next_frame];
     vp->frame_id = next_frame;
     fd->vp = vp;
+    fd->pid = pid;
+    fd->vfn = vfn;
+    fd->owner = owner;
+    if (owner) owner->rss++;
+    vp->present = 1;
+    vp->referenced = 1;
+    vp->last_accessed = current_time_ms;
+    vp->dirty = is_write ? 1 : 0;
+    frame_table->policy->on_load(frame_table, next_frame);
+    if (ahead) readahead_fetch(current_time_ms, pcb, frame_table, swap, vfn, ahead);
+    return vp;
+}
+
+/**
+ * A process accesses a page of a shared region that it has not mapped: map the frame of
+ * the region page, after loading it if no other process has it in memory
+ * @param vp The page table entry of the page in the process
+ * @param map The region mapping the page belongs to
+ * @return Pointer to the page table entry of the page, or NULL on failure
+ */
+static pte_t *shared_page_request(uint32_t current_time_ms, pcb_t *pcb, frame_table_t *frame_table,
+                                  swap_hash_t *swap, pte_t *vp, const shared_map_t *map, uint32_t vfn,
+                                  int is_write) {
+    shared_region_t *region = map->region;
+    uint32_t page = vfn - map->first_vfn + 1;
+    pte_t *rp = map_page(&region->page_table, page);
+    if (rp == NULL) {
+        printf("Cannot map page %u of shared region %u\n", page, region->key);
+        return NULL;
+    }
+    pcb->vm_accesses++;
+    int minor = is_active(rp);
+    if (minor) {
+        // Another process brought it in: only the mapping is missing (minor fault)
+        DBG("Page %u of shared region %u is in frame %d, mapping it for process %d", page, region->key,
+            rp->frame_id, pcb->pid);
+        vm_shared_stats.minor_faults++;
+    } else {
+        total_page_accesses++;
+        if (vm_opt_enabled) vm_opt_record(region->id, page);
+        total_page_faults++;
+        vm_load_fault(pcb, frame_table);
+        if (page_fault(current_time_ms, pcb, frame_table, swap, rp, region->id, page, NULL, is_write) == NULL) {
+            return NULL;
+        }
+    }
+    vp->shared = 1;
+    if (rmap_add(&frame_table->frames[rp->frame_id], vp, pcb, pcb->pid, vfn) < 0) return NULL;
+    vp->frame_id = rp->frame_id;
+    vp->present = 1;
+    // A minor fault is an access to a page in memory, as far as the policy is concerned
+    return minor ? page_hit(current_time_ms, frame_table, swap, rp->frame_id, is_write) : vp;
+}
+
+/**
+ * A process writes to a copy-on-write page it shares with a forked process: it gets a
+ * copy of its own in a free frame, and the others keep the frame. The last process left
+ * on a frame writes to it in place. The copy is not a page fault, nothing is read.
+ * @param vp The page table entry of the page in the process, which is in memory
+ * @return Pointer to the page table entry of the page, or NULL if there is no free frame
+ */
+static pte_t *cow_fault(uint32_t current_time_ms, pcb_t *pcb, frame_table_t *frame_table, swap_hash_t *swap,
+                        pte_t *vp, uint32_t vfn) {
+    int32_t old_frame = vp->frame_id;
+    frame_desc_t *old = &frame_table->frames[old_frame];
+    if (old->rmap == NULL) {
+        vp->cow = 0;
+        return page_hit(current_time_ms, frame_table, swap, old_frame, 1);
+    }
+    int32_t next_frame = pop_free_frame(&frame_table->free_stack);
+    if (next_frame == INVALID_FRAME) {
+        printf("ERROR: No free frame to copy page %u for process %d\n", vfn, pcb->pid);
+        return NULL;
+    }
+    DBG("Copy on write: page %u of process %d from frame %d to %d", vfn, pcb->pid, old_frame, next_frame);
+    if (old->vp == vp) {
+        // The policy keeps the old frame for the process that takes it over
+        rmap_promote(frame_table, old_frame);
+    } else {
+        rmap_remove(old, vp);
+    }
+    old->gen++;         // No TLB may still translate the page to the old frame
+    frame_desc_t *fd = &frame_table->frames[next_frame];
+    fd->vp = vp;
     fd->pid = pcb->pid;
     fd->vfn = vfn;
-    push_fifo_eviction(&frame_table->eviction_order, next_frame);
+    fd->owner = pcb;
+    pcb->rss++;
+    pcb->vm_accesses++;
+    vp->frame_id = next_frame;
+    vp->present = 1;
+    vp->cow = 0;
     vp->referenced = 1;
     vp->last_accessed = current_time_ms;
+    vp->dirty = 1;
+    vp->swap_clean = 0;
+    frame_table->policy->on_load(frame_table, next_frame);
+    total_page_accesses++;
+    if (vm_opt_enabled) vm_opt_record(pcb->pid, vfn);
+    total_cow_copies++;
     return vp;
 }
 
+/**
+ * This function handles a page request for a given process
+ * @param pcb Process Control Block of the requesting process
+ * @param frame_table The frame table
+ * @param swap The swap
+ * @param vfn The virtual frame number requested
+ * @param is_write 1 if the page is written to, which makes it dirty
+ * @return Pointer to the page table entry of the requested page, or NULL on failure.
+ *         If the page had to be read from swap, pcb->swap_ready_ms is when the read completes.
+ */
+pte_t *page_request(uint32_t current_time_ms, pcb_t *pcb, frame_table_t *frame_table, swap_hash_t *swap, uint32_t vfn,
+                    int is_write) {
+    DBG("Requesting page %u for process %d", vfn, pcb->pid);
+    pte_t *vp = map_page(&pcb->page_table, vfn);
+    if (vp == NULL) {
+        printf("Cannot map page %u of process %d\n", vfn, pcb->pid);
+        return NULL;
+    }
+    if (is_active(vp)) {
+        // Page is present in RAM
+        DBG("Page %u is active in RAM, just bookkeeping", vfn);
+        if (is_write && vp->cow) return cow_fault(current_time_ms, pcb, frame_table, swap, vp, vfn);
+        return page_hit(current_time_ms, frame_table, swap, vp->frame_id, is_write);
+    }
+    if (pcb->shared_maps) {
+        const shared_map_t *map = vm_shared_find(pcb, vfn);
+        if (map) return shared_page_request(current_time_ms, pcb, frame_table, swap, vp, map, vfn, is_write);
+    }
+    total_page_accesses++;
+    pcb->vm_accesses++;
+    if (vm_opt_enabled) vm_opt_record(pcb->pid, vfn);
+    total_page_faults++;
+    vm_load_fault(pcb, frame_table);
+    return page_fault(current_time_ms, pcb, frame_table, swap, vp, pcb->pid, vfn, pcb, is_write);
+}
+
+/**
+ * Write the page of a frame out to swap and free the frame
+ * @param current_time_ms The current simulation time (the page is written to the swap device)
+ * @param frame_table The frame table
+ * @param swap The swap
+ * @param evict_frame The frame, which holds a page
+ */
+static void evict_page(uint32_t current_time_ms, frame_table_t *frame_table, swap_hash_t *swap, int evict_frame) {
+    frame_desc_t *fd = &frame_table->frames[evict_frame];
+    pte_t *vp = fd->vp;
+
+    // ============================================== MARCAR NOT PRESENT ===================================================
+
+    // Na pagina virtual marco como não presente em RAM
+    vp->present = 0;
+    vp->cow = 0;
+
+    // ================================================= MANDAR EMBORA =====================================================
+
+    // Faço swap -> vai para o disco (se estiver limpa e já houver cópia no swap, não há nada a escrever)
+    int written = swap_out(swap, fd);
+    if (written < 0) {
+        printf("Failed to swap out page %u of process %d\nFreeing the frame anyway\n", fd->vfn, fd->pid);
+    } else if (written == 0) {
+        // Nobody waits for the write, but it holds up the reads queued after it
+        swap_device_submit(&swap->device, current_time_ms, SWAP_WRITE);
+    }
+    // E nas dos outros processos que a mapeiam (páginas partilhadas, ou de um fork, que ficam com a mesma cópia no swap)
+    if (fd->rmap) rmap_unmap_all(swap, fd);
+    // Como este frame ficou vazio, adiciono á lista de free_frames
+    // (e esqueço a página, senão o frame livre continuava a parecer ocupado)
+    frame_table->policy->on_unload(frame_table, evict_frame, 1);
+    if (vp->prefetched || vp->ra_marker) readahead_wasted(fd->owner, vp);
+    if (fd->owner) fd->owner->rss--;
+    fd->owner = NULL;
+    fd->vp = NULL;
+    fd->gen++;
+    push_free_frame(&frame_table->free_stack, evict_frame);
+}
+
 /**
  * This function evicts pages from the frame table until there are enough free pages
+ * @param current_time_ms The current simulation time (the evicted pages are written to the swap device)
  * @param frame_table The frame table
  * @param swap The swap
- * @return 0 on success, -1 on failure
+ * @param target Evict until free_stack.top is at least this
+ * @return the number of frames freed, or -1 on failure
  */
-int page_eviction(frame_table_t *frame_table, swap_hash_t *swap, int32_t min_pages_threshold) {
+int reclaim_frames(uint32_t current_time_ms, frame_table_t *frame_table, swap_hash_t *swap, int32_t target) {
+    int reclaimed = 0;
     // ================================================ PRECISO DE ESPAÇO? ==================================================
 
 
 
     // Enquanto houver poucas frames livres, continuo a descartar páginas.
     // 'top' é o índice do elemento no topo da pilha de frames livres.
-    // Quando 'top' fica abaixo do limiar (min_pages_threshold), há poucas livres
+    // Quando 'top' fica abaixo do limiar (target), há poucas livres
     // e é necessário libertar mais páginas da RAM (fazer evicções).
-    while (frame_table->free_stack.top < min_pages_threshold) {
-        printf("Eviction (only %d pages left)\n", frame_table->free_stack.top);
+    while (frame_table->free_stack.top < target) {
+        DBG("Eviction (only %d pages left)", frame_table->free_stack.top);
 
         // ================================================ ESCOLHA DA VITIMA ==================================================
 
         // Escolhe a próxima frame a remover da RAM segundo o algoritmo escolhido
         // variavel evict_frame é o ID da vitima
 
-        int evict_frame;
-        switch (current_policy) {
-            case VM_FIFO:
-                evict_frame = pop_fifo_eviction(&frame_table->eviction_order);
-                break;
-            case VM_RANDOM:
-                evict_frame = random_eviction(frame_table);
-                break;
-            case VM_NRU:
-                evict_frame = nru_eviction(frame_table);
-                break;
-            case VM_LRU:
-                evict_frame = lru_eviction(frame_table);
-                break;
-            case VM_CLOCK:
-                evict_frame = clock_eviction(frame_table);
-            break;
-            default:
-                printf("Invalid algorithm selected\n");
-                return -1;
-        }
+        int evict_frame = frame_table->policy->select_victim(frame_table);
 
         if (evict_frame == INVALID_FRAME) {
             printf("No frame to evict!\n");
@@ -391,149 +1142,67 @@ int page_eviction(frame_table_t *frame_table, swap_hash_t *swap, int32_t min_pag
         pte_t *vp = fd->vp;
         if (!vp) {
             printf("Frame %d has no valid page to evict!\n", evict_frame);
+            frame_table->policy->on_unload(frame_table, evict_frame, 0);
             continue;
         }
-        printf("Evicting page %d of process %d from frame %d\n", fd->vfn, fd->pid, evict_frame);
-
-        // ============================================== MARCAR NOT PRESENT ===================================================
-
-        // Na pagina virtual marco como não presente em RAM
-        vp->present = 0;
-
-        // ================================================= MANDAR EMBORA =====================================================
-
-        // Faço swap -> vai para o disco
-        if (swap_out(swap, fd) < 0) {
-            printf("Failed to swap out page %d of process %d\nFreeing the frame anyway\n", fd->vfn, fd->pid);
-        }
-        // Como este frame ficou vazio, adiciono á lista de free_frames
-        push_free_frame(&frame_table->free_stack, evict_frame);
+        DBG("Evicting page %u of process %d from frame %d", fd->vfn, fd->pid, evict_frame);
+        evict_page(current_time_ms, frame_table, swap, evict_frame);
+        reclaimed++;
     }
-    return 0;
+    return reclaimed;
 }
 
-
-int random_eviction(frame_table_t *frame_table) {
-    // Verifico se há frames "aptos" a serem removidos (para não ficar infinitamente á procura)
-    int tem_candidatos = 0;
-    for (int i = 0; i < frame_table->no_frames; i++) {
-        if (frame_table->frames[i].vp != NULL && frame_table->frames[i].vp->present == 1) {
-            tem_candidatos = 1;
-            break;
-        }
-    }
-    if (!tem_candidatos) {
-        printf("[random_eviction] Nenhuma frame válida para remover.\n");
-        return INVALID_FRAME;
-    }
-
-    // Escolho uma vitima com id aleatorio dentro dos IDs possiveis
-    int id_vitima = rand() % frame_table->no_frames;
-    // Se vp nao está ativa ou conteudo da vp já nao está na ram, gero outra vitima
-    while (frame_table->frames[id_vitima].vp == NULL || frame_table->frames[id_vitima].vp->present == 0) {
-        id_vitima = rand() % frame_table->no_frames;
+/**
+ * Direct reclaim, on the path of a page access: evict pages until there are at least
+ * min_pages_threshold free frames (the min watermark, see kswapd.h for the others)
+ * @param current_time_ms The current simulation time (the evicted pages are written to the swap device)
+ * @param frame_table The frame table
+ * @param swap The swap
+ * @param min_pages_threshold Evict until free_stack.top is at least this
+ * @return 0 on success, -1 on failure
+ */
+int page_eviction(uint32_t current_time_ms, frame_table_t *frame_table, swap_hash_t *swap, int32_t min_pages_threshold) {
+    int reclaimed = reclaim_frames(current_time_ms, frame_table, swap, min_pages_threshold);
+    if (reclaimed < 0) return -1;
+    if (reclaimed > 0) {
+        total_direct_reclaims += reclaimed;
+        total_direct_reclaim_stalls++;
     }
-
-    return id_vitima;
+    return 0;
 }
 
-int clock_eviction(frame_table_t *frame_table) {
-    frame_desc_t *frame_atual;
-    pte_t *pagina_atual;
-
-    // Faço apenas duas voltas
-    for (int tries = 0; tries < 2 * frame_table->no_frames; tries++) {
-        frame_atual = &frame_table->frames[clock_pointer];
-        pagina_atual = frame_atual->vp;
-
-        // Se esta pagina está presente
-        if (pagina_atual != NULL && pagina_atual->present) {
-            // Se não foi usada vai ser esta para remover
-            if (pagina_atual->referenced == 0) {
-                return clock_pointer;
-            } else {
-                // Se foi usada marco como não usada
-                // Assim na proxima volta se continuar nao usada vai continuar a zero e pode ser esoclhida
-                pagina_atual->referenced = 0;
-            }
+static int page_out_node(uint32_t current_time_ms, frame_table_t *frame_table, swap_hash_t *swap, void *node,
+                         int level) {
+    int paged_out = 0;
+    if (level > 1) {
+        pt_dir_t *dir = node;
+        for (uint32_t i = 0; i < PT_FANOUT; ++i) {
+            if (dir->slots[i]) paged_out += page_out_node(current_time_ms, frame_table, swap, dir->slots[i], level - 1);
         }
-
-        // Avanço o clock_pointer para o proximo (no_frames) (no ultimo volta ao zero)
-        clock_pointer = (clock_pointer + 1) % frame_table->no_frames;
+        return paged_out;
     }
-    return INVALID_FRAME;
-}
-
-int classificacao_nru(pte_t *pagina_virtual) {
-    // referenced | dirty | classificacao
-    //     0      |   0   |      0
-    //     0      |   1   |      1
-    //     1      |   0   |      2
-    //     1      |   1   |      3
-    return (pagina_virtual->referenced ? 2 : 0) + (pagina_virtual->dirty ? 1 : 0);
-}
-
-int nru_eviction(frame_table_t *frame_table) {
-    frame_desc_t *frame_atual;
-    pte_t *pagina_atual;
-
-    // A melhor classificação é uma maior (impossivel)
-    int melhor_class = 4;
-    // Ainda nao tenho melhor candidato
-    int melhor_candidato = INVALID_FRAME;
-
-    // Percorrendo todos os frames
-    for (int i = 0; i < frame_table->no_frames; i++) {
-        // Acedo á sua vp
-        frame_atual = &frame_table->frames[i];
-        pagina_atual = frame_atual->vp;
-
-        // Se nao existe ou já nao está presente, next
-        if (!pagina_atual || !pagina_atual->present) {
-            continue;
-        }
-
-        // Atribuo uma classificaçao a esta pagina
-        int classe = classificacao_nru(pagina_atual);
-        // Se esta classificaçao é menor:
-        if (classe < melhor_class) {
-            // esta classific. é a nova melhor
-            melhor_class = classe;
-            // este é o novo melhor candidato
-            melhor_candidato = i;
-            if (classe == 0) {
-                // Estou a devolver o primeiro que encontro com a maior classif. (0)
-                return i;
-            }
+    pt_leaf_t *leaf = node;
+    for (uint32_t i = 0; i < PT_FANOUT; ++i) {
+        pte_t *vp = &leaf->ptes[i];
+        if (is_active(vp) && frame_table->frames[vp->frame_id].vp == vp) {
+            evict_page(current_time_ms, frame_table, swap, vp->frame_id);
+            paged_out++;
         }
     }
-    return melhor_candidato;
+    return paged_out;
 }
 
-int lru_eviction(frame_table_t *frame_table) {
-    // Ainda nao tenho um melhor
-    int melhor = INVALID_FRAME;
-
-    // Começo com o maior valor possível para encontrar o acesso mais antigo
-    uint32_t oldest_access_time = UINT32_MAX;
-
-    // Para cada frame
-    for (int i = 0; i < frame_table->no_frames; i++) {
-        // Acedo á sua vp
-        frame_desc_t *fd = &frame_table->frames[i];
-        pte_t *vp = fd->vp;
-
-        // Se vp nao está ativa ou presente, next
-        if (!vp || !vp->present) {
-            continue;
-        }
-        // Se esta foi acedida num tempo anterior ao oldest_acces_time
-        if (vp->last_accessed < oldest_access_time) {
-            // este é o novo oldest_access_time
-            oldest_access_time = vp->last_accessed;
-            // este é o novo melhor
-            melhor = i;
-        }
-    }
-    return melhor;
+/**
+ * Write all resident pages of a process out to swap, e.g. when it is suspended
+ * @param current_time_ms The current simulation time (the pages are written to the swap device)
+ * @param frame_table The frame table
+ * @param swap The swap
+ * @param pcb The process
+ * @return the number of frames freed
+ */
+int page_out_process(uint32_t current_time_ms, frame_table_t *frame_table, swap_hash_t *swap, pcb_t *pcb) {
+    page_table_t *pt = &pcb->page_table;
+    if (pt->root == NULL) return 0;
+    return page_out_node(current_time_ms, frame_table, swap, pt->root, pt->height);
 }
+
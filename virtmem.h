@@ -5,16 +5,47 @@
 #ifndef VIRTMEM_H
 #define VIRTMEM_H
 
-extern vm_policy_t current_policy;
-
+#include <stdio.h>
 
 #include "virtmem_types.h"
 #include "pcb.h"
 
-int create_page_table(page_table_t *pt, int max_size);
-frame_table_t *create_frame_table(int num_frames);
+extern vm_policy_t current_policy;
+
+/*
+ * A page replacement policy. virtmem.c calls the hooks whenever a frame changes, so
+ * the policy can keep its own index of the resident frames (in frame_table->policy_state)
+ * and pick a victim without scanning the frame table.
+ */
+typedef struct vm_policy_ops_st {
+    vm_policy_t id;
+    const char *name;
+    const char *description;
+
+    // Allocate the (empty) index in frame_table->policy_state
+    int  (*init)(frame_table_t *frame_table);
+    // A page was placed in the frame; its PTE bits are already set
+    void (*on_load)(frame_table_t *frame_table, int frame_id);
+    // The page in the frame was accessed again; its PTE bits are already set
+    void (*on_access)(frame_table_t *frame_table, int frame_id);
+    // The frame is about to be freed: evicted (1) or released by a terminated process (0)
+    void (*on_unload)(frame_table_t *frame_table, int frame_id, int evicted);
+    // A swapped out page of a terminated process is gone, drop what is remembered about it
+    void (*on_forget)(frame_table_t *frame_table, uint64_t page_id);
+    // Frame to evict (left in the index, on_unload follows), INVALID_FRAME if none
+    int  (*select_victim)(frame_table_t *frame_table);
+} vm_policy_ops_t;
+
+int create_page_table(page_table_t *pt);
+void clear_page_table(page_table_t *pt);
+frame_table_t *create_frame_table(int num_frames, int min_pages_threshold);
 
-pte_t *find_page(page_table_t *pt, int32_t vfn);
+int set_vm_policy(const char *name);
+void list_vm_policies(FILE *out);
+
+pte_t *find_page(page_table_t *pt, uint32_t vfn);
+pte_t *map_page(page_table_t *pt, uint32_t vfn);
+size_t page_table_peak_bytes(void);
 int is_active(pte_t *page);
 int is_valid(pte_t *page);
 
@@ -22,20 +53,25 @@ int init_free_stack(free_stack_t *stack, int num_frames);
 int push_free_frame(free_stack_t *stack, int frame_id);
 int pop_free_frame(free_stack_t *stack);
 
-int init_fifo_eviction(fifo_t *fifo, int num_frames);
-int push_fifo_eviction(fifo_t *fifo, int frame_id);
-int pop_fifo_eviction(fifo_t *fifo);
-
 int swap_out(swap_hash_t *swap, frame_desc_t *fd);
 int swap_in(swap_hash_t *swap, frame_desc_t *fd);
 
-int page_eviction(frame_table_t *frame_table, swap_hash_t *swap, int32_t min_pages_threshold);
-pte_t *page_request(uint32_t current_time_ms,pcb_t *pcb, frame_table_t *frame_table, swap_hash_t *swap, int vfn);
+int rmap_add(frame_desc_t *fd, pte_t *pte, pcb_t *owner, int32_t pid, uint32_t vfn);
+void rmap_remove(frame_desc_t *fd, pte_t *pte);
+
+void release_process_memory(frame_table_t *frame_table, swap_hash_t *swap, pcb_t *pcb);
+int fork_process_memory(frame_table_t *frame_table, swap_hash_t *swap, pcb_t *parent, pcb_t *child);
+
+int reclaim_frames(uint32_t current_time_ms, frame_table_t *frame_table, swap_hash_t *swap, int32_t target);
+int page_out_process(uint32_t current_time_ms, frame_table_t *frame_table, swap_hash_t *swap, pcb_t *pcb);
+int page_eviction(uint32_t current_time_ms, frame_table_t *frame_table, swap_hash_t *swap, int32_t min_pages_threshold);
+pte_t *page_request(uint32_t current_time_ms, pcb_t *pcb, frame_table_t *frame_table, swap_hash_t *swap, uint32_t vfn,
+                    int is_write);
+
+pte_t *page_hit(uint32_t current_time_ms, frame_table_t *frame_table, swap_hash_t *swap, int32_t frame_id, int is_write);
+pte_t *prefetch_page(uint32_t current_time_ms, pcb_t *pcb, frame_table_t *frame_table, swap_hash_t *swap, uint32_t vfn);
 
-int random_eviction(frame_table_t *frame_table);
-int clock_eviction(frame_table_t *frame_table);
-int nru_eviction(frame_table_t *frame_table);
-int lru_eviction(frame_table_t *frame_table);
+int classificacao_nru(pte_t *pagina_virtual);
 
 
 #endif //VIRTMEM_H
@@ -2,10 +2,10 @@
 #define VIRTMEM_TYPES_H
 
 #include <stdint.h>
-#include "uthash.h"
+#include "swap.h"
 
 #define INVALID_FRAME -1
-typedef enum { VM_RANDOM=0, VM_FIFO, VM_NRU, VM_LRU, VM_CLOCK } vm_policy_t;
+typedef enum { VM_RANDOM=0, VM_FIFO, VM_NRU, VM_LRU, VM_CLOCK, VM_ARC, VM_2Q, VM_LIRS, VM_CLOCKPRO, VM_MGLRU } vm_policy_t;
 const char *policy_to_string(vm_policy_t policy);
 
 // =========================================== Paginas virtuais ========================================================
@@ -17,65 +17,120 @@ typedef struct pte_st {
     uint8_t  present:1;
     uint8_t  referenced:1;
     uint8_t  dirty:1;
+    uint8_t  swap_cached:1;  // the page keeps its slot in swap while resident (swap cache)
+    uint8_t  swap_clean:1;   // and the copy in that slot is current: evicting the page needs no write
+    uint8_t  prefetched:1;   // brought in by readahead and not accessed yet
+    uint8_t  ra_marker:1;    // an access to it starts the next readahead window
+    uint8_t  shared:1;       // maps a page of a shared region, the frame belongs to the region (vm_shared.h)
+    uint8_t  cow:1;          // copy-on-write: shared with a forked process, a write copies it first
     uint32_t last_accessed;
 } pte_t;
 
-// Page table (cada processo tem uma): array de PTEs que mapeia páginas virtuais -> frames físicas
+// Page table (cada processo tem uma): árvore radix que mapeia páginas virtuais -> frames físicas
+// O VPN de 32 bits é partido em grupos de PT_BITS bits, um por nível; as folhas guardam os PTEs.
+// Os níveis só são criados quando uma página debaixo deles é usada, e a árvore só fica tão alta
+// quanto o maior VPN usado pede: um processo com páginas < 256 tem só uma folha.
+#define PT_BITS   8
+#define PT_FANOUT (1u << PT_BITS)
+#define PT_MASK   (PT_FANOUT - 1)
+#define PT_LEVELS 4             // PT_LEVELS * PT_BITS = 32 bits de VPN
+
+typedef struct pt_leaf_st {
+    pte_t ptes[PT_FANOUT];
+} pt_leaf_t;
+
+typedef struct pt_dir_st {
+    void *slots[PT_FANOUT];     // pt_dir_t no nível de cima de outro diretório, pt_leaf_t no último
+} pt_dir_t;
+
 typedef struct page_table_st {
-    uint8_t  nvalid;
-    // Lista de ptes
-    // O índice da página virtual (VPN) corresponde à posição neste array
-    pte_t   *vp;
+    void    *root;              // pt_leaf_t se height == 1, pt_dir_t se maior, NULL se vazia
+    uint8_t  height;            // Número de níveis (0 a PT_LEVELS)
 } page_table_t;
 
-// =============================================== FIFO coisas =========================================================
+// =============================================== Frames livres ======================================================
 
-/* Free-frame stack + FIFO eviction queue */
+/* Free-frame stack */
 typedef struct free_stack_st {
     uint32_t *ids;
     int       max_size;
     int       top;
 } free_stack_t;
 
-typedef struct fifo_st {
-    uint32_t *ids;
-    int       max_size;
-    int       top;
-} fifo_t;
-
 // =========================================== Frames (memória física) =================================================
 
+// Reverse map: mais uma PTE que mapeia o frame (páginas partilhadas entre processos)
+typedef struct rmap_st {
+    pte_t          *pte;
+    struct pcb_st  *owner;      // o processo da PTE
+    int32_t         pid;        // e a página dela, para lhe dar a cópia no swap quando o frame sai
+    uint32_t        vfn;
+    struct rmap_st *next;
+} rmap_t;
+
 // Representa um frame físico (bloco de RAM) e a que página/processo pertence
 typedef struct frame_desc_st {
     pte_t    *vp;         // pagina virtual correspondente
+    rmap_t   *rmap;       // as PTEs dos processos que também mapeiam a página, NULL se só vp
     int32_t   pid;        // ID do processo dono
+    struct pcb_st *owner; // o processo dono (para o seu resident set)
     uint32_t  vfn;        // qual a posicao da pagina virtual na page table do processo
+    uint32_t  gen;        // incrementa sempre que a página sai do frame, invalida as entradas da TLB
 } frame_desc_t;
 
 // Representa toda a memória física (lista de frames)
 typedef struct frame_table_st {
     int           no_frames;     // Quantidade de frames físicos
+    int           capacity;      // Quantas páginas cabem residentes sem baixar do threshold de frames livres
+    int           min_free;      // Frames livres que page_eviction() mantém (o threshold)
     frame_desc_t *frames;        // lista dos frames
     free_stack_t  free_stack;    // pilha que guarda frames livres, redundante mas mais eficiente e prático
 
-    fifo_t        eviction_order;   // Used for FIFO eviction
+    // Política de substituição e o índice das frames residentes que ela mantém
+    const struct vm_policy_ops_st *policy;
+    void         *policy_state;
 } frame_table_t;
 
 // =============================================== SWAP ================================================================
 
 // Representa uma página que foi removida da RAM e colocada no disco (swap)
 typedef struct swapped_frame_st {
-    uint64_t page_id;        // key: (pid<<32)|vpn
-    uint8_t  dirty:1;        // was the page dirty on eviction
+    union {
+        uint64_t page_id;                       // key: (pid<<32)|vpn
+        uint32_t next_free;                     // while the entry is not in use: 1 + index of the next free one
+    };
+    uint32_t slot;           // where the page is in the swap space
+    int32_t  writer_pid;     // the slot holds the page as written by this process (a fork shares slots)
     uint32_t last_accessed;  // optional: for stats/aging
-    UT_hash_handle hh;       // makes this structure hashable
+    uint8_t  dirty:1;        // was the page dirty on eviction
 } swapped_frame_t;
 
+// Mapa page_id -> página em swap: tabela de endereçamento aberto (Robin Hood, ver swap_map.c)
+// As entradas vivem em slabs, só o page_id e o índice da entrada ficam na tabela
+typedef struct swap_map_bucket_st {
+    uint64_t key;
+    uint32_t dist;           // 1 + distance from the bucket the key hashes to, 0 if empty
+    uint32_t entry;          // index of the entry in the slabs
+} swap_map_bucket_t;
+
+typedef struct swap_map_st {
+    swap_map_bucket_t *buckets;
+    uint32_t  mask;          // number of buckets - 1 (a power of two)
+    uint32_t  shift;         // 64 - log2(number of buckets)
+    uint32_t  count;
+    swapped_frame_t **slabs;
+    uint32_t  nslabs;
+    uint32_t  nentries;      // entries handed out from the slabs so far
+    uint32_t  free_head;     // 1 + index of the first free entry, 0 if none
+} swap_map_t;
+
 // Representa a estrutura global do swap (todas as páginas que estão no disco)
 typedef struct swap_hash_st {
-    int num_swapped;                 // number of swapped frames
+    int num_swapped;                 // number of pages with a copy in swap (swapped out or swap cached)
     uint32_t last_swap_time_ms;      // last time a swap occurred
-    swapped_frame_t *pages;        // hash table of swapped pages
+    swap_map_t pages;                // swapped pages by page_id
+    swap_device_t device;            // the disk the pages are read from and written to
+    swap_space_t space;              // the slots (and swap file) the pages are stored in
 } swap_hash_t;
 
 #endif
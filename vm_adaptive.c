@@ -0,0 +1,791 @@
+/*
+ * Scan resistant page replacement policies. Pure LRU and CLOCK throw the hot pages
+ * out when a process sweeps once over more pages than fit in RAM; these policies keep
+ * a page that was used once apart from one that was used again, and remember recently
+ * evicted pages (ghosts) to recognise a page that comes back:
+ *   arc       ARC (Megiddo & Modha): T1/T2 with ghost lists B1/B2 and an adaptive target
+ *   2q        2Q (Johnson & Shasha): FIFO A1in, ghost FIFO A1out, LRU Am
+ *   lirs      LIRS (Jiang & Zhang): LIR set by inter-reference recency, stack S and queue Q
+ *   clockpro  CLOCK-Pro (Jiang, Chen & Zhang): hot/cold/test pages with three clock hands
+ *   mglru     multi-generational LRU (as in Linux): generations of pages, aged by the
+ *             eviction scan, with refault detection through shadow entries
+ *
+ * The size of the lists is measured against frame_table->capacity, the number of pages
+ * that can be resident with the free frame threshold kept.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "virtmem.h"
+#include "vm_lists.h"
+
+// ================================================== ARC ==============================================================
+
+enum { ARC_T1, ARC_T2, ARC_LISTS };     // Resident: seen once / seen at least twice recently
+enum { ARC_B1, ARC_B2 };                // Ghosts evicted from T1 / T2
+
+typedef struct arc_st {
+    frame_link_t *links;
+    frame_list_t  lists[ARC_LISTS];
+    ghost_table_t ghosts;
+    int           p;                    // Target size of T1
+} arc_t;
+
+static int arc_init(frame_table_t *ft) {
+    arc_t *arc = malloc(sizeof(arc_t));
+    if (!arc) return -1;
+    arc->links = frame_links_create(ft->no_frames);
+    if (!arc->links) {
+        free(arc);
+        return -1;
+    }
+    frame_lists_init(arc->lists, ARC_LISTS);
+    ghost_table_init(&arc->ghosts);
+    arc->p = 0;
+    ft->policy_state = arc;
+    return 0;
+}
+
+static void arc_load(frame_table_t *ft, int frame) {
+    arc_t *arc = ft->policy_state;
+    int c = ft->capacity;
+    ghost_t *ghost = ghost_find(&arc->ghosts, vm_page_id(&ft->frames[frame]));
+    if (!ghost) {
+        frame_list_push_tail(arc->links, arc->lists, ARC_T1, frame);
+        return;
+    }
+    // A hit in a ghost list means that list should have been larger
+    int b1 = arc->ghosts.lists[ARC_B1].count;
+    int b2 = arc->ghosts.lists[ARC_B2].count;
+    if (ghost->list == ARC_B1) {
+        int delta = (b1 >= b2) ? 1 : b2 / b1;
+        arc->p = (arc->p + delta > c) ? c : arc->p + delta;
+    } else {
+        int delta = (b2 >= b1) ? 1 : b1 / b2;
+        arc->p = (arc->p - delta < 0) ? 0 : arc->p - delta;
+    }
+    ghost_remove(&arc->ghosts, ghost);
+    frame_list_push_tail(arc->links, arc->lists, ARC_T2, frame);
+}
+
+static void arc_access(frame_table_t *ft, int frame) {
+    arc_t *arc = ft->policy_state;
+    frame_list_unlink(arc->links, arc->lists, frame);
+    frame_list_push_tail(arc->links, arc->lists, ARC_T2, frame);
+}
+
+static void arc_unload(frame_table_t *ft, int frame, int evicted) {
+    arc_t *arc = ft->policy_state;
+    int list = arc->links[frame].list;
+    frame_list_unlink(arc->links, arc->lists, frame);
+    if (!evicted || list == INVALID_FRAME) return;
+
+    ghost_add(&arc->ghosts, list == ARC_T1 ? ARC_B1 : ARC_B2, vm_page_id(&ft->frames[frame]), 0);
+    // |T1| + |B1| <= c and |T1| + |T2| + |B1| + |B2| <= 2c
+    int c = ft->capacity;
+    int t1 = arc->lists[ARC_T1].count;
+    int t2 = arc->lists[ARC_T2].count;
+    ghost_trim(&arc->ghosts, ARC_B1, c - t1);
+    ghost_trim(&arc->ghosts, ARC_B2, 2 * c - t1 - t2 - arc->ghosts.lists[ARC_B1].count);
+}
+
+static void arc_forget(frame_table_t *ft, uint64_t page_id) {
+    arc_t *arc = ft->policy_state;
+    ghost_forget(&arc->ghosts, page_id);
+}
+
+static int arc_select(frame_table_t *ft) {
+    arc_t *arc = ft->policy_state;
+    int t1 = arc->lists[ARC_T1].count;
+    if (t1 > 0 && (t1 > arc->p || arc->lists[ARC_T2].count == 0)) return arc->lists[ARC_T1].head;
+    return arc->lists[ARC_T2].head;
+}
+
+// ================================================== 2Q ===============================================================
+
+enum { Q_A1IN, Q_AM, Q_LISTS };         // Resident: FIFO of new pages / LRU of pages that came back
+enum { Q_A1OUT };                       // Ghosts evicted from A1in
+
+typedef struct twoq_st {
+    frame_link_t *links;
+    frame_list_t  lists[Q_LISTS];
+    ghost_table_t ghosts;
+} twoq_t;
+
+// Sizes recommended by the paper: A1in a quarter of memory, A1out half of it
+static int twoq_kin(frame_table_t *ft) {
+    return ft->capacity / 4 > 1 ? ft->capacity / 4 : 1;
+}
+
+static int twoq_kout(frame_table_t *ft) {
+    return ft->capacity / 2 > 1 ? ft->capacity / 2 : 1;
+}
+
+static int twoq_init(frame_table_t *ft) {
+    twoq_t *q = malloc(sizeof(twoq_t));
+    if (!q) return -1;
+    q->links = frame_links_create(ft->no_frames);
+    if (!q->links) {
+        free(q);
+        return -1;
+    }
+    frame_lists_init(q->lists, Q_LISTS);
+    ghost_table_init(&q->ghosts);
+    ft->policy_state = q;
+    return 0;
+}
+
+static void twoq_load(frame_table_t *ft, int frame) {
+    twoq_t *q = ft->policy_state;
+    ghost_t *ghost = ghost_find(&q->ghosts, vm_page_id(&ft->frames[frame]));
+    if (ghost) {
+        ghost_remove(&q->ghosts, ghost);
+        frame_list_push_tail(q->links, q->lists, Q_AM, frame);
+    } else {
+        frame_list_push_tail(q->links, q->lists, Q_A1IN, frame);
+    }
+}
+
+// Accesses while in A1in are correlated with the first one and do not count
+static void twoq_access(frame_table_t *ft, int frame) {
+    twoq_t *q = ft->policy_state;
+    if (q->links[frame].list != Q_AM) return;
+    frame_list_unlink(q->links, q->lists, frame);
+    frame_list_push_tail(q->links, q->lists, Q_AM, frame);
+}
+
+static void twoq_unload(frame_table_t *ft, int frame, int evicted) {
+    twoq_t *q = ft->policy_state;
+    int list = q->links[frame].list;
+    frame_list_unlink(q->links, q->lists, frame);
+    if (!evicted || list != Q_A1IN) return;
+    ghost_add(&q->ghosts, Q_A1OUT, vm_page_id(&ft->frames[frame]), 0);
+    ghost_trim(&q->ghosts, Q_A1OUT, twoq_kout(ft));
+}
+
+static void twoq_forget(frame_table_t *ft, uint64_t page_id) {
+    twoq_t *q = ft->policy_state;
+    ghost_forget(&q->ghosts, page_id);
+}
+
+static int twoq_select(frame_table_t *ft) {
+    twoq_t *q = ft->policy_state;
+    int a1in = q->lists[Q_A1IN].count;
+    if (a1in > 0 && (a1in > twoq_kin(ft) || q->lists[Q_AM].count == 0)) return q->lists[Q_A1IN].head;
+    return q->lists[Q_AM].head;
+}
+
+// ================================================= LIRS ==============================================================
+
+/*
+ * Every page LIRS knows about has a node: LIR pages (always resident), resident HIR
+ * pages and non-resident HIR pages that are still in the stack. Stack S is kept in
+ * recency order with an LIR page at the bottom (head); queue Q holds the resident HIR
+ * pages, the eviction candidates. Non-resident HIR pages are on their own FIFO so their
+ * number can be bounded.
+ */
+enum { LIRS_NOWHERE, LIRS_QUEUE, LIRS_NONRESIDENT };
+
+typedef struct lirs_node_st {
+    uint64_t page_id;
+    int32_t  frame;             // INVALID_FRAME if not resident
+    uint8_t  lir;
+    uint8_t  in_stack;
+    uint8_t  where;             // Which list the q links are in
+    struct lirs_node_st *s_prev, *s_next;
+    struct lirs_node_st *q_prev, *q_next;
+    UT_hash_handle hh;
+} lirs_node_t;
+
+typedef struct lirs_list_st {
+    lirs_node_t *head;
+    lirs_node_t *tail;
+    int          count;
+} lirs_list_t;
+
+typedef struct lirs_st {
+    lirs_node_t  *pages;        // Hash of all nodes, by page_id
+    lirs_node_t **by_frame;
+    lirs_list_t   stack;        // S, bottom at the head
+    lirs_list_t   lists[3];     // Q and the non-resident pages, indexed by 'where'
+    int           lir_count;
+} lirs_t;
+
+// Resident HIR pages get 1% of the memory, at least one frame
+static int lirs_lir_max(frame_table_t *ft) {
+    int hir = ft->capacity / 100 > 1 ? ft->capacity / 100 : 1;
+    return ft->capacity - hir > 1 ? ft->capacity - hir : 1;
+}
+
+static void s_push_top(lirs_t *lirs, lirs_node_t *n) {
+    n->s_prev = lirs->stack.tail;
+    n->s_next = NULL;
+    if (lirs->stack.tail) lirs->stack.tail->s_next = n; else lirs->stack.head = n;
+    lirs->stack.tail = n;
+    lirs->stack.count++;
+    n->in_stack = 1;
+}
+
+static void s_unlink(lirs_t *lirs, lirs_node_t *n) {
+    if (!n->in_stack) return;
+    if (n->s_prev) n->s_prev->s_next = n->s_next; else lirs->stack.head = n->s_next;
+    if (n->s_next) n->s_next->s_prev = n->s_prev; else lirs->stack.tail = n->s_prev;
+    lirs->stack.count--;
+    n->in_stack = 0;
+}
+
+static void q_push(lirs_t *lirs, int where, lirs_node_t *n) {
+    lirs_list_t *l = &lirs->lists[where];
+    n->q_prev = l->tail;
+    n->q_next = NULL;
+    if (l->tail) l->tail->q_next = n; else l->head = n;
+    l->tail = n;
+    l->count++;
+    n->where = (uint8_t) where;
+}
+
+static void q_unlink(lirs_t *lirs, lirs_node_t *n) {
+    if (n->where == LIRS_NOWHERE) return;
+    lirs_list_t *l = &lirs->lists[n->where];
+    if (n->q_prev) n->q_prev->q_next = n->q_next; else l->head = n->q_next;
+    if (n->q_next) n->q_next->q_prev = n->q_prev; else l->tail = n->q_prev;
+    l->count--;
+    n->where = LIRS_NOWHERE;
+}
+
+static void lirs_delete(lirs_t *lirs, lirs_node_t *n) {
+    s_unlink(lirs, n);
+    q_unlink(lirs, n);
+    if (n->lir) lirs->lir_count--;
+    HASH_DEL(lirs->pages, n);
+    free(n);
+}
+
+// Take HIR pages off the bottom of the stack until an LIR page is there
+static void lirs_prune(lirs_t *lirs) {
+    while (lirs->stack.head && !lirs->stack.head->lir) {
+        lirs_node_t *n = lirs->stack.head;
+        s_unlink(lirs, n);
+        if (n->frame == INVALID_FRAME) lirs_delete(lirs, n);
+    }
+}
+
+// The LIR page at the bottom of the stack has the largest recency: it becomes a resident HIR page
+static void lirs_demote_bottom(lirs_t *lirs) {
+    lirs_node_t *n = lirs->stack.head;
+    if (!n) return;
+    s_unlink(lirs, n);
+    n->lir = 0;
+    lirs->lir_count--;
+    q_push(lirs, LIRS_QUEUE, n);
+    lirs_prune(lirs);
+}
+
+static int lirs_init(frame_table_t *ft) {
+    lirs_t *lirs = calloc(1, sizeof(lirs_t));
+    if (!lirs) return -1;
+    lirs->by_frame = calloc((size_t) ft->no_frames, sizeof(lirs_node_t *));
+    if (!lirs->by_frame) {
+        free(lirs);
+        return -1;
+    }
+    ft->policy_state = lirs;
+    return 0;
+}
+
+static void lirs_load(frame_table_t *ft, int frame) {
+    lirs_t *lirs = ft->policy_state;
+    uint64_t page_id = vm_page_id(&ft->frames[frame]);
+    lirs_node_t *n = NULL;
+    HASH_FIND(hh, lirs->pages, &page_id, sizeof(uint64_t), n);
+
+    if (n) {
+        // Non-resident HIR page still in the stack: its reuse distance beats the bottom LIR page
+        q_unlink(lirs, n);
+        n->frame = frame;
+        lirs->by_frame[frame] = n;
+        s_unlink(lirs, n);
+        s_push_top(lirs, n);
+        n->lir = 1;
+        lirs->lir_count++;
+        if (lirs->lir_count > lirs_lir_max(ft)) lirs_demote_bottom(lirs);
+        return;
+    }
+
+    n = calloc(1, sizeof(lirs_node_t));
+    if (!n) {
+        printf("Cannot allocate memory for a LIRS entry\n");
+        return;
+    }
+    n->page_id = page_id;
+    n->frame = frame;
+    HASH_ADD(hh, lirs->pages, page_id, sizeof(uint64_t), n);
+    lirs->by_frame[frame] = n;
+    s_push_top(lirs, n);
+    if (lirs->lir_count < lirs_lir_max(ft)) {
+        // Until the LIR set is full every page is LIR
+        n->lir = 1;
+        lirs->lir_count++;
+    } else {
+        q_push(lirs, LIRS_QUEUE, n);
+    }
+}
+
+static void lirs_access(frame_table_t *ft, int frame) {
+    lirs_t *lirs = ft->policy_state;
+    lirs_node_t *n = lirs->by_frame[frame];
+    if (!n) return;
+
+    if (n->lir) {
+        int was_bottom = (lirs->stack.head == n);
+        s_unlink(lirs, n);
+        s_push_top(lirs, n);
+        if (was_bottom) lirs_prune(lirs);
+        return;
+    }
+    if (n->in_stack) {
+        // Resident HIR page reused while in the stack: it becomes LIR
+        s_unlink(lirs, n);
+        s_push_top(lirs, n);
+        q_unlink(lirs, n);
+        n->lir = 1;
+        lirs->lir_count++;
+        if (lirs->lir_count > lirs_lir_max(ft)) lirs_demote_bottom(lirs);
+    } else {
+        s_push_top(lirs, n);
+        q_unlink(lirs, n);
+        q_push(lirs, LIRS_QUEUE, n);
+    }
+}
+
+static void lirs_unload(frame_table_t *ft, int frame, int evicted) {
+    lirs_t *lirs = ft->policy_state;
+    lirs_node_t *n = lirs->by_frame[frame];
+    if (!n) return;
+    lirs->by_frame[frame] = NULL;
+    n->frame = INVALID_FRAME;
+
+    if (!evicted || n->lir || !n->in_stack) {
+        lirs_delete(lirs, n);
+        lirs_prune(lirs);
+        return;
+    }
+    // Evicted HIR page in the stack: keep it as a non-resident page, at most 'capacity' of them
+    q_unlink(lirs, n);
+    q_push(lirs, LIRS_NONRESIDENT, n);
+    while (lirs->lists[LIRS_NONRESIDENT].count > ft->capacity) {
+        lirs_delete(lirs, lirs->lists[LIRS_NONRESIDENT].head);
+    }
+}
+
+static void lirs_forget(frame_table_t *ft, uint64_t page_id) {
+    lirs_t *lirs = ft->policy_state;
+    lirs_node_t *n = NULL;
+    HASH_FIND(hh, lirs->pages, &page_id, sizeof(uint64_t), n);
+    if (n && n->frame == INVALID_FRAME) {
+        lirs_delete(lirs, n);
+        lirs_prune(lirs);
+    }
+}
+
+static int lirs_select(frame_table_t *ft) {
+    lirs_t *lirs = ft->policy_state;
+    if (lirs->lists[LIRS_QUEUE].head) return lirs->lists[LIRS_QUEUE].head->frame;
+    // Every resident page is LIR (the memory shrank under the LIR set): take the coldest
+    return lirs->stack.head ? lirs->stack.head->frame : INVALID_FRAME;
+}
+
+// =============================================== CLOCK-Pro ===========================================================
+
+/*
+ * All pages are on one circular list in the order they were last moved to its head,
+ * which is just behind the hot hand:
+ *   hand_cold  evicts the first cold resident page that was not referenced; a
+ *              referenced one becomes hot if it was in its test period
+ *   hand_hot   turns the first unreferenced hot page cold, and ends the test period
+ *              of the cold pages it passes
+ *   hand_test  ends test periods to keep at most 'capacity' non-resident pages
+ * The number of cold resident pages adapts: up on a hit of a page in its test period
+ * (a longer test period would have caught it), down when a test period ends unused.
+ */
+typedef struct cpro_node_st {
+    uint64_t page_id;
+    int32_t  frame;             // INVALID_FRAME for a non-resident page in its test period
+    uint8_t  hot;
+    uint8_t  test;
+    uint8_t  ref;
+    struct cpro_node_st *prev, *next;
+    UT_hash_handle hh;
+} cpro_node_t;
+
+typedef struct clockpro_st {
+    cpro_node_t  *pages;        // Hash of all nodes, by page_id
+    cpro_node_t **by_frame;
+    cpro_node_t  *hand_hot;
+    cpro_node_t  *hand_cold;
+    cpro_node_t  *hand_test;
+    int           nr_hot;
+    int           nr_cold;      // Resident cold pages
+    int           nr_test;      // Non-resident pages
+    int           cold_target;
+} clockpro_t;
+
+static int cpro_init(frame_table_t *ft) {
+    clockpro_t *cp = calloc(1, sizeof(clockpro_t));
+    if (!cp) return -1;
+    cp->by_frame = calloc((size_t) ft->no_frames, sizeof(cpro_node_t *));
+    if (!cp->by_frame) {
+        free(cp);
+        return -1;
+    }
+    cp->cold_target = ft->capacity / 10 > 1 ? ft->capacity / 10 : 1;
+    ft->policy_state = cp;
+    return 0;
+}
+
+// Put a node at the head of the list (just behind the hot hand)
+static void cpro_insert(clockpro_t *cp, cpro_node_t *n) {
+    if (!cp->hand_hot) {
+        n->prev = n->next = n;
+        cp->hand_hot = cp->hand_cold = cp->hand_test = n;
+        return;
+    }
+    n->next = cp->hand_hot;
+    n->prev = cp->hand_hot->prev;
+    n->prev->next = n;
+    cp->hand_hot->prev = n;
+}
+
+static void cpro_unlink(clockpro_t *cp, cpro_node_t *n) {
+    if (n->next == n) {
+        cp->hand_hot = cp->hand_cold = cp->hand_test = NULL;
+        return;
+    }
+    if (cp->hand_hot == n) cp->hand_hot = n->next;
+    if (cp->hand_cold == n) cp->hand_cold = n->next;
+    if (cp->hand_test == n) cp->hand_test = n->next;
+    n->prev->next = n->next;
+    n->next->prev = n->prev;
+}
+
+static void cpro_delete(clockpro_t *cp, cpro_node_t *n) {
+    cpro_unlink(cp, n);
+    if (n->hot) cp->nr_hot--;
+    else if (n->frame != INVALID_FRAME) cp->nr_cold--;
+    else cp->nr_test--;
+    HASH_DEL(cp->pages, n);
+    free(n);
+}
+
+static void cpro_end_test(clockpro_t *cp, cpro_node_t *n) {
+    n->test = 0;
+    if (cp->cold_target > 1) cp->cold_target--;
+    if (n->frame == INVALID_FRAME) cpro_delete(cp, n);
+}
+
+static void cpro_run_hand_hot(clockpro_t *cp) {
+    while (cp->nr_hot > 0) {
+        cpro_node_t *n = cp->hand_hot;
+        cp->hand_hot = n->next;
+        if (n->hot) {
+            if (n->ref) {
+                n->ref = 0;
+            } else {
+                n->hot = 0;
+                cp->nr_hot--;
+                cp->nr_cold++;
+                return;
+            }
+        } else if (n->test) {
+            cpro_end_test(cp, n);
+        }
+    }
+}
+
+static void cpro_run_hand_test(clockpro_t *cp) {
+    while (cp->nr_test > 0) {
+        cpro_node_t *n = cp->hand_test;
+        cp->hand_test = n->next;
+        if (!n->hot && n->test) {
+            int was_nonresident = (n->frame == INVALID_FRAME);
+            cpro_end_test(cp, n);
+            if (was_nonresident) return;
+        }
+    }
+}
+
+static void cpro_balance_hot(frame_table_t *ft, clockpro_t *cp) {
+    while (cp->nr_hot > 0 && cp->nr_hot > ft->capacity - cp->cold_target) cpro_run_hand_hot(cp);
+}
+
+static void cpro_load(frame_table_t *ft, int frame) {
+    clockpro_t *cp = ft->policy_state;
+    uint64_t page_id = vm_page_id(&ft->frames[frame]);
+    cpro_node_t *n = NULL;
+    HASH_FIND(hh, cp->pages, &page_id, sizeof(uint64_t), n);
+
+    if (n) {
+        // Non-resident page in its test period: its reuse distance is short enough to be hot
+        if (cp->cold_target < ft->capacity - 1) cp->cold_target++;
+        cpro_unlink(cp, n);
+        cp->nr_test--;
+        n->frame = frame;
+        n->hot = 1;
+        n->test = 0;
+        n->ref = 0;
+        cp->nr_hot++;
+        cp->by_frame[frame] = n;
+        cpro_insert(cp, n);
+        cpro_balance_hot(ft, cp);
+        return;
+    }
+
+    n = calloc(1, sizeof(cpro_node_t));
+    if (!n) {
+        printf("Cannot allocate memory for a CLOCK-Pro entry\n");
+        return;
+    }
+    n->page_id = page_id;
+    n->frame = frame;
+    n->test = 1;
+    HASH_ADD(hh, cp->pages, page_id, sizeof(uint64_t), n);
+    cp->by_frame[frame] = n;
+    cp->nr_cold++;
+    cpro_insert(cp, n);
+}
+
+static void cpro_access(frame_table_t *ft, int frame) {
+    clockpro_t *cp = ft->policy_state;
+    if (cp->by_frame[frame]) cp->by_frame[frame]->ref = 1;
+}
+
+static void cpro_unload(frame_table_t *ft, int frame, int evicted) {
+    clockpro_t *cp = ft->policy_state;
+    cpro_node_t *n = cp->by_frame[frame];
+    if (!n) return;
+    cp->by_frame[frame] = NULL;
+    if (!evicted || n->hot || !n->test) {
+        cpro_delete(cp, n);
+        return;
+    }
+    // An evicted cold page in its test period stays on the list, non-resident
+    n->frame = INVALID_FRAME;
+    cp->nr_cold--;
+    cp->nr_test++;
+    while (cp->nr_test > ft->capacity) cpro_run_hand_test(cp);
+}
+
+static void cpro_forget(frame_table_t *ft, uint64_t page_id) {
+    clockpro_t *cp = ft->policy_state;
+    cpro_node_t *n = NULL;
+    HASH_FIND(hh, cp->pages, &page_id, sizeof(uint64_t), n);
+    if (n && n->frame == INVALID_FRAME) cpro_delete(cp, n);
+}
+
+static int cpro_select(frame_table_t *ft) {
+    clockpro_t *cp = ft->policy_state;
+    for (;;) {
+        if (cp->nr_cold == 0) {
+            if (cp->nr_hot == 0) return INVALID_FRAME;
+            cpro_run_hand_hot(cp);
+            continue;
+        }
+        cpro_node_t *n = cp->hand_cold;
+        cp->hand_cold = n->next;
+        if (n->hot || n->frame == INVALID_FRAME) continue;
+        if (!n->ref) {
+            // The victim stays under the hand until it is unloaded
+            cp->hand_cold = n;
+            return n->frame;
+        }
+        n->ref = 0;
+        cpro_unlink(cp, n);
+        if (n->test) {
+            n->hot = 1;
+            n->test = 0;
+            cp->nr_cold--;
+            cp->nr_hot++;
+            cpro_insert(cp, n);
+            cpro_balance_hot(ft, cp);
+        } else {
+            n->test = 1;
+            cpro_insert(cp, n);
+        }
+    }
+}
+
+// ================================================= MGLRU =============================================================
+
+/*
+ * Resident pages are sorted into generations, numbered from min_seq (oldest) to
+ * max_seq (youngest). Accesses only set a flag, like the accessed bit of a PTE; the
+ * eviction scan looks at the oldest generation, moves the pages that were accessed to
+ * the youngest one and evicts the first one that was not. When the oldest generation
+ * runs empty it is retired. A new youngest generation is created (aging) when fewer
+ * than MGLRU_MIN_GENS are left, or when the youngest one has taken in a 1/MGLRU_MAX_GENS
+ * share of the memory and there is room for another generation. New pages start in the
+ * second youngest generation, so a scan does not push out what is in use; a page that
+ * refaults soon after its eviction (found among the shadow entries) starts in the
+ * youngest.
+ */
+#define MGLRU_MAX_GENS 4
+#define MGLRU_MIN_GENS 2
+
+typedef struct mglru_st {
+    frame_link_t *links;
+    frame_list_t  gens[MGLRU_MAX_GENS];     // Indexed by seq % MGLRU_MAX_GENS
+    uint8_t      *accessed;
+    uint32_t      min_seq;
+    uint32_t      max_seq;
+    int           resident;
+    ghost_table_t shadows;      // Evicted pages, stamped with min_seq at their eviction
+} mglru_t;
+
+static int mglru_init(frame_table_t *ft) {
+    mglru_t *mg = malloc(sizeof(mglru_t));
+    if (!mg) return -1;
+    mg->links = frame_links_create(ft->no_frames);
+    mg->accessed = calloc((size_t) ft->no_frames, sizeof(uint8_t));
+    if (!mg->links || !mg->accessed) {
+        free(mg->links);
+        free(mg->accessed);
+        free(mg);
+        return -1;
+    }
+    frame_lists_init(mg->gens, MGLRU_MAX_GENS);
+    ghost_table_init(&mg->shadows);
+    mg->min_seq = 0;
+    mg->max_seq = MGLRU_MIN_GENS - 1;
+    mg->resident = 0;
+    ft->policy_state = mg;
+    return 0;
+}
+
+static uint32_t mglru_nr_gens(mglru_t *mg) {
+    return mg->max_seq - mg->min_seq + 1;
+}
+
+static void mglru_maybe_age(frame_table_t *ft, mglru_t *mg) {
+    int share = ft->capacity / MGLRU_MAX_GENS > 1 ? ft->capacity / MGLRU_MAX_GENS : 1;
+    if (mglru_nr_gens(mg) < MGLRU_MAX_GENS && mg->gens[mg->max_seq % MGLRU_MAX_GENS].count >= share) {
+        mg->max_seq++;
+    }
+}
+
+static void mglru_load(frame_table_t *ft, int frame) {
+    mglru_t *mg = ft->policy_state;
+    uint32_t seq = mg->max_seq - 1;
+    ghost_t *shadow = ghost_find(&mg->shadows, vm_page_id(&ft->frames[frame]));
+    if (shadow) {
+        // Evicted less than MGLRU_MAX_GENS generations ago: part of the working set
+        if (mg->min_seq - shadow->stamp < MGLRU_MAX_GENS) seq = mg->max_seq;
+        ghost_remove(&mg->shadows, shadow);
+    }
+    frame_list_push_tail(mg->links, mg->gens, (int) (seq % MGLRU_MAX_GENS), frame);
+    mg->accessed[frame] = 0;
+    mg->resident++;
+    mglru_maybe_age(ft, mg);
+}
+
+static void mglru_access(frame_table_t *ft, int frame) {
+    mglru_t *mg = ft->policy_state;
+    mg->accessed[frame] = 1;
+}
+
+static void mglru_unload(frame_table_t *ft, int frame, int evicted) {
+    mglru_t *mg = ft->policy_state;
+    if (mg->links[frame].list == INVALID_FRAME) return;
+    frame_list_unlink(mg->links, mg->gens, frame);
+    mg->accessed[frame] = 0;
+    mg->resident--;
+    if (!evicted) return;
+    ghost_add(&mg->shadows, 0, vm_page_id(&ft->frames[frame]), mg->min_seq);
+    ghost_trim(&mg->shadows, 0, ft->capacity);
+}
+
+static void mglru_forget(frame_table_t *ft, uint64_t page_id) {
+    mglru_t *mg = ft->policy_state;
+    ghost_forget(&mg->shadows, page_id);
+}
+
+static int mglru_select(frame_table_t *ft) {
+    mglru_t *mg = ft->policy_state;
+    if (mg->resident == 0) return INVALID_FRAME;
+    for (;;) {
+        frame_list_t *oldest = &mg->gens[mg->min_seq % MGLRU_MAX_GENS];
+        if (oldest->count == 0) {
+            mg->min_seq++;
+            if (mglru_nr_gens(mg) < MGLRU_MIN_GENS) mg->max_seq++;
+            continue;
+        }
+        int frame = oldest->head;
+        if (!mg->accessed[frame]) return frame;
+        mg->accessed[frame] = 0;
+        frame_list_unlink(mg->links, mg->gens, frame);
+        frame_list_push_tail(mg->links, mg->gens, (int) (mg->max_seq % MGLRU_MAX_GENS), frame);
+        mglru_maybe_age(ft, mg);
+    }
+}
+
+// =========================================================================================================================
+
+const vm_policy_ops_t vm_arc = {
+    .id = VM_ARC,
+    .name = "arc",
+    .description = "Adaptive replacement cache: recency and frequency lists sized by ghost hits",
+    .init = arc_init,
+    .on_load = arc_load,
+    .on_access = arc_access,
+    .on_unload = arc_unload,
+    .on_forget = arc_forget,
+    .select_victim = arc_select,
+};
+
+const vm_policy_ops_t vm_2q = {
+    .id = VM_2Q,
+    .name = "2q",
+    .description = "2Q: new pages in a FIFO, pages that come back in an LRU",
+    .init = twoq_init,
+    .on_load = twoq_load,
+    .on_access = twoq_access,
+    .on_unload = twoq_unload,
+    .on_forget = twoq_forget,
+    .select_victim = twoq_select,
+};
+
+const vm_policy_ops_t vm_lirs = {
+    .id = VM_LIRS,
+    .name = "lirs",
+    .description = "Low inter-reference recency set",
+    .init = lirs_init,
+    .on_load = lirs_load,
+    .on_access = lirs_access,
+    .on_unload = lirs_unload,
+    .on_forget = lirs_forget,
+    .select_victim = lirs_select,
+};
+
+const vm_policy_ops_t vm_clockpro = {
+    .id = VM_CLOCKPRO,
+    .name = "clockpro",
+    .description = "CLOCK-Pro: hot and cold pages with test periods, three clock hands",
+    .init = cpro_init,
+    .on_load = cpro_load,
+    .on_access = cpro_access,
+    .on_unload = cpro_unload,
+    .on_forget = cpro_forget,
+    .select_victim = cpro_select,
+};
+
+const vm_policy_ops_t vm_mglru = {
+    .id = VM_MGLRU,
+    .name = "mglru",
+    .description = "Multi-generational LRU with refault detection",
+    .init = mglru_init,
+    .on_load = mglru_load,
+    .on_access = mglru_access,
+    .on_unload = mglru_unload,
+    .on_forget = mglru_forget,
+    .select_victim = mglru_select,
+};
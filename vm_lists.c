@@ -0,0 +1,151 @@
+#include "vm_lists.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// ============================================ Frame lists ============================================================
+
+/**
+ * Allocate the links of a set of frame lists, with every frame in no list
+ * @param num_frames number of frames
+ * @return the links, or NULL on failure
+ */
+frame_link_t *frame_links_create(int num_frames) {
+    frame_link_t *links = malloc((size_t) num_frames * sizeof(frame_link_t));
+    if (!links) {
+        printf("Cannot allocate memory for the frame links\n");
+        return NULL;
+    }
+    for (int i = 0; i < num_frames; i++) {
+        links[i].prev = links[i].next = links[i].list = INVALID_FRAME;
+    }
+    return links;
+}
+
+void frame_lists_init(frame_list_t *lists, int num_lists) {
+    for (int l = 0; l < num_lists; l++) {
+        lists[l].head = lists[l].tail = INVALID_FRAME;
+        lists[l].count = 0;
+    }
+}
+
+/**
+ * Append a frame to a list; it must not be in any list of the set
+ * @param links the links of the set
+ * @param lists the lists of the set
+ * @param list the list to append to
+ * @param frame_id the frame
+ */
+void frame_list_push_tail(frame_link_t *links, frame_list_t *lists, int list, int frame_id) {
+    frame_list_t *l = &lists[list];
+    frame_link_t *link = &links[frame_id];
+    link->prev = l->tail;
+    link->next = INVALID_FRAME;
+    link->list = list;
+    if (l->tail != INVALID_FRAME) {
+        links[l->tail].next = frame_id;
+    } else {
+        l->head = frame_id;
+    }
+    l->tail = frame_id;
+    l->count++;
+}
+
+/**
+ * Take a frame out of the list it is in, if any
+ * @param links the links of the set
+ * @param lists the lists of the set
+ * @param frame_id the frame
+ */
+void frame_list_unlink(frame_link_t *links, frame_list_t *lists, int frame_id) {
+    frame_link_t *link = &links[frame_id];
+    if (link->list == INVALID_FRAME) return;
+    frame_list_t *l = &lists[link->list];
+    if (link->prev != INVALID_FRAME) links[link->prev].next = link->next; else l->head = link->next;
+    if (link->next != INVALID_FRAME) links[link->next].prev = link->prev; else l->tail = link->prev;
+    l->count--;
+    link->prev = link->next = link->list = INVALID_FRAME;
+}
+
+// ================================================ Ghosts =============================================================
+
+/**
+ * Identify the page held by a frame the same way swap does
+ * @param fd the frame descriptor
+ * @return (pid<<32)|vfn
+ */
+uint64_t vm_page_id(const frame_desc_t *fd) {
+    return (((uint64_t) fd->pid) << 32) | ((uint64_t) fd->vfn);
+}
+
+void ghost_table_init(ghost_table_t *table) {
+    table->pages = NULL;
+    for (int l = 0; l < GHOST_LISTS; l++) {
+        table->lists[l].head = table->lists[l].tail = NULL;
+        table->lists[l].count = 0;
+    }
+}
+
+ghost_t *ghost_find(ghost_table_t *table, uint64_t page_id) {
+    ghost_t *ghost = NULL;
+    HASH_FIND(hh, table->pages, &page_id, sizeof(uint64_t), ghost);
+    return ghost;
+}
+
+/**
+ * Remember an evicted page at the newest end of a ghost list. A page already
+ * remembered moves to the new position.
+ * @param table the ghost table
+ * @param list the ghost list
+ * @param page_id the page
+ * @param stamp value kept with the ghost for the policy
+ * @return 0 on success, -1 on failure
+ */
+int ghost_add(ghost_table_t *table, int list, uint64_t page_id, uint32_t stamp) {
+    ghost_t *ghost = ghost_find(table, page_id);
+    if (ghost) ghost_remove(table, ghost);
+    ghost = malloc(sizeof(ghost_t));
+    if (!ghost) {
+        printf("Cannot allocate memory for a ghost entry\n");
+        return -1;
+    }
+    ghost->page_id = page_id;
+    ghost->stamp = stamp;
+    ghost->list = list;
+    ghost_list_t *l = &table->lists[list];
+    ghost->prev = l->tail;
+    ghost->next = NULL;
+    if (l->tail) l->tail->next = ghost; else l->head = ghost;
+    l->tail = ghost;
+    l->count++;
+    HASH_ADD(hh, table->pages, page_id, sizeof(uint64_t), ghost);
+    return 0;
+}
+
+void ghost_remove(ghost_table_t *table, ghost_t *ghost) {
+    ghost_list_t *l = &table->lists[ghost->list];
+    if (ghost->prev) ghost->prev->next = ghost->next; else l->head = ghost->next;
+    if (ghost->next) ghost->next->prev = ghost->prev; else l->tail = ghost->prev;
+    l->count--;
+    HASH_DEL(table->pages, ghost);
+    free(ghost);
+}
+
+/**
+ * Forget the oldest ghosts of a list until it holds at most max_count
+ * @param table the ghost table
+ * @param list the ghost list
+ * @param max_count the size limit
+ */
+void ghost_trim(ghost_table_t *table, int list, int max_count) {
+    if (max_count < 0) max_count = 0;
+    while (table->lists[list].count > max_count) {
+        ghost_remove(table, table->lists[list].head);
+    }
+}
+
+// A page that no longer exists (its process terminated) must not be taken for a refault later
+void ghost_forget(ghost_table_t *table, uint64_t page_id) {
+    ghost_t *ghost = ghost_find(table, page_id);
+    if (ghost) ghost_remove(table, ghost);
+}
@@ -0,0 +1,67 @@
+#ifndef VM_LISTS_H
+#define VM_LISTS_H
+
+/*
+ * Building blocks of the page replacement indexes (vm_policies.c, vm_adaptive.c).
+ *
+ * Frame lists are intrusive doubly-linked lists of frame ids: the links live in an
+ * array indexed by frame id and a frame is in at most one list of a set at a time.
+ *
+ * Ghost lists remember pages that are no longer resident, by page id, so a policy can
+ * tell a page that comes back soon after its eviction from one seen for the first time.
+ */
+
+#include <stdint.h>
+
+#include "uthash.h"
+#include "virtmem_types.h"
+
+typedef struct frame_link_st {
+    int32_t prev;
+    int32_t next;
+    int32_t list;       // List of the set the frame is in, INVALID_FRAME if none
+} frame_link_t;
+
+typedef struct frame_list_st {
+    int32_t head;       // Oldest
+    int32_t tail;       // Newest
+    int     count;
+} frame_list_t;
+
+frame_link_t *frame_links_create(int num_frames);
+void frame_lists_init(frame_list_t *lists, int num_lists);
+void frame_list_push_tail(frame_link_t *links, frame_list_t *lists, int list, int frame_id);
+void frame_list_unlink(frame_link_t *links, frame_list_t *lists, int frame_id);
+
+#define GHOST_LISTS 2
+
+typedef struct ghost_st {
+    uint64_t page_id;           // (pid<<32)|vfn, as in swap
+    uint32_t stamp;             // Free for the policy (e.g. when the page was evicted)
+    int      list;
+    struct ghost_st *prev;
+    struct ghost_st *next;
+    UT_hash_handle hh;
+} ghost_t;
+
+typedef struct ghost_list_st {
+    ghost_t *head;              // Oldest
+    ghost_t *tail;              // Newest
+    int      count;
+} ghost_list_t;
+
+typedef struct ghost_table_st {
+    ghost_t      *pages;        // Hash of all ghosts, by page_id
+    ghost_list_t  lists[GHOST_LISTS];
+} ghost_table_t;
+
+uint64_t vm_page_id(const frame_desc_t *fd);
+
+void ghost_table_init(ghost_table_t *table);
+ghost_t *ghost_find(ghost_table_t *table, uint64_t page_id);
+int ghost_add(ghost_table_t *table, int list, uint64_t page_id, uint32_t stamp);
+void ghost_remove(ghost_table_t *table, ghost_t *ghost);
+void ghost_trim(ghost_table_t *table, int list, int max_count);
+void ghost_forget(ghost_table_t *table, uint64_t page_id);
+
+#endif //VM_LISTS_H
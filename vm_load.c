@@ -0,0 +1,104 @@
+#include "vm_load.h"
+
+#include "debug.h"
+
+vm_load_config_t vm_load_config = {
+    .enabled = 0,
+    .pff_interval = 8,
+};
+
+vm_load_t vm_load = {0};
+
+static void account_demand(int32_t delta) {
+    vm_load.demand += delta;
+    if (vm_load.demand > vm_load.stats.max_demand) vm_load.stats.max_demand = vm_load.demand;
+}
+
+/**
+ * A process took a page fault: adapt its frame budget to its fault frequency (PFF)
+ * @param pcb the process
+ * @param frame_table the frame table, no budget is larger than its capacity
+ */
+void vm_load_fault(pcb_t *pcb, const frame_table_t *frame_table) {
+    uint32_t interval = pcb->vm_accesses - pcb->last_fault_access;
+    pcb->last_fault_access = pcb->vm_accesses;
+    if (pcb->vm_faults++ == 0) {
+        // Its first fault: the process starts to count in the demand
+        pcb->in_demand = 1;
+        vm_load.processes++;
+    }
+    int32_t budget = (int32_t) pcb->frame_budget;
+    if (budget == 0 || interval < vm_load_config.pff_interval) {
+        budget++;
+    } else if (interval > 4 * vm_load_config.pff_interval) {
+        budget -= budget / 4;
+    }
+    if (budget > frame_table->capacity) budget = frame_table->capacity;
+    if (pcb->in_demand) account_demand(budget - (int32_t) pcb->frame_budget);
+    pcb->frame_budget = (uint32_t) budget;
+}
+
+/**
+ * A process terminated, its budget is no longer part of the demand
+ * @param pcb the process
+ */
+void vm_load_exit(pcb_t *pcb) {
+    if (!pcb->in_demand) return;
+    DBG("Process %d leaves with %u resident pages, a budget of %u frames and %u faults", pcb->pid, pcb->rss,
+        pcb->frame_budget, pcb->vm_faults);
+    account_demand(-(int32_t) pcb->frame_budget);
+    vm_load.processes--;
+    pcb->in_demand = 0;
+}
+
+/**
+ * Account a tick, for the time spent thrashing
+ * @param frame_table the frame table
+ */
+void vm_load_tick(const frame_table_t *frame_table) {
+    if (vm_load.demand > frame_table->capacity) vm_load.stats.overloaded_ticks++;
+}
+
+/**
+ * Check if a process that is running has to be suspended: the demand is over what fits
+ * in memory and it is not the last process
+ * @return 1 if it has to be suspended, 0 otherwise
+ */
+int vm_load_should_suspend(const pcb_t *pcb, const frame_table_t *frame_table) {
+    return vm_load_config.enabled && pcb->in_demand && vm_load.processes > 1
+           && vm_load.demand > frame_table->capacity;
+}
+
+/**
+ * Take a process out of the demand; the caller moves it out of the READY queue
+ * @param pcb the process
+ * @param paged_out frames freed by writing its pages out
+ */
+void vm_load_suspend(pcb_t *pcb, int paged_out) {
+    DBG("Load control: suspending process %d (budget %u, demand %d)", pcb->pid, pcb->frame_budget, vm_load.demand);
+    account_demand(-(int32_t) pcb->frame_budget);
+    vm_load.processes--;
+    pcb->in_demand = 0;
+    vm_load.stats.suspensions++;
+    if (paged_out > 0) vm_load.stats.paged_out += (uint64_t) paged_out;
+}
+
+/**
+ * Check if a suspended process fits in memory next to the processes that may run
+ * @return 1 if it can be resumed, 0 otherwise
+ */
+int vm_load_can_resume(const pcb_t *pcb, const frame_table_t *frame_table) {
+    return vm_load.processes == 0 || vm_load.demand + (int32_t) pcb->frame_budget <= frame_table->capacity;
+}
+
+/**
+ * Put a suspended process back in the demand; the caller makes it ready again
+ * @param pcb the process
+ */
+void vm_load_resume(pcb_t *pcb) {
+    DBG("Load control: resuming process %d (budget %u, demand %d)", pcb->pid, pcb->frame_budget, vm_load.demand);
+    pcb->in_demand = 1;
+    vm_load.processes++;
+    account_demand((int32_t) pcb->frame_budget);
+    vm_load.stats.resumptions++;
+}
@@ -0,0 +1,58 @@
+#ifndef VM_LOAD_H
+#define VM_LOAD_H
+
+/*
+ * Resident sets, page fault frequency and load control.
+ *
+ * Every process counts the frames it holds (pcb->rss) and has a frame budget: the
+ * frames it needs, estimated with the page fault frequency (PFF) algorithm. At every
+ * fault of a process, the page accesses it made since its previous fault are compared
+ * with vm_load_config.pff_interval: fewer means its pages do not fit, and the budget
+ * grows by one frame; more than four times as many means it has more than it needs,
+ * and the budget shrinks by a quarter. The budgets of the processes that may run are
+ * the demand for memory.
+ *
+ * Replacement stays global (the policy picks the victims among all frames); the budgets
+ * drive the load control. With --load-control, a demand above the frames that can be
+ * resident (frame_table->capacity) means the processes thrash: the process that faults
+ * is suspended, out of the READY queue, and its pages are written out so the others get
+ * its frames. Suspended processes come back, first suspended first, once their budget
+ * fits next to the demand of the others again. The last process is never suspended.
+ */
+
+#include <stdint.h>
+
+#include "virtmem.h"
+
+typedef struct vm_load_config_st {
+    int      enabled;           // --load-control: suspend processes when the demand is over the capacity
+    uint32_t pff_interval;      // Page accesses between two faults under which the budget grows
+} vm_load_config_t;
+
+extern vm_load_config_t vm_load_config;
+
+typedef struct vm_load_stats_st {
+    uint64_t suspensions;
+    uint64_t resumptions;
+    uint64_t paged_out;         // Frames freed by suspending a process
+    uint64_t overloaded_ticks;  // Ticks the demand was over the capacity
+    int32_t  max_demand;
+} vm_load_stats_t;
+
+typedef struct vm_load_st {
+    int32_t demand;             // Sum of the budgets of the processes that may run
+    int32_t processes;          // Processes counted in the demand
+    vm_load_stats_t stats;
+} vm_load_t;
+
+extern vm_load_t vm_load;
+
+void vm_load_fault(pcb_t *pcb, const frame_table_t *frame_table);
+void vm_load_exit(pcb_t *pcb);
+void vm_load_tick(const frame_table_t *frame_table);
+int vm_load_should_suspend(const pcb_t *pcb, const frame_table_t *frame_table);
+void vm_load_suspend(pcb_t *pcb, int paged_out);
+int vm_load_can_resume(const pcb_t *pcb, const frame_table_t *frame_table);
+void vm_load_resume(pcb_t *pcb);
+
+#endif //VM_LOAD_H
@@ -0,0 +1,226 @@
+#include "vm_opt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "uthash.h"
+
+#define NEVER UINT32_MAX
+
+int vm_opt_enabled = 0;
+
+// A process id can be reused after the process terminated; its pages are new pages then
+typedef struct incarnation_st {
+    int32_t  pid;
+    uint32_t id;
+    UT_hash_handle hh;
+} incarnation_t;
+
+typedef struct page_last_use_st {
+    uint64_t page;
+    uint32_t last;          // Index of the latest reference seen by the reverse pass
+    uint32_t dense;         // Page number in 0..distinct-1
+    UT_hash_handle hh;
+} page_last_use_t;
+
+static uint64_t *refs = NULL;       // (incarnation<<32)|vfn
+static size_t num_refs = 0;
+static size_t max_refs = 0;
+static int record_failed = 0;
+
+static incarnation_t *incarnations = NULL;
+static incarnation_t *last_incarnation = NULL;
+static uint32_t next_incarnation = 0;
+
+/**
+ * Append a page reference to the recorded reference string
+ * @param pid the process
+ * @param vfn the virtual page
+ */
+void vm_opt_record(int32_t pid, uint32_t vfn) {
+    if (record_failed) return;
+    if (num_refs == max_refs) {
+        size_t new_max = max_refs ? 2 * max_refs : 4096;
+        uint64_t *grown = (new_max < NEVER) ? realloc(refs, new_max * sizeof(uint64_t)) : NULL;
+        if (!grown) {
+            printf("Cannot record more page references for OPT, the comparison is disabled\n");
+            record_failed = 1;
+            return;
+        }
+        refs = grown;
+        max_refs = new_max;
+    }
+
+    incarnation_t *inc = last_incarnation;
+    if (!inc || inc->pid != pid) {
+        HASH_FIND(hh, incarnations, &pid, sizeof(int32_t), inc);
+        if (!inc) {
+            inc = malloc(sizeof(incarnation_t));
+            if (!inc) {
+                printf("Cannot allocate memory for an OPT process entry\n");
+                record_failed = 1;
+                return;
+            }
+            inc->pid = pid;
+            inc->id = next_incarnation++;
+            HASH_ADD(hh, incarnations, pid, sizeof(int32_t), inc);
+        }
+        last_incarnation = inc;
+    }
+    refs[num_refs++] = (((uint64_t) inc->id) << 32) | vfn;
+}
+
+/**
+ * The process terminated, the next process with this pid has pages of its own
+ * @param pid the process
+ */
+void vm_opt_process_exit(int32_t pid) {
+    incarnation_t *inc = NULL;
+    HASH_FIND(hh, incarnations, &pid, sizeof(int32_t), inc);
+    if (!inc) return;
+    if (last_incarnation == inc) last_incarnation = NULL;
+    HASH_DEL(incarnations, inc);
+    free(inc);
+}
+
+// ============================================ Max-heap ===============================================================
+
+typedef struct opt_heap_st {
+    uint32_t *key;          // Next use of the page in every slot
+    uint32_t *page;
+    int32_t  *pos;          // Slot of every page, -1 if not resident
+    int       size;
+} opt_heap_t;
+
+static void heap_set(opt_heap_t *h, int slot, uint32_t key, uint32_t page) {
+    h->key[slot] = key;
+    h->page[slot] = page;
+    h->pos[page] = slot;
+}
+
+static void sift_up(opt_heap_t *h, int slot) {
+    uint32_t key = h->key[slot], page = h->page[slot];
+    while (slot > 0) {
+        int parent = (slot - 1) / 2;
+        if (h->key[parent] >= key) break;
+        heap_set(h, slot, h->key[parent], h->page[parent]);
+        slot = parent;
+    }
+    heap_set(h, slot, key, page);
+}
+
+static void sift_down(opt_heap_t *h, int slot) {
+    uint32_t key = h->key[slot], page = h->page[slot];
+    for (;;) {
+        int child = 2 * slot + 1;
+        if (child >= h->size) break;
+        if (child + 1 < h->size && h->key[child + 1] > h->key[child]) child++;
+        if (h->key[child] <= key) break;
+        heap_set(h, slot, h->key[child], h->page[child]);
+        slot = child;
+    }
+    heap_set(h, slot, key, page);
+}
+
+// =========================================================================================================================
+
+/**
+ * Reverse pass over the reference string: the next use of every reference. The pages
+ * in refs[] are renumbered 0..distinct-1 on the way.
+ * @param next where to store the index of the next use of every reference (NEVER if none)
+ * @return the number of distinct pages, or -1 on failure
+ */
+static int64_t find_next_uses(uint32_t *next) {
+    page_last_use_t *pages = NULL, *entry, *tmp;
+    int64_t distinct = 0;
+    for (size_t i = num_refs; i-- > 0;) {
+        HASH_FIND(hh, pages, &refs[i], sizeof(uint64_t), entry);
+        if (entry) {
+            next[i] = entry->last;
+        } else {
+            entry = malloc(sizeof(page_last_use_t));
+            if (!entry) {
+                printf("Cannot allocate memory for the OPT oracle\n");
+                distinct = -1;
+                break;
+            }
+            entry->page = refs[i];
+            entry->dense = (uint32_t) distinct++;
+            HASH_ADD(hh, pages, page, sizeof(uint64_t), entry);
+            next[i] = NEVER;
+        }
+        entry->last = (uint32_t) i;
+        refs[i] = entry->dense;
+    }
+    HASH_ITER(hh, pages, entry, tmp) {
+        HASH_DEL(pages, entry);
+        free(entry);
+    }
+    return distinct;
+}
+
+/**
+ * Forward pass: count the faults of OPT. A page that is needed later than every
+ * resident page is not kept at all, as the simulator may evict the page it just
+ * brought in before the next reference.
+ */
+static long count_faults(const uint32_t *next, uint32_t distinct, int capacity) {
+    opt_heap_t heap = {
+        .key = malloc((size_t) capacity * sizeof(uint32_t)),
+        .page = malloc((size_t) capacity * sizeof(uint32_t)),
+        .pos = malloc((distinct ? distinct : 1) * sizeof(int32_t)),
+        .size = 0,
+    };
+    long faults = -1;
+    if (heap.key && heap.page && heap.pos) {
+        for (uint32_t p = 0; p < distinct; p++) heap.pos[p] = -1;
+        faults = 0;
+        for (size_t i = 0; i < num_refs; i++) {
+            uint32_t page = (uint32_t) refs[i];
+            int32_t slot = heap.pos[page];
+            if (slot >= 0) {
+                // Its next use was now, the new one is later
+                heap.key[slot] = next[i];
+                sift_up(&heap, slot);
+                continue;
+            }
+            faults++;
+            if (heap.size < capacity) {
+                heap_set(&heap, heap.size++, next[i], page);
+                sift_up(&heap, heap.size - 1);
+            } else if (next[i] < heap.key[0]) {
+                heap.pos[heap.page[0]] = -1;
+                heap_set(&heap, 0, next[i], page);
+                sift_down(&heap, 0);
+            }
+        }
+    } else {
+        printf("Cannot allocate memory for the OPT oracle\n");
+    }
+    free(heap.key);
+    free(heap.page);
+    free(heap.pos);
+    return faults;
+}
+
+/**
+ * Play OPT over the recorded reference string. Can only be done once, the references
+ * are renumbered in place.
+ * @param capacity number of pages that stay resident between two references
+ * @return the number of faults OPT takes, or -1 if it could not be computed
+ */
+long vm_opt_faults(int capacity) {
+    if (record_failed) return -1;
+    if (capacity <= 0) return (long) num_refs;
+
+    uint32_t *next = malloc((num_refs ? num_refs : 1) * sizeof(uint32_t));
+    if (!next) {
+        printf("Cannot allocate memory for the OPT oracle\n");
+        return -1;
+    }
+    record_failed = 1;
+    int64_t distinct = find_next_uses(next);
+    long faults = (distinct < 0) ? -1 : count_faults(next, (uint32_t) distinct, capacity);
+    free(next);
+    return faults;
+}
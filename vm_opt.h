@@ -0,0 +1,23 @@
+#ifndef VM_OPT_H
+#define VM_OPT_H
+
+/*
+ * Belady's OPT (MIN) replacement as an offline oracle.
+ *
+ * Which page a process touches next only becomes known when the scheduler runs it, so
+ * the reference string is recorded while the simulation runs (--opt) and OPT is played
+ * over it at the end: a reverse pass finds the next use of every reference, then a
+ * forward pass keeps the resident pages in a max-heap on their next use and, on a fault,
+ * drops the one needed furthest in the future. The fault count is a lower bound for any
+ * policy with the same memory.
+ */
+
+#include <stdint.h>
+
+extern int vm_opt_enabled;
+
+void vm_opt_record(int32_t pid, uint32_t vfn);
+void vm_opt_process_exit(int32_t pid);
+long vm_opt_faults(int capacity);
+
+#endif //VM_OPT_H
@@ -0,0 +1,370 @@
+/*
+ * Page replacement policies. Every policy keeps an index of the resident frames that
+ * is updated by the hooks page_request(), page_eviction() and release_process_memory()
+ * call, so picking a victim never scans the frame table:
+ *   random  dense array of the resident frames, O(1)
+ *   fifo    ring buffer in load order; entries of frames that were freed meanwhile
+ *           are recognised by their load generation and skipped, O(1) amortised
+ *   nru     one list per NRU class, O(1)
+ *   lru     list in access order, O(1)
+ *   clock   circular list of the resident frames only, O(1) amortised
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "virtmem.h"
+#include "vm_lists.h"
+
+// ============================================ Helpers ================================================================
+
+#define NRU_CLASSES 4
+
+// Frame lists of the list based policies; lru uses lists[0] only
+typedef struct list_index_st {
+    frame_link_t *links;
+    frame_list_t  lists[NRU_CLASSES];
+} list_index_t;
+
+static int list_index_init(frame_table_t *ft) {
+    list_index_t *idx = malloc(sizeof(list_index_t));
+    if (!idx) return -1;
+    idx->links = frame_links_create(ft->no_frames);
+    if (!idx->links) {
+        free(idx);
+        return -1;
+    }
+    frame_lists_init(idx->lists, NRU_CLASSES);
+    ft->policy_state = idx;
+    return 0;
+}
+
+static void list_index_unload(frame_table_t *ft, int frame, int evicted) {
+    (void) evicted;
+    list_index_t *idx = ft->policy_state;
+    frame_list_unlink(idx->links, idx->lists, frame);
+}
+
+static void no_access(frame_table_t *ft, int frame) {
+    (void) ft;
+    (void) frame;
+}
+
+static void no_forget(frame_table_t *ft, uint64_t page_id) {
+    (void) ft;
+    (void) page_id;
+}
+
+// ================================================ RANDOM =============================================================
+
+// Resident frames packed at the front of an array, so a random victim is one rand() away
+typedef struct random_index_st {
+    int32_t *frames;
+    int32_t *pos;       // Position of every frame in 'frames', INVALID_FRAME if not resident
+    int      count;
+} random_index_t;
+
+static int random_init(frame_table_t *ft) {
+    random_index_t *idx = malloc(sizeof(random_index_t));
+    if (!idx) return -1;
+    idx->frames = malloc((size_t) ft->no_frames * sizeof(int32_t));
+    idx->pos = malloc((size_t) ft->no_frames * sizeof(int32_t));
+    if (!idx->frames || !idx->pos) {
+        free(idx->frames);
+        free(idx->pos);
+        free(idx);
+        return -1;
+    }
+    for (int i = 0; i < ft->no_frames; i++) idx->pos[i] = INVALID_FRAME;
+    idx->count = 0;
+    ft->policy_state = idx;
+    return 0;
+}
+
+static void random_load(frame_table_t *ft, int frame) {
+    random_index_t *idx = ft->policy_state;
+    if (idx->pos[frame] != INVALID_FRAME) return;
+    idx->pos[frame] = idx->count;
+    idx->frames[idx->count++] = frame;
+}
+
+static void random_unload(frame_table_t *ft, int frame, int evicted) {
+    (void) evicted;
+    random_index_t *idx = ft->policy_state;
+    int32_t i = idx->pos[frame];
+    if (i == INVALID_FRAME) return;
+    // O último ocupa o lugar do que sai
+    int32_t last = idx->frames[--idx->count];
+    idx->frames[i] = last;
+    idx->pos[last] = i;
+    idx->pos[frame] = INVALID_FRAME;
+}
+
+static int random_select(frame_table_t *ft) {
+    random_index_t *idx = ft->policy_state;
+    if (idx->count == 0) {
+        printf("[random_eviction] Nenhuma frame válida para remover.\n");
+        return INVALID_FRAME;
+    }
+    return idx->frames[rand() % idx->count];
+}
+
+// ================================================= FIFO ==============================================================
+
+/*
+ * Ring buffer of (frame, generation) in load order. Freeing a frame bumps its
+ * generation, which turns its entry stale without having to find it in the ring.
+ * The ring holds two entries per frame; when it fills up with stale entries it is
+ * compacted, which is O(1) amortised over the loads that filled it.
+ */
+typedef struct fifo_index_st {
+    int32_t  *ids;
+    uint32_t *gens;     // Generation of the frame when the entry was pushed
+    uint32_t *gen;      // Current generation of every frame
+    int       capacity;
+    int       head;
+    int       count;
+} fifo_index_t;
+
+static int fifo_init(frame_table_t *ft) {
+    fifo_index_t *idx = malloc(sizeof(fifo_index_t));
+    if (!idx) return -1;
+    idx->capacity = 2 * ft->no_frames;
+    idx->ids = malloc((size_t) idx->capacity * sizeof(int32_t));
+    idx->gens = malloc((size_t) idx->capacity * sizeof(uint32_t));
+    idx->gen = calloc((size_t) ft->no_frames, sizeof(uint32_t));
+    if (!idx->ids || !idx->gens || !idx->gen) {
+        free(idx->ids);
+        free(idx->gens);
+        free(idx->gen);
+        free(idx);
+        return -1;
+    }
+    idx->head = 0;
+    idx->count = 0;
+    ft->policy_state = idx;
+    return 0;
+}
+
+static int fifo_stale(fifo_index_t *idx, int slot) {
+    return idx->gens[slot] != idx->gen[idx->ids[slot]];
+}
+
+// Drop the stale entries, keeping the order of the others
+static void fifo_compact(fifo_index_t *idx) {
+    int kept = 0;
+    for (int i = 0; i < idx->count; i++) {
+        int src = (idx->head + i) % idx->capacity;
+        if (fifo_stale(idx, src)) continue;
+        int dst = (idx->head + kept) % idx->capacity;
+        idx->ids[dst] = idx->ids[src];
+        idx->gens[dst] = idx->gens[src];
+        kept++;
+    }
+    idx->count = kept;
+}
+
+static void fifo_load(frame_table_t *ft, int frame) {
+    fifo_index_t *idx = ft->policy_state;
+    if (idx->count == idx->capacity) fifo_compact(idx);
+    int slot = (idx->head + idx->count) % idx->capacity;
+    idx->ids[slot] = frame;
+    idx->gens[slot] = idx->gen[frame];
+    idx->count++;
+}
+
+static void fifo_unload(frame_table_t *ft, int frame, int evicted) {
+    (void) evicted;
+    fifo_index_t *idx = ft->policy_state;
+    idx->gen[frame]++;
+}
+
+static int fifo_select(frame_table_t *ft) {
+    fifo_index_t *idx = ft->policy_state;
+    while (idx->count > 0) {
+        if (!fifo_stale(idx, idx->head)) return idx->ids[idx->head];
+        idx->head = (idx->head + 1) % idx->capacity;
+        idx->count--;
+    }
+    return INVALID_FRAME;
+}
+
+// ================================================== NRU ==============================================================
+
+int classificacao_nru(pte_t *pagina_virtual) {
+    // referenced | dirty | classificacao
+    //     0      |   0   |      0
+    //     0      |   1   |      1
+    //     1      |   0   |      2
+    //     1      |   1   |      3
+    return (pagina_virtual->referenced ? 2 : 0) + (pagina_virtual->dirty ? 1 : 0);
+}
+
+static void nru_load(frame_table_t *ft, int frame) {
+    list_index_t *idx = ft->policy_state;
+    frame_list_unlink(idx->links, idx->lists, frame);
+    frame_list_push_tail(idx->links, idx->lists, classificacao_nru(ft->frames[frame].vp), frame);
+}
+
+// A página só muda de lista se a classe mudou; dentro da classe fica a ordem de chegada
+static void nru_access(frame_table_t *ft, int frame) {
+    list_index_t *idx = ft->policy_state;
+    int classe = classificacao_nru(ft->frames[frame].vp);
+    if (idx->links[frame].list == classe) return;
+    frame_list_unlink(idx->links, idx->lists, frame);
+    frame_list_push_tail(idx->links, idx->lists, classe, frame);
+}
+
+static int nru_select(frame_table_t *ft) {
+    list_index_t *idx = ft->policy_state;
+    // A primeira lista não vazia é a melhor classe
+    for (int classe = 0; classe < NRU_CLASSES; classe++) {
+        if (idx->lists[classe].count > 0) return idx->lists[classe].head;
+    }
+    return INVALID_FRAME;
+}
+
+// ================================================== LRU ==============================================================
+
+static void lru_load(frame_table_t *ft, int frame) {
+    list_index_t *idx = ft->policy_state;
+    frame_list_unlink(idx->links, idx->lists, frame);
+    frame_list_push_tail(idx->links, idx->lists, 0, frame);
+}
+
+// The head of the list is the least recently used frame
+static int lru_select(frame_table_t *ft) {
+    list_index_t *idx = ft->policy_state;
+    return idx->lists[0].head;
+}
+
+// ================================================= CLOCK =============================================================
+
+/*
+ * The hand only goes round the resident frames. Every frame it passes had its
+ * referenced bit set by an access since the last time, so a sweep is paid for by
+ * the accesses before it.
+ */
+typedef struct clock_index_st {
+    frame_link_t *links;    // Circular list, 'list' is 0 for resident frames
+    int32_t       hand;
+} clock_index_t;
+
+static int clock_init(frame_table_t *ft) {
+    clock_index_t *idx = malloc(sizeof(clock_index_t));
+    if (!idx) return -1;
+    idx->links = frame_links_create(ft->no_frames);
+    if (!idx->links) {
+        free(idx);
+        return -1;
+    }
+    idx->hand = INVALID_FRAME;
+    ft->policy_state = idx;
+    return 0;
+}
+
+// A new page goes just behind the hand, so it is the last one the hand looks at
+static void clock_load(frame_table_t *ft, int frame) {
+    clock_index_t *idx = ft->policy_state;
+    frame_link_t *link = &idx->links[frame];
+    if (link->list != INVALID_FRAME) return;
+    link->list = 0;
+    if (idx->hand == INVALID_FRAME) {
+        link->prev = link->next = frame;
+        idx->hand = frame;
+        return;
+    }
+    int32_t prev = idx->links[idx->hand].prev;
+    link->prev = prev;
+    link->next = idx->hand;
+    idx->links[prev].next = frame;
+    idx->links[idx->hand].prev = frame;
+}
+
+static void clock_unload(frame_table_t *ft, int frame, int evicted) {
+    (void) evicted;
+    clock_index_t *idx = ft->policy_state;
+    frame_link_t *link = &idx->links[frame];
+    if (link->list == INVALID_FRAME) return;
+    if (link->next == frame) {
+        idx->hand = INVALID_FRAME;
+    } else {
+        idx->links[link->prev].next = link->next;
+        idx->links[link->next].prev = link->prev;
+        if (idx->hand == frame) idx->hand = link->next;
+    }
+    link->prev = link->next = link->list = INVALID_FRAME;
+}
+
+static int clock_select(frame_table_t *ft) {
+    clock_index_t *idx = ft->policy_state;
+    if (idx->hand == INVALID_FRAME) return INVALID_FRAME;
+    for (;;) {
+        pte_t *pagina_atual = ft->frames[idx->hand].vp;
+        // Se não foi usada vai ser esta para remover
+        if (pagina_atual == NULL || pagina_atual->referenced == 0) return idx->hand;
+        // Se foi usada marco como não usada e avanço o ponteiro
+        pagina_atual->referenced = 0;
+        idx->hand = idx->links[idx->hand].next;
+    }
+}
+
+const vm_policy_ops_t vm_random = {
+    .id = VM_RANDOM,
+    .name = "random",
+    .description = "Random resident page",
+    .init = random_init,
+    .on_load = random_load,
+    .on_access = no_access,
+    .on_unload = random_unload,
+    .on_forget = no_forget,
+    .select_victim = random_select,
+};
+
+const vm_policy_ops_t vm_fifo = {
+    .id = VM_FIFO,
+    .name = "fifo",
+    .description = "First in, first out",
+    .init = fifo_init,
+    .on_load = fifo_load,
+    .on_access = no_access,
+    .on_unload = fifo_unload,
+    .on_forget = no_forget,
+    .select_victim = fifo_select,
+};
+
+const vm_policy_ops_t vm_nru = {
+    .id = VM_NRU,
+    .name = "nru",
+    .description = "Not recently used: lowest referenced/dirty class first",
+    .init = list_index_init,
+    .on_load = nru_load,
+    .on_access = nru_access,
+    .on_unload = list_index_unload,
+    .on_forget = no_forget,
+    .select_victim = nru_select,
+};
+
+const vm_policy_ops_t vm_lru = {
+    .id = VM_LRU,
+    .name = "lru",
+    .description = "Least recently used",
+    .init = list_index_init,
+    .on_load = lru_load,
+    .on_access = lru_load,
+    .on_unload = list_index_unload,
+    .on_forget = no_forget,
+    .select_victim = lru_select,
+};
+
+const vm_policy_ops_t vm_clock = {
+    .id = VM_CLOCK,
+    .name = "clock",
+    .description = "Second chance clock over the resident pages",
+    .init = clock_init,
+    .on_load = clock_load,
+    .on_access = no_access,
+    .on_unload = clock_unload,
+    .on_forget = no_forget,
+    .select_victim = clock_select,
+};
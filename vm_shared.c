@@ -0,0 +1,119 @@
+#include "vm_shared.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "debug.h"
+
+vm_shared_stats_t vm_shared_stats = {0};
+
+static shared_region_t *regions = NULL;
+static uint32_t mapped = 0;         // Process PTEs that map a shared frame now
+
+static shared_region_t *find_region(uint32_t key) {
+    for (shared_region_t *r = regions; r; r = r->next) {
+        if (r->key == key) return r;
+    }
+    return NULL;
+}
+
+/**
+ * Map a shared region into a process, creating the region on its first use
+ * @param pcb the process
+ * @param key the region (1 to INT32_MAX)
+ * @param first_vfn where its first page is mapped in the process
+ * @param pages the number of pages mapped
+ * @return 0 on success, -1 on failure
+ */
+int vm_shared_attach(pcb_t *pcb, uint32_t key, uint32_t first_vfn, uint32_t pages) {
+    if (key == 0 || key > INT32_MAX || first_vfn == 0 || pages == 0 || pages - 1 > UINT32_MAX - first_vfn) {
+        printf("Invalid shared region %u at page %u (%u pages)\n", key, first_vfn, pages);
+        return -1;
+    }
+    for (shared_map_t *m = pcb->shared_maps; m; m = m->next) {
+        if (first_vfn <= m->first_vfn + (m->pages - 1) && m->first_vfn <= first_vfn + (pages - 1)) {
+            printf("Shared region %u overlaps region %u in process %d\n", key, m->region->key, pcb->pid);
+            return -1;
+        }
+    }
+    shared_region_t *region = find_region(key);
+    if (!region) {
+        region = calloc(1, sizeof(shared_region_t));
+        if (!region) {
+            printf("Cannot allocate memory for a shared region\n");
+            return -1;
+        }
+        region->key = key;
+        region->id = -(int32_t) key;
+        create_page_table(&region->page_table);
+        region->next = regions;
+        regions = region;
+        vm_shared_stats.regions++;
+    }
+    shared_map_t *map = malloc(sizeof(shared_map_t));
+    if (!map) {
+        printf("Cannot allocate memory for a shared region\n");
+        return -1;
+    }
+    // Every process maps as much of the region as it declares, the region is as large as the largest
+    if (pages > region->pages) region->pages = pages;
+    map->region = region;
+    map->first_vfn = first_vfn;
+    map->pages = pages;
+    map->next = pcb->shared_maps;
+    pcb->shared_maps = map;
+    region->attached++;
+    vm_shared_stats.attaches++;
+    DBG("Process %d maps shared region %u at pages %u to %u", pcb->pid, key, first_vfn, first_vfn + pages - 1);
+    return 0;
+}
+
+/**
+ * Unmap all shared regions of a process that terminated (its PTEs are out of the reverse
+ * maps already, see release_process_memory()). The regions and their pages stay.
+ * @param pcb the process
+ */
+void vm_shared_detach(pcb_t *pcb) {
+    shared_map_t *map = pcb->shared_maps;
+    while (map) {
+        shared_map_t *next = map->next;
+        map->region->attached--;
+        free(map);
+        map = next;
+    }
+    pcb->shared_maps = NULL;
+}
+
+/**
+ * Find the shared region a page of a process belongs to
+ * @param pcb the process
+ * @param vfn the page
+ * @return the mapping of the region, or NULL if the page is private
+ */
+shared_map_t *vm_shared_find(const pcb_t *pcb, uint32_t vfn) {
+    for (shared_map_t *m = pcb->shared_maps; m; m = m->next) {
+        if (vfn >= m->first_vfn && vfn - m->first_vfn < m->pages) return m;
+    }
+    return NULL;
+}
+
+/**
+ * Account process PTEs that start (or stop) mapping a shared frame
+ * @param delta the number of PTEs
+ */
+void vm_shared_mapped(int delta) {
+    mapped += delta;
+    if (mapped > vm_shared_stats.max_mapped) vm_shared_stats.max_mapped = mapped;
+}
+
+/**
+ * Free the regions and their page tables, at the end of the run
+ */
+void vm_shared_free(void) {
+    while (regions) {
+        shared_region_t *next = regions->next;
+        clear_page_table(&regions->page_table);
+        free(regions);
+        regions = next;
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef VM_SHARED_H
+#define VM_SHARED_H
+
+/*
+ * Shared regions: pages that several processes map, like the code of a shared library.
+ *
+ * A burst file declares a region with a line `shared,<key>,<first page>,<pages>`. The
+ * application sends it in a SHARE request before its first burst, and the pages from
+ * <first page> on become a window onto region <key>. Every process that declares the
+ * same key maps the same pages, and the pages may sit at a different address in each.
+ *
+ * A region has a page table of its own (its pages are at offset + 1). In the frame table
+ * and in swap, its pages belong to the region: their pid is -key and their vfn is the
+ * page in the region, so the swap and the policies see one page, however many processes
+ * map it. The PTE of a process points to the same frame and is kept in the reverse map
+ * of the frame (frame_desc_t.rmap). Evicting the frame unmaps every process first.
+ *
+ * If a process faults on a page that another process already brought in, the frame is
+ * only mapped (a minor fault): no new frame and no read. Region pages have no owner, so
+ * they do not count in the resident set of any process. They stay in memory (or in swap)
+ * after the processes that mapped them terminate, like the page cache.
+ */
+
+#include <stdint.h>
+
+#include "virtmem.h"
+
+typedef struct shared_region_st {
+    uint32_t key;
+    int32_t  id;                        // The pid of its pages in the frame table and in swap: -key
+    uint32_t pages;
+    page_table_t page_table;            // Its pages, at offset + 1
+    uint32_t attached;                  // Processes that map it now
+    struct shared_region_st *next;
+} shared_region_t;
+
+// A region mapped into a process (pcb->shared_maps)
+typedef struct shared_map_st {
+    shared_region_t *region;
+    uint32_t first_vfn;
+    uint32_t pages;
+    struct shared_map_st *next;
+} shared_map_t;
+
+typedef struct vm_shared_stats_st {
+    uint32_t regions;
+    uint64_t attaches;
+    uint64_t minor_faults;              // Faults served by mapping a frame that was in memory already
+    uint64_t unmaps;                    // PTEs of processes unmapped because their shared frame was evicted
+    uint32_t max_mapped;                // Largest number of process PTEs mapping shared frames at once
+} vm_shared_stats_t;
+
+extern vm_shared_stats_t vm_shared_stats;
+
+int vm_shared_attach(pcb_t *pcb, uint32_t key, uint32_t first_vfn, uint32_t pages);
+void vm_shared_detach(pcb_t *pcb);
+shared_map_t *vm_shared_find(const pcb_t *pcb, uint32_t vfn);
+void vm_shared_mapped(int delta);
+void vm_shared_free(void);
+
+#endif //VM_SHARED_H
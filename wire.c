@@ -0,0 +1,411 @@
+#include "wire.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// ============================================ Page lists =============================================================
+
+static int page_info_reserve(page_info_t *pages, uint32_t count) {
+    if (count <= pages->capacity) return 0;
+    uint32_t capacity = pages->capacity ? pages->capacity : 8;
+    while (capacity < count) capacity *= 2;
+    int32_t *ids = realloc(pages->ids, capacity * sizeof(int32_t));
+    if (!ids) {
+        printf("Cannot allocate memory for a page list\n");
+        return -1;
+    }
+    pages->ids = ids;
+    pages->capacity = capacity;
+    return 0;
+}
+
+/**
+ * Add a page reference at the end of a page list
+ * @param pages the page list
+ * @param id the page (negative for a write)
+ * @return 0 on success, -1 on failure
+ */
+int page_info_append(page_info_t *pages, int32_t id) {
+    if (page_info_reserve(pages, pages->count + 1) < 0) return -1;
+    pages->ids[pages->count++] = id;
+    return 0;
+}
+
+/**
+ * Copy a page list, reusing the buffer of the destination
+ * @return 0 on success, -1 on failure
+ */
+int page_info_copy(page_info_t *dst, const page_info_t *src) {
+    if (page_info_reserve(dst, src->count) < 0) return -1;
+    if (src->count) memcpy(dst->ids, src->ids, src->count * sizeof(int32_t));
+    dst->count = src->count;
+    return 0;
+}
+
+void page_info_free(page_info_t *pages) {
+    free(pages->ids);
+    pages->ids = NULL;
+    pages->count = 0;
+    pages->capacity = 0;
+}
+
+// ============================================= Encoding ==============================================================
+
+static uint32_t zigzag(int32_t value) {
+    return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+    return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+
+static uint64_t zigzag64(int64_t value) {
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static int64_t unzigzag64(uint64_t value) {
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+static uint8_t *put_varint(uint8_t *p, uint64_t value) {
+    while (value >= 0x80) {
+        *p++ = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (uint8_t) value;
+    return p;
+}
+
+/**
+ * Read a varint of up to 64 bits
+ * @param p the next byte, advanced past the varint
+ * @param end the end of the input
+ * @param value the decoded value
+ * @return 1 on success, 0 if the input ends first, -1 if the varint is too long
+ */
+static int get_varint64(const uint8_t **p, const uint8_t *end, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 70; shift += 7) {
+        if (*p == end) return 0;
+        uint8_t byte = *(*p)++;
+        // The tenth byte only has room for the top bit
+        if (shift == 63 && (byte & 0x7e)) return -1;
+        result |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 1;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Read a varint of a 32-bit field
+ * @return 1 on success, 0 if the input ends first, -1 if the varint is too long or the
+ *         value does not fit in 32 bits
+ */
+static int get_varint(const uint8_t **p, const uint8_t *end, uint32_t *value) {
+    uint64_t result;
+    int found = get_varint64(p, end, &result);
+    if (found <= 0) return found;
+    if (result > UINT32_MAX) return -1;
+    *value = (uint32_t) result;
+    return 1;
+}
+
+/**
+ * Append a message as a frame to an output buffer
+ * @param out the output buffer (grows as needed)
+ * @param msg the message
+ * @return 0 on success, -1 on failure
+ */
+int wire_put_msg(wire_buf_t *out, const msg_t *msg) {
+    int with_pages = msg->request == PROCESS_REQUEST_RUN;
+    uint32_t count = with_pages ? msg->pages.count : 0;
+    // Length prefix, 6 fixed fields and the pages, at most 5 bytes each (a page delta takes
+    // 34 bits at most: zigzag of a 32-bit difference and the write bit)
+    size_t bound = 5 * (7 + (size_t) count);
+    if (out->len + bound > out->cap) {
+        size_t cap = out->cap ? out->cap : 256;
+        while (cap < out->len + bound) cap *= 2;
+        uint8_t *data = realloc(out->data, cap);
+        if (!data) {
+            printf("Cannot allocate memory for a message\n");
+            return -1;
+        }
+        out->data = data;
+        out->cap = cap;
+    }
+
+    // Encode the payload after room for the longest length prefix, then move it in place
+    uint8_t *payload = out->data + out->len + 5;
+    uint8_t *p = payload;
+    p = put_varint(p, (uint32_t) msg->request);
+    p = put_varint(p, (uint32_t) msg->pid);
+    p = put_varint(p, msg->time_ms);
+    if (msg->request == PROCESS_REQUEST_SHARE) {
+        p = put_varint(p, msg->share_key);
+        p = put_varint(p, msg->share_vfn);
+        p = put_varint(p, msg->share_pages);
+    }
+    if (msg->request == PROCESS_REQUEST_FORK) p = put_varint(p, (uint32_t) msg->parent_pid);
+    if (with_pages) {
+        p = put_varint(p, zigzag(msg->nice));
+        p = put_varint(p, msg->block_ms);
+        p = put_varint(p, count);
+        // 64-bit arithmetic: pages far apart (and -INT32_MIN) overflow 32 bits
+        int64_t previous = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            int64_t id = msg->pages.ids[i];
+            int64_t vfn = id < 0 ? -id : id;
+            p = put_varint(p, (zigzag64(vfn - previous) << 1) | (id < 0 ? 1u : 0u));
+            previous = vfn;
+        }
+    }
+    uint32_t length = (uint32_t) (p - payload);
+    uint8_t *frame = put_varint(out->data + out->len, length);
+    memmove(frame, payload, length);
+    out->len = (size_t) (frame - out->data) + length;
+    return 0;
+}
+
+/**
+ * Write all frames in the buffer and empty it. Meant for a blocking socket (the
+ * applications); on a non-blocking one this waits until the peer makes room, so the
+ * simulator uses wire_flush() instead.
+ * @return 0 on success, -1 on error
+ */
+int wire_write(int fd, wire_buf_t *out) {
+    size_t off = 0;
+    while (off < out->len) {
+        ssize_t n = write(fd, out->data + off, out->len - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+                poll(&pfd, 1, -1);
+                continue;
+            }
+            perror("write");
+            out->len = 0;
+            return -1;
+        }
+        off += (size_t) n;
+    }
+    out->len = 0;
+    return 0;
+}
+
+/**
+ * Write as much of the buffer as a non-blocking socket takes now; the rest stays at
+ * the front of the buffer for the next call (when the socket is writable again)
+ * @return 0 if the buffer was written out, 1 if some of it is left, -1 on error
+ *         (the buffer is emptied, the peer is gone)
+ */
+int wire_flush(int fd, wire_buf_t *out) {
+    size_t off = 0;
+    int result = 0;
+    while (off < out->len) {
+        // MSG_NOSIGNAL: a peer that closed must not kill the simulator with SIGPIPE
+        ssize_t n = send(fd, out->data + off, out->len - off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                result = 1;
+                break;
+            }
+            perror("send");
+            out->len = 0;
+            return -1;
+        }
+        off += (size_t) n;
+    }
+    if (off > 0) {
+        memmove(out->data, out->data + off, out->len - off);
+        out->len -= off;
+    }
+    return result;
+}
+
+void wire_buf_free(wire_buf_t *out) {
+    free(out->data);
+    out->data = NULL;
+    out->len = 0;
+    out->cap = 0;
+}
+
+/**
+ * Encode and write a single message
+ * @return 0 on success, -1 on error
+ */
+int wire_send_msg(int fd, const msg_t *msg) {
+    // Messages without pages fit in a small buffer on the stack
+    uint8_t small[64];
+    wire_buf_t out = {.data = small, .len = 0, .cap = sizeof(small)};
+    if (msg->request == PROCESS_REQUEST_RUN && msg->pages.count > 0) out = (wire_buf_t) {NULL, 0, 0};
+
+    if (wire_put_msg(&out, msg) < 0) return -1;
+    int result = wire_write(fd, &out);
+    if (out.data != small) wire_buf_free(&out);
+    return result;
+}
+
+// ============================================= Decoding ==============================================================
+
+/**
+ * Look for a complete frame at the start of the buffered input
+ * @param rx the buffered input
+ * @param payload set to the start of the payload
+ * @param length set to the length of the payload
+ * @return 1 if a complete frame is buffered, 0 if not yet, -1 if the length prefix is invalid
+ */
+static int find_frame(const wire_rx_t *rx, const uint8_t **payload, uint32_t *length) {
+    const uint8_t *p = rx->data + rx->start;
+    const uint8_t *end = rx->data + rx->end;
+    int result = get_varint(&p, end, length);
+    if (result <= 0) return result;
+    if (*length > WIRE_MAX_FRAME) return -1;
+    if ((size_t) (end - p) < *length) return 0;
+    *payload = p;
+    return 1;
+}
+
+/**
+ * @return 1 if a complete frame is buffered, so wire_recv_msg() returns without reading
+ */
+int wire_rx_ready(const wire_rx_t *rx) {
+    const uint8_t *payload;
+    uint32_t length;
+    return find_frame(rx, &payload, &length) != 0;
+}
+
+static int decode_payload(const uint8_t *p, const uint8_t *end, msg_t *msg) {
+    uint32_t request, pid;
+    if (get_varint(&p, end, &request) != 1 || get_varint(&p, end, &pid) != 1 ||
+        get_varint(&p, end, &msg->time_ms) != 1) {
+        return -1;
+    }
+    if (request > PROCESS_REQUEST_FORK) return -1;
+    msg->request = (process_request_t) request;
+    msg->pid = (pid_t) pid;
+    msg->nice = 0;
+    msg->block_ms = 0;
+    msg->share_key = 0;
+    msg->share_vfn = 0;
+    msg->share_pages = 0;
+    msg->parent_pid = 0;
+    msg->pages.count = 0;
+    if (msg->request == PROCESS_REQUEST_SHARE) {
+        if (get_varint(&p, end, &msg->share_key) != 1 || get_varint(&p, end, &msg->share_vfn) != 1 ||
+            get_varint(&p, end, &msg->share_pages) != 1) {
+            return -1;
+        }
+        return 0;
+    }
+    if (msg->request == PROCESS_REQUEST_FORK) {
+        uint32_t parent;
+        if (get_varint(&p, end, &parent) != 1) return -1;
+        msg->parent_pid = (pid_t) parent;
+        return 0;
+    }
+    if (msg->request != PROCESS_REQUEST_RUN) return 0;
+
+    uint32_t nice, count;
+    if (get_varint(&p, end, &nice) != 1 || get_varint(&p, end, &msg->block_ms) != 1 ||
+        get_varint(&p, end, &count) != 1) {
+        return -1;
+    }
+    msg->nice = unzigzag(nice);
+    // Every page takes at least one byte, which bounds the count before allocating
+    if (count > (uint32_t) (end - p) || page_info_reserve(&msg->pages, count) < 0) return -1;
+    int64_t previous = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t value;
+        if (get_varint64(&p, end, &value) != 1) return -1;
+        int64_t delta = unzigzag64(value >> 1);
+        // A page is 0 to INT32_MAX, or -INT32_MIN for a write; anything else was not encoded by us
+        if (delta < -previous || delta > -(int64_t) INT32_MIN - previous) return -1;
+        int64_t vfn = previous + delta;
+        if (vfn > INT32_MAX && !(value & 1)) return -1;
+        msg->pages.ids[i] = (int32_t) ((value & 1) ? -vfn : vfn);
+        previous = vfn;
+    }
+    msg->pages.count = count;
+    return 0;
+}
+
+/**
+ * Receive the next message. Reads from the socket only when no complete frame is
+ * buffered, and then takes everything that is available, so several messages can
+ * come out of one read. A partial frame stays buffered until the rest arrives.
+ * @param fd the socket (blocking or non-blocking)
+ * @param rx the buffered input of this socket
+ * @param msg the decoded message; its page list buffer is reused
+ * @return 1 if a message was decoded, 0 if a non-blocking socket has no complete
+ *         message yet, -1 if the peer closed, on error, or on a malformed frame
+ */
+int wire_recv_msg(int fd, wire_rx_t *rx, msg_t *msg) {
+    for (;;) {
+        const uint8_t *payload;
+        uint32_t length;
+        int found = find_frame(rx, &payload, &length);
+        if (found < 0) {
+            printf("Malformed frame received\n");
+            return -1;
+        }
+        if (found) {
+            rx->start = (size_t) (payload - rx->data) + length;
+            if (rx->start == rx->end) rx->start = rx->end = 0;
+            if (decode_payload(payload, payload + length, msg) < 0) {
+                printf("Malformed message received\n");
+                return -1;
+            }
+            return 1;
+        }
+
+        // Make room: move the partial frame to the front, grow if it fills the buffer
+        if (rx->start > 0) {
+            memmove(rx->data, rx->data + rx->start, rx->end - rx->start);
+            rx->end -= rx->start;
+            rx->start = 0;
+        }
+        if (rx->cap - rx->end < 1024) {
+            size_t cap = rx->cap ? rx->cap * 2 : 4096;
+            uint8_t *data = realloc(rx->data, cap);
+            if (!data) {
+                printf("Cannot allocate memory for a receive buffer\n");
+                return -1;
+            }
+            rx->data = data;
+            rx->cap = cap;
+        }
+
+        ssize_t n = read(fd, rx->data + rx->end, rx->cap - rx->end);
+        if (n > 0) {
+            rx->end += (size_t) n;
+            continue;
+        }
+        if (n == 0) return -1;  // peer closed
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        perror("read");
+        return -1;
+    }
+}
+
+// Drop any buffered input, keeping the buffer
+void wire_rx_reset(wire_rx_t *rx) {
+    rx->start = 0;
+    rx->end = 0;
+}
+
+void wire_rx_free(wire_rx_t *rx) {
+    free(rx->data);
+    rx->data = NULL;
+    rx->start = rx->end = rx->cap = 0;
+}
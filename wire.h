@@ -0,0 +1,60 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+/*
+ * Wire format of the messages between the applications and the simulator.
+ *
+ * Every message is a frame: its payload length as a varint, then the payload.
+ * The payload is a sequence of unsigned LEB128 varints:
+ *
+ *   request, pid, time_ms                      (all messages)
+ *   zigzag(nice), block_ms, count, pages...    (RUN only)
+ *   share_key, share_vfn, share_pages          (SHARE only)
+ *   parent_pid                                 (FORK only)
+ *
+ * A page reference is stored as (zigzag(vfn - previous vfn) << 1) | write, with
+ * the previous vfn starting at 0, so runs of nearby pages take one byte each. The
+ * delta is computed in 64 bits, pages at any distance take at most 5 bytes.
+ * An ACK or DONE is 4 to 8 bytes on the socket; a page list has no fixed limit.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "msg.h"
+
+// Largest payload accepted, a guard against corrupt length prefixes
+#define WIRE_MAX_FRAME (16u << 20)
+
+// Frames waiting to be written (encoded with wire_put_msg)
+typedef struct wire_buf_st {
+    uint8_t *data;
+    size_t   len;
+    size_t   cap;
+} wire_buf_t;
+
+// Bytes read from a socket and not decoded yet: data[start..end)
+typedef struct wire_rx_st {
+    uint8_t *data;
+    size_t   start;
+    size_t   end;
+    size_t   cap;
+} wire_rx_t;
+
+int page_info_append(page_info_t *pages, int32_t id);
+int page_info_copy(page_info_t *dst, const page_info_t *src);
+void page_info_free(page_info_t *pages);
+
+int wire_put_msg(wire_buf_t *out, const msg_t *msg);
+int wire_write(int fd, wire_buf_t *out);
+int wire_flush(int fd, wire_buf_t *out);
+void wire_buf_free(wire_buf_t *out);
+int wire_send_msg(int fd, const msg_t *msg);
+
+int wire_recv_msg(int fd, wire_rx_t *rx, msg_t *msg);
+int wire_rx_ready(const wire_rx_t *rx);
+void wire_rx_reset(wire_rx_t *rx);
+void wire_rx_free(wire_rx_t *rx);
+
+#endif //WIRE_H